@@ -0,0 +1,313 @@
+#!/bin/python3
+
+
+"""
+Reader for the binary flow records written by the MPI flow monitor
+(`--binary`). The layout mirrors `src/flowmon-mpi/model/mpi-flow-record.h`:
+a 32 byte header followed by fixed-width records (88 bytes since version 2,
+which added the flow file index and size, 104 since version 3, which added
+the TCP event counters), so a whole file is loaded with a single `np.fromfile`.
+
+The sink records of `--sinkRecords` (`<prefix>-sink-<rank>.bin`) follow
+`src/single-flow-application/model/flow-sink-application.h` and are read the
+same way.
+
+Run as a script to convert one or more record files of the same kind into CSV.
+"""
+
+import sys
+import argparse
+import numpy as np
+
+
+FLOW_RECORD_MAGIC = b'SWRMFLOW'
+FLOW_RECORD_VERSION = 3
+FLOW_FILE_INDEX_NONE = 0xffffffff
+
+FLOW_RECORD_HEADER_DTYPE = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('recordSize', '<u4'),
+    ('systemId', '<u4'),
+    ('samplingRate', '<u4'),
+    ('numRecords', '<u8'),
+])
+
+FLOW_RECORD_V1_FIELDS = [
+    ('flowId', '<u4'),
+    ('sourceAddress', '<u4'),
+    ('destinationAddress', '<u4'),
+    ('sourcePort', '<u2'),
+    ('destinationPort', '<u2'),
+    ('protocol', 'u1'),
+    ('reserved', 'u1', (3,)),
+    ('packetsDropped', '<u4'),
+    ('timeFirstTxPacket', '<i8'),
+    ('timeFirstRxPacket', '<i8'),
+    ('timeLastTxPacket', '<i8'),
+    ('timeLastRxPacket', '<i8'),
+    ('txBytes', '<u8'),
+    ('rxBytes', '<u8'),
+    ('bytesDropped', '<u8'),
+]
+
+FLOW_RECORD_V2_FIELDS = FLOW_RECORD_V1_FIELDS + [
+    ('flowFileIndex', '<u4'),
+    ('flowSize', '<u4'),
+]
+
+FLOW_RECORD_DTYPES = {
+    1: np.dtype(FLOW_RECORD_V1_FIELDS),
+    2: np.dtype(FLOW_RECORD_V2_FIELDS),
+    3: np.dtype(FLOW_RECORD_V2_FIELDS + [
+        ('tcpTimeouts', '<u4'),
+        ('tcpFastRetransmits', '<u4'),
+        ('tcpEcnReductions', '<u4'),
+        ('reserved2', '<u4'),
+    ]),
+}
+FLOW_RECORD_DTYPE = FLOW_RECORD_DTYPES[FLOW_RECORD_VERSION]
+
+assert FLOW_RECORD_HEADER_DTYPE.itemsize == 32
+assert FLOW_RECORD_DTYPES[1].itemsize == 80
+assert FLOW_RECORD_DTYPES[2].itemsize == 88
+assert FLOW_RECORD_DTYPE.itemsize == 104
+
+
+def get_csv_fields(records):
+    return [name for name in records.dtype.names if not name.startswith('reserved')]
+
+
+def read_flow_records(path):
+    """
+    Returns `(header, records)` where records is a structured numpy array.
+    Older files load without the fields added since.
+    """
+    header = np.fromfile(path, dtype=FLOW_RECORD_HEADER_DTYPE, count=1)
+    if len(header) != 1 or header[0]['magic'] != FLOW_RECORD_MAGIC:
+        raise ValueError(f"{path} is not a flow record file")
+    header = header[0]
+    dtype = FLOW_RECORD_DTYPES.get(int(header['version']))
+    if dtype is None:
+        raise ValueError(f"{path} has version {header['version']}, expected at most {FLOW_RECORD_VERSION}")
+    if header['recordSize'] != dtype.itemsize:
+        raise ValueError(f"{path} has records of {header['recordSize']} bytes")
+
+    records = np.fromfile(
+        path,
+        dtype=dtype,
+        count=int(header['numRecords']),
+        offset=FLOW_RECORD_HEADER_DTYPE.itemsize
+    )
+    return header, records
+
+
+SNAPSHOT_MAGIC = b'SWRMSNAP'
+SNAPSHOT_VERSION = 1
+SNAPSHOT_GROUP_NONE = 0xffffffff
+
+SNAPSHOT_HEADER_DTYPE = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('recordSize', '<u4'),
+    ('systemId', '<u4'),
+    ('samplingRate', '<u4'),
+    ('interval', '<i8'),
+])
+
+SNAPSHOT_DTYPE = np.dtype([
+    ('time', '<i8'),
+    ('group', '<u4'),
+    ('sizeClass', 'u1'),
+    ('reserved', 'u1', (3,)),
+    ('rxBytes', '<u8'),
+    ('activeFlows', '<u4'),
+    ('completedFlows', '<u4'),
+])
+
+assert SNAPSHOT_HEADER_DTYPE.itemsize == 32
+assert SNAPSHOT_DTYPE.itemsize == 32
+
+
+def read_snapshots(path):
+    """
+    Returns `(header, snapshots)` of a `<prefix>-snapshots-<rank>.bin` file.
+    The file is appended to during the run, a partially written last row is
+    ignored. Goodput of a row is `rxBytes * 8e9 / header['interval']` bps.
+    """
+    header = np.fromfile(path, dtype=SNAPSHOT_HEADER_DTYPE, count=1)
+    if len(header) != 1 or header[0]['magic'] != SNAPSHOT_MAGIC:
+        raise ValueError(f"{path} is not a snapshot file")
+    header = header[0]
+    if header['version'] != SNAPSHOT_VERSION:
+        raise ValueError(f"{path} has version {header['version']}, expected {SNAPSHOT_VERSION}")
+    if header['recordSize'] != SNAPSHOT_DTYPE.itemsize:
+        raise ValueError(f"{path} has records of {header['recordSize']} bytes")
+
+    with open(path, 'rb') as f:
+        f.seek(SNAPSHOT_HEADER_DTYPE.itemsize)
+        data = f.read()
+    count = len(data) // SNAPSHOT_DTYPE.itemsize
+    return header, np.frombuffer(data, dtype=SNAPSHOT_DTYPE, count=count)
+
+
+LINK_STATS_MAGIC = b'SWRMLINK'
+LINK_STATS_VERSION = 1
+
+LINK_STATS_HEADER_DTYPE = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('recordSize', '<u4'),
+    ('systemId', '<u4'),
+    ('numQueues', '<u4'),
+    ('sampleInterval', '<i8'),
+    ('reportInterval', '<i8'),
+    ('startTime', '<i8'),
+])
+
+LINK_STATS_DTYPE = np.dtype([
+    ('meanPackets', '<f4'),
+    ('maxPackets', '<u4'),
+    ('markedPackets', '<u4'),
+    ('droppedPackets', '<u4'),
+])
+
+assert LINK_STATS_HEADER_DTYPE.itemsize == 48
+assert LINK_STATS_DTYPE.itemsize == 16
+
+
+def read_link_stats(path):
+    """
+    Returns `(header, names, stats)` of a `<prefix>-links-<rank>.bin` file,
+    where `stats` is a (rows x queues) structured array and `names` the link
+    of each column, read from the CSV next to it.
+    """
+    header = np.fromfile(path, dtype=LINK_STATS_HEADER_DTYPE, count=1)
+    if len(header) != 1 or header[0]['magic'] != LINK_STATS_MAGIC:
+        raise ValueError(f"{path} is not a link statistics file")
+    header = header[0]
+    if header['version'] != LINK_STATS_VERSION:
+        raise ValueError(f"{path} has version {header['version']}, expected {LINK_STATS_VERSION}")
+    if header['recordSize'] != LINK_STATS_DTYPE.itemsize:
+        raise ValueError(f"{path} has records of {header['recordSize']} bytes")
+
+    with open(path[:-len('.bin')] + '.csv') as f:
+        names = [line.rstrip('\n').split(',', 1)[1] for line in f.readlines()[1:]]
+
+    num_queues = int(header['numQueues'])
+    with open(path, 'rb') as f:
+        f.seek(LINK_STATS_HEADER_DTYPE.itemsize)
+        data = f.read()
+    rows = len(data) // (LINK_STATS_DTYPE.itemsize * num_queues) if num_queues else 0
+    stats = np.frombuffer(data, dtype=LINK_STATS_DTYPE, count=rows * num_queues)
+    return header, names, stats.reshape(rows, num_queues)
+
+
+SINK_RECORD_MAGIC = b'SWRMSINK'
+SINK_RECORD_VERSION = 1
+SINK_OPEN = 0
+SINK_PEER_CLOSE = 1
+SINK_ERROR_CLOSE = 2
+
+SINK_RECORD_HEADER_DTYPE = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('recordSize', '<u4'),
+    ('systemId', '<u4'),
+    ('reserved', '<u4'),
+    ('numRecords', '<u8'),
+])
+
+SINK_RECORD_DTYPE = np.dtype([
+    ('sourceAddress', '<u4'),
+    ('destinationAddress', '<u4'),
+    ('sourcePort', '<u2'),
+    ('destinationPort', '<u2'),
+    ('protocol', 'u1'),
+    ('closeReason', 'u1'),
+    ('reserved', 'u1', (2,)),
+    ('rxBytes', '<u8'),
+    ('timeFirstRx', '<i8'),
+    ('timeLastRx', '<i8'),
+])
+
+assert SINK_RECORD_HEADER_DTYPE.itemsize == 32
+assert SINK_RECORD_DTYPE.itemsize == 40
+
+
+def read_sink_records(path):
+    """
+    Returns `(header, records)` of a `<prefix>-sink-<rank>.bin` file written
+    with `--sinkRecords`. The receiver side FCT of a flow that was closed by
+    its sender (`closeReason == SINK_PEER_CLOSE`) is `timeLastRx - timeFirstRx`.
+    """
+    header = np.fromfile(path, dtype=SINK_RECORD_HEADER_DTYPE, count=1)
+    if len(header) != 1 or header[0]['magic'] != SINK_RECORD_MAGIC:
+        raise ValueError(f"{path} is not a sink record file")
+    header = header[0]
+    if header['version'] != SINK_RECORD_VERSION:
+        raise ValueError(f"{path} has version {header['version']}, expected {SINK_RECORD_VERSION}")
+    if header['recordSize'] != SINK_RECORD_DTYPE.itemsize:
+        raise ValueError(f"{path} has records of {header['recordSize']} bytes")
+
+    records = np.fromfile(
+        path,
+        dtype=SINK_RECORD_DTYPE,
+        count=int(header['numRecords']),
+        offset=SINK_RECORD_HEADER_DTYPE.itemsize
+    )
+    return header, records
+
+
+def get_sampling_rate(header):
+    """
+    1-in-N flows were monitored, older files have 0 here
+    """
+    return max(1, int(header['samplingRate']))
+
+
+def format_ip(ip):
+    return f"{(ip >> 24) & 0xff}.{(ip >> 16) & 0xff}.{(ip >> 8) & 0xff}.{ip & 0xff}"
+
+
+def write_csv(records, out):
+    fields = get_csv_fields(records)
+    out.write(','.join(fields) + '\n')
+    for rec in records:
+        row = []
+        for field in fields:
+            if field in ('sourceAddress', 'destinationAddress'):
+                row.append(format_ip(int(rec[field])))
+            else:
+                row.append(str(rec[field]))
+        out.write(','.join(row) + '\n')
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser("Convert binary flow records to CSV")
+
+    parser.add_argument('paths', nargs='+', help="Flow record files")
+    parser.add_argument('--out', help="Output CSV file, standard output if not given")
+
+    args = parser.parse_args()
+
+    all_records = []
+    for path in args.paths:
+        with open(path, 'rb') as f:
+            magic = f.read(8)
+        if magic == SINK_RECORD_MAGIC:
+            header, records = read_sink_records(path)
+            print(f"{path}: {len(records)} sink records from system {header['systemId']}", file=sys.stderr)
+        else:
+            header, records = read_flow_records(path)
+            print(
+                f"{path}: {len(records)} records from system {header['systemId']}, "
+                f"1-in-{get_sampling_rate(header)} flows sampled",
+                file=sys.stderr
+            )
+        all_records.append(records)
+
+    out = open(args.out, 'w') if args.out else sys.stdout
+    write_csv(np.concatenate(all_records), out)
+    if args.out:
+        out.close()
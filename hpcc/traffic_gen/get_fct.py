@@ -21,6 +21,7 @@ import matplotlib.pyplot as plt
 import xml.etree.cElementTree as ET
 from typing import List
 from scapy.all import PcapReader, IP, TCP
+from flow_records import read_flow_records, get_sampling_rate
 
 
 NUM_PODS = 2
@@ -53,6 +54,8 @@ class FlowMonitorXmlParser:
         self.tps_large = {}
         self.min_start_tx = None
         self.max_last_rx = None
+        # 1-in-N flows were monitored
+        self.sampling_rate = 1
 
     @staticmethod
     def parse_time_ns(tm: str):
@@ -67,6 +70,8 @@ class FlowMonitorXmlParser:
         print(f"Results for {self.paths[0]}")
         print(f"Parsed {len(self.fcts_small)} small flows")
         print(f"Parsed {len(self.tps_large)} large flows")
+        if self.sampling_rate > 1:
+            print(f"Flows were sampled 1-in-{self.sampling_rate}, percentiles are estimates")
         print(f"Flows between {self.min_start_tx} and {self.max_last_rx}")
         print(f"Short flow FCT p99 is {np.percentile([1000 * elem[1] for elem in self.fcts_small.values()], 99)} ms")
         print(f"Long flow TP p1 is {8 * np.percentile([elem[1] for elem in self.tps_large.values()], 1)} bps")
@@ -112,6 +117,7 @@ class FlowMonitorXmlParser:
             if event == 'start':
                 if level == 0:
                     if tag == 'FlowMonitor':
+                        self.sampling_rate = int(elem.attrib.get('samplingRate', 1))
                         level += 1
                     else:
                         raise ValueError()
@@ -190,6 +196,39 @@ class FlowMonitorXmlParser:
             elem.clear()
         
 
+class FlowRecordParser(FlowMonitorXmlParser):
+    """
+    Same results as the XML parser, but from the binary flow records.
+    Only records that saw both the first transmission and the last
+    reception are used, i.e. the receiver side of each flow.
+    """
+    def parse_flow_file(self, path):
+        header, records = read_flow_records(path)
+        self.sampling_rate = get_sampling_rate(header)
+
+        t_start = records['timeFirstTxPacket'] * 1e-9
+        t_finish = records['timeLastRxPacket'] * 1e-9
+        done = (records['timeFirstTxPacket'] > 0) & (records['timeLastRxPacket'] > 0) & (t_start >= T_START)
+        records, t_start, t_finish = records[done], t_start[done], t_finish[done]
+        if len(records) == 0:
+            return
+
+        for flow_id, rx_bytes, start, finish in zip(
+            records['flowId'].tolist(), records['rxBytes'].tolist(), t_start.tolist(), t_finish.tolist()
+        ):
+            assert flow_id not in self.fcts_small
+            assert flow_id not in self.tps_large
+            if rx_bytes < SMALL_FLOW_THRESHOLD:
+                self.fcts_small[flow_id] = (rx_bytes, finish - start)
+            else:
+                self.tps_large[flow_id] = (rx_bytes, rx_bytes / (finish - start))
+
+        if self.min_start_tx is None or self.min_start_tx > t_start.min():
+            self.min_start_tx = t_start.min()
+        if self.max_last_rx is None or self.max_last_rx < t_finish.max():
+            self.max_last_rx = t_finish.max()
+
+
 def plot_cdfs(all_fcts, all_tps):
     plt.subplot(1, 2, 1)
     FlowMonitorXmlParser.plot_fct_cdf(all_fcts)
@@ -208,6 +247,7 @@ if __name__ == '__main__':
     parser.add_argument('dir', help="Path to the directory containing the flow monitor output")
     parser.add_argument('names', nargs='+', help="Prefix name of the outputs")
     parser.add_argument('--mpi', help="Number of MPI outputs")
+    parser.add_argument('--binary', action='store_true', help="Outputs are binary flow records (.bin)")
 
     args = parser.parse_args()
     
@@ -216,19 +256,26 @@ if __name__ == '__main__':
             paths = []
 
             for i in range(int(args.mpi)):
-                paths.append(os.path.join(args.dir, name + '-' + str(i) + '.xml'))
+                paths.append(os.path.join(args.dir, name + '-' + str(i) + ('.bin' if args.binary else '.xml')))
 
-            flow_monitor_parser = FlowMonitorXmlParser(paths)
+            if args.binary:
+                flow_monitor_parser = FlowRecordParser(paths)
+            else:
+                flow_monitor_parser = FlowMonitorXmlParser(paths)
             flow_monitor_parser.parse_flow_files()
 
             plot_cdfs(flow_monitor_parser.get_fcts(), flow_monitor_parser.get_tps())
     else:
         paths = []
         for name in args.names:
-            name.replace('.xml', '')
-            paths.append(os.path.join(args.dir, name + '.xml'))
-
-            flow_monitor_parser = FlowMonitorXmlParser(paths)
+            if args.binary:
+                name = name.replace('.bin', '')
+                paths.append(os.path.join(args.dir, name + '.bin'))
+                flow_monitor_parser = FlowRecordParser(paths)
+            else:
+                name = name.replace('.xml', '')
+                paths.append(os.path.join(args.dir, name + '.xml'))
+                flow_monitor_parser = FlowMonitorXmlParser(paths)
             flow_monitor_parser.parse_flow_files()
 
             plot_cdfs(flow_monitor_parser.get_fcts(), flow_monitor_parser.get_tps())
@@ -0,0 +1,169 @@
+#!/bin/python3
+
+
+"""
+Follower of the live telemetry published by swarm (`--telemetry <name>`).
+Every rank owns a shared memory ring `/dev/shm/<name>-<rank>` whose layout
+mirrors `src/flowmon-mpi/model/mpi-telemetry-exporter.h`: a 64 byte header
+followed by `capacity` samples of 64 bytes, sample k in slot k % capacity.
+
+Run as a script to print the newest sample of every rank, and optionally act
+as a watchdog that stops the run when a rank stalls or slows down too much.
+"""
+
+import os
+import sys
+import glob
+import mmap
+import time
+import signal
+import argparse
+import numpy as np
+
+
+TELEMETRY_MAGIC = b'SWRMTELE'
+TELEMETRY_VERSION = 1
+TELEMETRY_RUNNING = 1
+TELEMETRY_FINISHED = 2
+
+TELEMETRY_HEADER_DTYPE = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('recordSize', '<u4'),
+    ('systemId', '<u4'),
+    ('capacity', '<u4'),
+    ('state', '<u4'),
+    ('pid', '<i4'),
+    ('interval', '<i8'),
+    ('startTime', '<i8'),
+    ('written', '<u8'),
+    ('reserved', '<u8'),
+])
+
+TELEMETRY_SAMPLE_DTYPE = np.dtype([
+    ('wallTime', '<i8'),
+    ('simTime', '<i8'),
+    ('events', '<u8'),
+    ('activeFlows', '<u8'),
+    ('completedFlows', '<u8'),
+    ('drops', '<u8'),
+    ('simRate', '<f8'),
+    ('eventRate', '<f8'),
+])
+
+assert TELEMETRY_HEADER_DTYPE.itemsize == 64
+assert TELEMETRY_SAMPLE_DTYPE.itemsize == 64
+
+
+class TelemetrySegment:
+    """
+    A mapped telemetry ring. The mapping stays valid after the rank removed
+    the segment at the end of the run, its state then reads as finished.
+    """
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        self.path = path
+        header = self.header()
+        if header['magic'] != TELEMETRY_MAGIC:
+            raise ValueError(f"{path} is not a telemetry segment")
+        if header['version'] != TELEMETRY_VERSION:
+            raise ValueError(f"{path} has version {header['version']}, expected {TELEMETRY_VERSION}")
+        if header['recordSize'] != TELEMETRY_SAMPLE_DTYPE.itemsize:
+            raise ValueError(f"{path} has samples of {header['recordSize']} bytes")
+        self.capacity = int(header['capacity'])
+
+    def header(self):
+        return np.frombuffer(self.map, dtype=TELEMETRY_HEADER_DTYPE, count=1)[0].copy()
+
+    def written(self):
+        return int(np.frombuffer(self.map, dtype='<u8', count=1, offset=48)[0])
+
+    def latest(self):
+        """
+        The newest complete sample, None if nothing was published yet or the
+        slot was overwritten while it was copied.
+        """
+        written = self.written()
+        if written == 0:
+            return None
+        offset = TELEMETRY_HEADER_DTYPE.itemsize + ((written - 1) % self.capacity) * TELEMETRY_SAMPLE_DTYPE.itemsize
+        sample = np.frombuffer(self.map, dtype=TELEMETRY_SAMPLE_DTYPE, count=1, offset=offset)[0].copy()
+        if self.written() - written >= self.capacity - 1:
+            return None
+        return sample
+
+
+def open_segments(name):
+    """
+    Returns `{rank: TelemetrySegment}` of every segment of the run `name`
+    """
+    segments = {}
+    for path in glob.glob(f'/dev/shm/{name}-*'):
+        rank = path.rsplit('-', 1)[1]
+        if rank.isdigit():
+            segments[int(rank)] = TelemetrySegment(path)
+    return segments
+
+
+def format_sample(rank, header, sample):
+    state = 'finished' if header['state'] == TELEMETRY_FINISHED else 'running'
+    return (
+        f"rank {rank} [{state}] sim {sample['simTime'] / 1e9:.6f} s "
+        f"({sample['simRate']:.3g} sim s/s), "
+        f"{sample['events']} events ({sample['eventRate']:.3g}/s), "
+        f"{sample['activeFlows']} active, {sample['completedFlows']} completed, "
+        f"{sample['drops']} drops"
+    )
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser("Follow the live telemetry of a swarm run")
+
+    parser.add_argument('name', help="Name given to --telemetry")
+    parser.add_argument('--period', type=float, default=1.0, help="Seconds between two reports [1]")
+    parser.add_argument('--stall', type=float, default=0, help="Flag a rank whose newest sample is older than this many seconds, 0 disables it [0]")
+    parser.add_argument('--min-rate', type=float, default=0, help="Flag a rank simulating fewer sim seconds per wall second, 0 disables it [0]")
+    parser.add_argument('--kill', action='store_true', help="Send SIGTERM to every rank once one was flagged")
+
+    args = parser.parse_args()
+
+    segments = {}
+    while True:
+        for rank, segment in open_segments(args.name).items():
+            segments.setdefault(rank, segment)
+        if not segments:
+            print(f"No telemetry segment /dev/shm/{args.name}-*", file=sys.stderr)
+            time.sleep(args.period)
+            continue
+
+        flagged = []
+        for rank in sorted(segments):
+            header = segments[rank].header()
+            sample = segments[rank].latest()
+            if sample is None:
+                continue
+            print(format_sample(rank, header, sample))
+
+            if header['state'] != TELEMETRY_RUNNING:
+                continue
+            age = time.time() - sample['wallTime'] / 1e9
+            if args.stall > 0 and age > args.stall:
+                flagged.append((rank, header, f"no sample for {age:.1f} s"))
+            elif args.min_rate > 0 and sample['simRate'] < args.min_rate:
+                flagged.append((rank, header, f"only {sample['simRate']:.3g} sim s/s"))
+
+        for rank, header, reason in flagged:
+            print(f"rank {rank} (pid {header['pid']}): {reason}", file=sys.stderr)
+        if flagged and args.kill:
+            for rank in segments:
+                try:
+                    os.kill(int(segments[rank].header()['pid']), signal.SIGTERM)
+                except ProcessLookupError:
+                    pass
+            sys.exit(1)
+
+        if all(segment.header()['state'] == TELEMETRY_FINISHED for segment in segments.values()):
+            break
+        time.sleep(args.period)
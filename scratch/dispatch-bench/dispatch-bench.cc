@@ -0,0 +1,125 @@
+/**
+ * Microbenchmark of the per-flow work of closHostFlowDispatcher when it
+ * reuses a pooled SingleFlowApplication: configuring the application for
+ * the next flow through the attribute system, as the dispatcher used to,
+ * against SingleFlowApplication::SetFlowConfig with cached addresses and
+ * rate. Socket creation and the simulation itself are left out, they are
+ * the same for both.
+ *
+ *  ./ns3 run "dispatch-bench --flows=1000000 --hosts=1024"
+ */
+
+#include <chrono>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/single-flow-helper.h"
+
+using namespace ns3;
+
+#define BENCH_LINK_RATE 100
+#define BENCH_PACKET_SIZE 6000
+#define BENCH_SINK_PORT 10
+
+static Ipv4Address hostAddress(uint32_t host) {
+    return Ipv4Address(0x0a000000 + host + 1);
+}
+
+static uint16_t hostPort(uint32_t flow) {
+    return 1024 + flow % 60000;
+}
+
+/**
+ * What the dispatcher did per flow: set six attributes on the helper, then
+ * the pool applied them again on the recycled application.
+ */
+static double benchAttributes(uint32_t flows, uint32_t hosts, Ptr<SingleFlowApplication> app) {
+    SingleFlowHelper helper("ns3::TcpSocketFactory");
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < flows; i++) {
+        uint32_t src = i % hosts;
+        uint32_t dst = (i * 7 + 1) % hosts;
+
+        AddressValue remote(InetSocketAddress(hostAddress(dst), BENCH_SINK_PORT));
+        StringValue rate(std::to_string(BENCH_LINK_RATE) + "Gbps");
+        AddressValue local(InetSocketAddress(hostAddress(src), hostPort(i)));
+        UintegerValue packetSize(BENCH_PACKET_SIZE);
+        UintegerValue flowSize(1000 + i);
+        BooleanValue bulk(false);
+
+        helper.SetAttribute("Remote", remote);
+        helper.SetAttribute("DataRate", rate);
+        helper.SetAttribute("Local", local);
+        helper.SetAttribute("PacketSize", packetSize);
+        helper.SetAttribute("FlowSize", flowSize);
+        helper.SetAttribute("Bulk", bulk);
+
+        app->SetAttribute("Remote", remote);
+        app->SetAttribute("DataRate", rate);
+        app->SetAttribute("Local", local);
+        app->SetAttribute("PacketSize", packetSize);
+        app->SetAttribute("FlowSize", flowSize);
+        app->SetAttribute("Bulk", bulk);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / flows;
+}
+
+/// What the dispatcher does now: one FlowConfig from the per-host caches
+static double benchFlowConfig(uint32_t flows, uint32_t hosts, Ptr<SingleFlowApplication> app) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Ipv4Address> hostAddresses;
+    std::vector<Address> sinkAddresses;
+    for (uint32_t i = 0; i < hosts; i++) {
+        hostAddresses.push_back(hostAddress(i));
+        sinkAddresses.push_back(InetSocketAddress(hostAddress(i), BENCH_SINK_PORT));
+    }
+    SingleFlowApplication::FlowConfig config;
+    config.rate = DataRate(static_cast<uint64_t>(BENCH_LINK_RATE) * 1000000000);
+    config.packetSize = BENCH_PACKET_SIZE;
+    config.bulk = false;
+
+    for (uint32_t i = 0; i < flows; i++) {
+        uint32_t src = i % hosts;
+        uint32_t dst = (i * 7 + 1) % hosts;
+
+        config.remote = sinkAddresses[dst];
+        config.local = InetSocketAddress(hostAddresses[src], hostPort(i));
+        config.flowSize = 1000 + i;
+        app->SetFlowConfig(config);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / flows;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t flows = 1000000;
+    uint32_t hosts = 1024;
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("flows", "Number of flows to configure with each method", flows);
+    cmd.AddValue("hosts", "Number of hosts the flows are spread over", hosts);
+    cmd.Parse(argc, argv);
+
+    NS_ABORT_MSG_IF(flows == 0 || hosts == 0, "flows and hosts must be positive");
+
+    Ptr<SingleFlowApplication> app = CreateObject<SingleFlowApplication>();
+
+    // One warm up round of each, so both start with the same allocator state
+    benchAttributes(flows / 10 + 1, hosts, app);
+    benchFlowConfig(flows / 10 + 1, hosts, app);
+
+    double attributes = benchAttributes(flows, hosts, app);
+    double flowConfig = benchFlowConfig(flows, hosts, app);
+
+    std::cout << "Configured " << flows << " flows over " << hosts << " hosts" << std::endl;
+    std::cout << "\tattributes: " << attributes << " ns/flow" << std::endl;
+    std::cout << "\tflow config: " << flowConfig << " ns/flow" << std::endl;
+    std::cout << "\tspeedup: " << attributes / flowConfig << "x" << std::endl;
+
+    app->Dispose();
+    return 0;
+}
@@ -55,6 +55,7 @@ FlowScheduler :: dispatchAndSchedule() {
 
     while (current_idx < num_flows && Seconds(m_current_flow.t_arrival) == Simulator::Now()) {
         // Call the dispatcher
+        m_current_flow.index = current_idx;
         m_dispatcher(&m_current_flow);
 
         // Get next flow
@@ -99,3 +100,126 @@ FlowScheduler :: close() {
     if (m_enabled)
         m_flow_file_stream.close();
 }
+
+
+IncastScheduler :: IncastScheduler(incast_params params, vector<uint32_t> host_addresses, uint32_t first_index,
+                                   host_flow_dispatcher dispatcher, std::function<bool(uint32_t)> is_local)
+    : m_params(params),
+      m_num_hosts(host_addresses.size()),
+      m_host_addresses(std::move(host_addresses)),
+      m_is_local(is_local),
+      m_dispatcher(dispatcher),
+      m_first_index(first_index),
+      m_rng(params.seed),
+      m_interarrival(params.rate)
+{
+    NS_ABORT_MSG_IF(m_params.rate <= 0, "Incast query rate must be positive");
+    NS_ABORT_MSG_IF(m_params.fan_in == 0 || m_params.fan_in >= m_num_hosts,
+        "Incast fan-in must be between 1 and " << m_num_hosts - 1 << ", the number of other hosts");
+    NS_ABORT_MSG_IF(m_params.target >= (int32_t) m_num_hosts || m_params.target < INCAST_TARGET_ROUND_ROBIN,
+        "Incast target " << m_params.target << " is not a host");
+
+    m_order.resize(m_num_hosts);
+    m_position.resize(m_num_hosts);
+    for (uint32_t i = 0; i < m_num_hosts; i++) {
+        m_order[i] = i;
+        m_position[i] = i;
+    }
+}
+
+void
+IncastScheduler :: swapHosts(uint32_t i, uint32_t j) {
+    std::swap(m_order[i], m_order[j]);
+    m_position[m_order[i]] = i;
+    m_position[m_order[j]] = j;
+}
+
+uint32_t
+IncastScheduler :: pickTarget() {
+    if (m_params.target == INCAST_TARGET_RANDOM)
+        return uniform_int_distribution<uint32_t>(0, m_num_hosts - 1)(m_rng);
+    if (m_params.target == INCAST_TARGET_ROUND_ROBIN)
+        return m_next_target++ % m_num_hosts;
+    return m_params.target;
+}
+
+void
+IncastScheduler :: startQuery() {
+    NS_ASSERT(m_dispatcher);
+
+    uint32_t query = m_num_queries++;
+    host_flow flow = {0};
+    flow.dst = pickTarget();
+    flow.size = m_params.size;
+    flow.t_arrival = Simulator::Now().GetSeconds();
+
+    // Park the target in the last slot, the senders are a partial
+    // Fisher-Yates shuffle of the others: fan_in draws, whatever the number of hosts
+    swapHosts(m_position[flow.dst], m_num_hosts - 1);
+
+    bool local = m_is_local(flow.dst);
+    for (uint32_t i = 0; i < m_params.fan_in; i++) {
+        swapHosts(i, uniform_int_distribution<uint32_t>(i, m_num_hosts - 2)(m_rng));
+        flow.src = m_order[i];
+        flow.index = m_first_index + query * m_params.fan_in + i;
+
+        uint16_t port = m_dispatcher(&flow);
+        if (local)
+            m_members[((uint64_t) m_host_addresses[flow.src] << 16) | port] = query;
+    }
+
+    if (local) {
+        int64_t now = Simulator::Now().GetNanoSeconds();
+        m_queries[query] = {flow.dst, m_params.fan_in, now, now};
+    }
+
+    Time next = Seconds(m_interarrival(m_rng));
+    if (Simulator::Now() + next < Seconds(m_params.until))
+        Simulator::Schedule(next, &IncastScheduler::startQuery, this);
+}
+
+void
+IncastScheduler :: begin() {
+    Simulator::Schedule(
+        Seconds(m_params.start + m_interarrival(m_rng)) - Simulator::Now(),
+        &IncastScheduler::startQuery, this
+    );
+}
+
+void
+IncastScheduler :: flowFinished(uint32_t source_address, uint16_t source_port, int64_t last_rx) {
+    auto member = m_members.find(((uint64_t) source_address << 16) | source_port);
+    if (member == m_members.end())
+        return;
+
+    uint32_t query = member->second;
+    m_members.erase(member);
+
+    incast_query &state = m_queries[query];
+    if (last_rx > state.last_rx)
+        state.last_rx = last_rx;
+
+    if (--state.pending == 0) {
+        m_num_completed++;
+        writeQuery(query, state, state.last_rx - state.start);
+        m_queries.erase(query);
+    }
+}
+
+void
+IncastScheduler :: writeQuery(uint32_t query, const incast_query &state, int64_t qct) {
+    if (m_output)
+        *m_output << query << "," << state.target << "," << m_params.fan_in << "," << m_params.size << ","
+                  << state.start << "," << qct << "\n";
+}
+
+void
+IncastScheduler :: close() {
+    // The queries that did not complete before the end, in order
+    map<uint32_t, incast_query> open(m_queries.begin(), m_queries.end());
+    for (auto const &elem: open)
+        writeQuery(elem.first, elem.second, -1);
+
+    m_queries.clear();
+    m_members.clear();
+}
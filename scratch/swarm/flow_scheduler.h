@@ -3,6 +3,8 @@
 
 #include <fstream>
 #include <map>
+#include <random>
+#include <unordered_map>
 #include <vector>
 #include <assert.h>
 #include <functional>
@@ -14,13 +16,15 @@ using namespace std;
  * A host flow is designated with its source and destination host
  * index (which uniquely gives the IP addresses), when it starts
  * and how big it is.
+ * The index is the position of the flow in the flow file.
  * We send the flows in a bulk, an application sends as much data as
  * it can until the full size is reached.
 */
 typedef struct host_flow_t {
-    uint16_t src, dst;
+    uint32_t src, dst;
     double t_arrival;
     uint32_t size;
+    uint32_t index;     // Position in the flow file, joins monitored flows with their entry
 } host_flow;
 
 /**
@@ -28,8 +32,10 @@ typedef struct host_flow_t {
  * and starts the application for a flow. This is the function that
  * we schedule for the arrival time of each flow.
  * Our implementation uses a SingleFlowApplication instance.
+ * It returns the local port of the flow on its source, 0 if the flow
+ * has no connection of its own.
 */
-typedef std::function<void(host_flow_t*)> host_flow_dispatcher;
+typedef std::function<uint16_t(host_flow_t*)> host_flow_dispatcher;
 
 /**
  * This calss reads a flow file and schedules each flow in a lazy 
@@ -118,4 +124,100 @@ class FlowScheduler {
         }
 };
 
+/**
+ * Parameters of the incast (partition-aggregate) workload: queries arrive
+ * as a Poisson process, and each one makes `fan_in` hosts send `size` bytes
+ * to a target host at the same time.
+*/
+typedef struct incast_params_t {
+    uint32_t fan_in;
+    uint32_t size;          // Bytes of the response of each sender
+    double rate;            // Queries per second
+    int32_t target;         // A host index, or one of the INCAST_TARGET_* values
+    double start, until;    // Queries arrive in between, in seconds
+    uint32_t seed;
+} incast_params;
+
+#define INCAST_TARGET_RANDOM -1
+#define INCAST_TARGET_ROUND_ROBIN -2
+
+/**
+ * This class generates incast queries on the fly instead of reading
+ * them from a flow file, one query at a time like FlowScheduler. The
+ * senders of a query go through the same dispatcher as the flows of the
+ * file, so they reuse the applications of their host.
+ * Every rank draws the same queries from the same seed, like every rank
+ * reads the same flow file. The rank of a target keeps its open queries
+ * and completes them with the flows its sinks see finish: the query
+ * completion time is the time from the query to the last byte of its
+ * slowest response, the max of the FCTs of its flows.
+*/
+class IncastScheduler {
+    private:
+        typedef struct incast_query_t {
+            uint32_t target;
+            uint32_t pending;       // Responses not finished yet
+            int64_t start;          // In ns
+            int64_t last_rx;        // Last byte of the responses finished so far, in ns
+        } incast_query;
+
+        incast_params m_params;
+        uint32_t m_num_hosts;
+        vector<uint32_t> m_host_addresses;
+        std::function<bool(uint32_t)> m_is_local;
+        host_flow_dispatcher m_dispatcher = nullptr;
+
+        uint32_t m_first_index;
+        uint32_t m_num_queries = 0;
+        uint32_t m_next_target = 0;
+        mt19937 m_rng;
+        exponential_distribution<double> m_interarrival;
+
+        // A permutation of the hosts and where each host is in it, the senders
+        // of a query are drawn by shuffling only as much of it as needed
+        vector<uint32_t> m_order;
+        vector<uint32_t> m_position;
+
+        unordered_map<uint32_t, incast_query> m_queries;    // Open queries of local targets
+        unordered_map<uint64_t, uint32_t> m_members;        // Source address and port --> query
+        ofstream *m_output = nullptr;
+        uint32_t m_num_completed = 0;
+
+        void swapHosts(uint32_t i, uint32_t j);
+        uint32_t pickTarget();
+        void startQuery();
+        void writeQuery(uint32_t query, const incast_query &state, int64_t qct);
+
+    public:
+        IncastScheduler(incast_params params, vector<uint32_t> host_addresses, uint32_t first_index,
+                        host_flow_dispatcher dispatcher, std::function<bool(uint32_t)> is_local);
+
+        void begin();
+
+        /**
+         * Writes `query,target,fan_in,size,start,qct` rows, times in ns, as
+         * queries complete. `close` adds the ones still open with a qct of -1.
+        */
+        void setOutput(ofstream *output) {
+            m_output = output;
+        }
+
+        /**
+         * A flow of `source_address:source_port` ended at a local sink with
+         * its last byte received at `last_rx` ns, flows of other queries are
+         * ignored.
+        */
+        void flowFinished(uint32_t source_address, uint16_t source_port, int64_t last_rx);
+
+        void close();
+
+        uint32_t getNumQueries() const {
+            return m_num_queries;
+        }
+
+        uint32_t getNumCompletedQueries() const {
+            return m_num_completed;
+        }
+};
+
 #endif /* FLOW_SCHEDULER_H */
\ No newline at end of file
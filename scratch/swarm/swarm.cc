@@ -1,11 +1,17 @@
 #include <chrono>
 #include <thread>
+#include <type_traits>
 #include <sys/stat.h>
 #include "swarm.h"
 #include "ns3/traffic-control-helper.h"
+#include "ns3/traffic-control-layer.h"
 #include "ns3/single-flow-helper.h"
+#include "ns3/multi-flow-source-helper.h"
 #include "ns3/flow-monitor-helper.h"
 #include "ns3/mpi-flow-monitor-helper.h"
+#include "ns3/mpi-link-monitor.h"
+#include "ns3/mpi-telemetry-exporter.h"
+#include "ns3/prober-application.h"
 
 
 using namespace ns3;
@@ -168,7 +174,6 @@ void ClosTopology :: createTopology() {
         }
     }
     this->installWcmpStack();
-    this->installRedQueueDisc();
 }
 
 void ClosTopology :: createLinks() {
@@ -470,7 +475,8 @@ void ClosTopology :: installRedQueueDisc() {
         "LinkDelay", StringValue (std::to_string(this->params.linkDelay) + "us"),
         // 50 For every 10 Gbps
         "MinTh", DoubleValue (50 * this->params.linkRate / 10),
-        "MaxTh", DoubleValue (150 * this->params.linkRate / 10)
+        "MaxTh", DoubleValue (150 * this->params.linkRate / 10),
+        "UseEcn", BooleanValue (true)
     );
 
     for (auto const & elem: this->serverToEdgeLinks) 
@@ -481,6 +487,30 @@ void ClosTopology :: installRedQueueDisc() {
         redHelper.Install(elem.second);
 }
 
+void ClosTopology :: collectLinkQueues() {
+    // Keep the queue discs and devices of both directions of each link, named `<from>:<to>`
+    auto collect = [this](const NetDeviceContainer &devices, const string &a, const string &b) {
+        for (uint32_t i = 0; i < 2; i++) {
+            string name = i ? b + ":" + a : a + ":" + b;
+            Ptr<NetDevice> from = devices.Get(i), to = devices.Get(1 - i);
+            this->linkDirections.push_back(std::make_tuple(name, from, to));
+
+            // Fabric devices have no address, so no default queue disc either without RED
+            Ptr<TrafficControlLayer> tc = from->GetNode()->GetObject<TrafficControlLayer>();
+            Ptr<QueueDisc> qdisc = tc ? tc->GetRootQueueDiscOnDevice(from) : nullptr;
+            if (qdisc)
+                this->queueDiscs.push_back(std::make_pair(name, qdisc));
+        }
+    };
+
+    for (auto const & elem: this->serverToEdgeLinks) 
+        collect(elem.second, "host" + std::to_string(std::get<1>(elem.first)), "edge" + std::to_string(std::get<0>(elem.first)));
+    for (auto const & elem: this->edgeToAggLinks) 
+        collect(elem.second, "edge" + std::to_string(std::get<0>(elem.first)), "agg" + std::to_string(std::get<1>(elem.first)));
+    for (auto const & elem: this->aggToCoreLinks) 
+        collect(elem.second, "agg" + std::to_string(std::get<0>(elem.first)), "core" + std::to_string(std::get<1>(elem.first)));
+}
+
 void ClosTopology :: doEcmp() {
     /**
      * The main constraint on the routing is that:
@@ -796,29 +826,6 @@ void ClosTopology :: setNodeCoordinates() {
 }
 #endif /* NETANIM_ENABLED */
 
-void ClosTopology :: echoBetweenHosts(uint32_t client_host, uint32_t server_host, double interval) {
-    Ptr<Node> ptr;
-    static uint32_t port = UDP_DISCARD_PORT;
-    
-    if ((ptr = this->getLocalHost(server_host))) {
-        UdpEchoServerHelper echoServer(port);
-        ptr = getHost(server_host);
-        this->serverApplications[server_host].Add(echoServer.Install(ptr));
-    }
-
-    if ((ptr = this->getLocalHost(client_host))) {
-        UdpEchoClientHelper echoClient(this->getServerAddress(server_host), port);
-        echoClient.SetAttribute("MaxPackets", UintegerValue(1));
-        echoClient.SetAttribute("Interval", TimeValue(Seconds(interval)));
-        echoClient.SetAttribute("PacketSize", UintegerValue(64));
-
-        ptr = getHost(client_host);
-        this->serverApplications[client_host].Add(echoClient.Install(ptr));
-    }
-
-    port++;
-}
-
 void ClosTopology :: unidirectionalCbrBetweenHosts(uint32_t client_host, uint32_t server_host, const string rate) {
     uint32_t port = getNextPort(server_host);
     Ptr<Node> ptr;
@@ -865,25 +872,59 @@ void ClosTopology :: bidirectionalCbrBetweenHosts(uint32_t client_host, uint32_t
 }
 
 void ClosTopology :: doAllToAllTcp(uint32_t totalNumberOfServers, const string scream_rate) {
+    /**
+     * One source and one sink per host instead of an OnOff application and
+     * a packet sink per ordered pair. Every pair is still offered
+     * `scream_rate` over its own connection.
+    */
+    Ptr<Node> ptr;
+    MultiFlowSourceHelper source("ns3::TcpSocketFactory");
+    source.SetAttribute("DataRate", StringValue(scream_rate));
+    source.SetAttribute("PacketSize", UintegerValue(TCP_PACKET_SIZE));
+
     for (uint32_t i = 0; i < totalNumberOfServers; i++) {
+        if (!(ptr = this->getLocalHost(i)))
+            continue;
+
+        FlowSinkHelper sink("ns3::TcpSocketFactory", InetSocketAddress(this->getServerAddress(i), TCP_SCREAM_PORT));
+        this->serverApplications[i].Add(sink.Install(ptr));
+
+        std::vector<Address> destinations;
+        destinations.reserve(totalNumberOfServers - 1);
         for (uint32_t j = 0; j < totalNumberOfServers; j++) {
             if (i == j)
                 continue;
-            this->unidirectionalCbrBetweenHosts(i, j, scream_rate);
+            destinations.push_back(InetSocketAddress(this->getServerAddress(j), TCP_SCREAM_PORT));
         }
+        this->serverApplications[i].Add(source.Install(ptr, destinations));
+        SWARM_DEBG_ALL("Installed scream source and sink on " << i);
     }
 }
 
-void ClosTopology :: doAllToAllPing(uint32_t totalNumberOfServers) {
+void ClosTopology :: doAllToAllPing(uint32_t totalNumberOfServers, Ptr<MpiReachabilityMatrix> matrix) {
+    /**
+     * One prober per host probes all others from a single socket. Host i
+     * probes i + 1, i + 2, ... so that no host gets probed by everyone at
+     * once. Replies land in the rows of the local hosts of the matrix.
+    */
+    Ptr<Node> ptr;
     for (uint32_t i = 0; i < totalNumberOfServers; i++) {
-        for (uint32_t j = 0; j < totalNumberOfServers; j++) {
-            if (i == j)
-                continue;
-            this->echoBetweenHosts(i, j);
+        if (!(ptr = this->getLocalHost(i)))
+            continue;
+
+        Ptr<ProberApplication> prober = CreateObject<ProberApplication>();
+        prober->SetAttribute("Port", UintegerValue(UDP_DISCARD_PORT));
+        for (uint32_t k = 1; k < totalNumberOfServers; k++) {
+            uint32_t j = (i + k) % totalNumberOfServers;
+            prober->AddDestination(InetSocketAddress(this->getServerAddress(j), UDP_DISCARD_PORT), j);
         }
+        prober->TraceConnectWithoutContext("Rtt", MakeBoundCallback(&MpiReachabilityMatrix::RttLogger, matrix, i));
+        ptr->AddApplication(prober);
+        this->serverApplications[i].Add(prober);
     }
 }
 
+
 std::tuple<ns3::Ptr<ns3::Node>, uint32_t, ns3::Ptr<ns3::Node>, uint32_t> ClosTopology :: getLinkInterfaceIndices(topology_level src_level, 
     uint32_t src_idx, topology_level dst_level, uint32_t dst_idx) 
 {
@@ -1108,7 +1149,37 @@ uint16_t torLevelMapper(ns3::Ipv4Address dest, const topology_descriptor_t *topo
     return (uint16_t) p[2] * topo_params->switchRadix/2 + p[1];
 }
 
-void closHostFlowDispatcher(host_flow *flow, const ClosTopology *topo) {
+int64_t getIdealFct(const host_flow *flow, const ClosTopology *topo) {
+    /**
+     * The FCT of a flow alone on the network, which is what its slowdown
+     * is measured against. The monitor times a flow from its SYN until the
+     * FIN arrives, so this is:
+     *  - One round trip for the handshake
+     *  - The propagation delay of the path, once more for the data
+     *  - Serializing all the data packets, headers included, on one link
+     *  - Storing and forwarding one full packet on every other hop
+    */
+    const topolgoy_descriptor &params = topo->params;
+    uint32_t src_edge = flow->src / params.numServers;
+    uint32_t dst_edge = flow->dst / params.numServers;
+
+    uint32_t hops = 6;
+    if (src_edge == dst_edge)
+        hops = 2;
+    else if (src_edge / (params.switchRadix / 2) == dst_edge / (params.switchRadix / 2))
+        hops = 4;
+
+    const uint32_t mss = 1460, header_bytes = 40 + 2;   // TCP/IP and PPP headers
+    uint64_t num_packets = flow->size / mss + (flow->size % mss != 0);
+    uint64_t wire_bytes = flow->size + num_packets * header_bytes;
+
+    double ns_per_byte = 8.0 / params.linkRate;
+    double propagation = hops * params.linkDelay * 1e3;
+
+    return 3 * propagation + wire_bytes * ns_per_byte + (hops - 1) * (mss + header_bytes) * ns_per_byte;
+}
+
+uint16_t closHostFlowDispatcher(host_flow *flow, const ClosTopology *topo) {
     /**
      * Given a host_flow struct, we should decide how to schedule it on 
      * the current topology.
@@ -1125,16 +1196,67 @@ void closHostFlowDispatcher(host_flow *flow, const ClosTopology *topo) {
 
     Ptr<Node> ptr;
     static SingleFlowHelper singleFlowClient("ns3::TcpSocketFactory");
+    static PersistentFlowHelper persistentClient("ns3::TcpSocketFactory");
+
+    // The flow is a message on the connection of its host pair, the sink on
+    // the destination reports its completion
+    if (param_persistent) {
+        if ((ptr = topo->getLocalHost(flow->src))) {
+            persistentClient.SendMessage(
+                ptr, InetSocketAddress(topo->getServerAddress(flow->dst), TCP_DISCARD_PORT),
+                flow->index, flow->size
+            );
+        }
+        return 0;
+    }
+
+    // Taken on every rank, so the receiver's rank knows the five-tuple as well
+    uint16_t port = getNextPort(flow->src);
+
+    // Addresses of the hosts and the flow parameters that never change, built
+    // on the first flow so that the rest only fill in a FlowConfig instead of
+    // going through the attribute system (and parsing the rate) every time
+    static std::vector<Ipv4Address> hostAddresses;
+    static std::vector<Address> sinkAddresses;
+    static SingleFlowApplication::FlowConfig config;
+    if (hostAddresses.empty()) {
+        uint32_t numHosts = topo->params.numPods * topo->params.switchRadix * topo->params.numServers / 2;
+        hostAddresses.reserve(numHosts);
+        sinkAddresses.reserve(numHosts);
+        for (uint32_t i = 0; i < numHosts; i++) {
+            hostAddresses.push_back(topo->getServerAddress(i));
+            sinkAddresses.push_back(InetSocketAddress(hostAddresses.back(), TCP_DISCARD_PORT));
+        }
+
+        config.rate = DataRate(static_cast<uint64_t>(topo->params.linkRate) * 1000000000);
+        // config.packetSize = TCP_PACKET_SIZE;
+        config.packetSize = 6000;
+        config.bulk = param_bulk;
+        if (tcp_events_helper)
+            singleFlowClient.SetSocketTraceSink(MakeCallback(&MpiFlowMonitorHelper::TraceTcpSocket, tcp_events_helper));
+    }
 
     if ((ptr = topo->getLocalHost(flow->src))) {
-        singleFlowClient.SetAttribute("Remote", AddressValue(InetSocketAddress(topo->getServerAddress(flow->dst), TCP_DISCARD_PORT)));
-        singleFlowClient.SetAttribute("DataRate", StringValue(std::to_string(topo->params.linkRate) + "Gbps"));
-        singleFlowClient.SetAttribute("Local", AddressValue(InetSocketAddress(topo->getServerAddress(flow->src), getNextPort(flow->src))));
-        // singleFlowClient.SetAttribute("PacketSize", UintegerValue(TCP_PACKET_SIZE));
-        singleFlowClient.SetAttribute("PacketSize", UintegerValue(6000));
-        singleFlowClient.SetAttribute("FlowSize", UintegerValue(flow->size));
-        singleFlowClient.Install(ptr).Start(Time(0));
+        config.remote = sinkAddresses[flow->dst];
+        config.local = InetSocketAddress(hostAddresses[flow->src], port);
+        config.flowSize = flow->size;
+        // Reuses an application of the host whose flow is done, hosts keep as many as their peak of concurrent flows
+        singleFlowClient.InstallFromPool(ptr, config);
+    }
+
+    // The MPI monitor sees the flow finish on the receiver, join it with its
+    // flow file entry there so its slowdown is computed online
+    if (flow_info_helper && topo->getLocalHost(flow->dst)) {
+        uint32_t src_pod = (flow->src / topo->params.numServers) / (topo->params.switchRadix / 2);
+        MpiFlowInfo info = {flow->index, flow->size, getIdealFct(flow, topo), src_pod};
+        flow_info_helper->RegisterFlow(
+            hostAddresses[flow->src], port,
+            hostAddresses[flow->dst], TCP_DISCARD_PORT,
+            info
+        );
     }
+
+    return port;
 }
 
 template<typename... Args> void schedule(double t, link_state_change_func func, Args... args) {
@@ -1153,6 +1275,16 @@ template<typename... Args> void schedule(double t, host_traffic_migration_func f
     ns3::Simulator::Schedule(ns3::Seconds(t), func, args...);
 }
 
+void reportMessageCompletion(const SeqTsSizeHeader &header, const Address &from) {
+    // index,size,start,fct in ns, the flow file gives the hosts of each index
+    message_output << header.GetSeq() << "," << header.GetSize() - header.GetSerializedSize() << ","
+                   << header.GetTs().GetNanoSeconds() << "," << (Simulator::Now() - header.GetTs()).GetNanoSeconds() << "\n";
+}
+
+void reportIncastFlow(IncastScheduler *incastScheduler, const FlowSinkRecord &record) {
+    incastScheduler->flowFinished(record.sourceAddress, record.sourcePort, record.timeLastRx);
+}
+
 void reportTimeProgress(double end) {
     float progress;
     progress = (Simulator::Now().GetSeconds() - APPLICATION_START_TIME) / (end - APPLICATION_START_TIME);
@@ -1243,13 +1375,32 @@ void parseCmd(int argc, char* argv[], topolgoy_descriptor *topo_params) {
 
     // Simulation options
     cmd.AddValue("monitor", "Install FlowMonitor on the network", param_monitor);
-    cmd.AddValue("scream", "Instruct all servers to scream at a given rate for the whole simulation", param_screamRate);
-    cmd.AddValue("pingall", "Instruct all servers to ping each other in the beginning", param_pingall);
+    cmd.AddValue("flowmon", "Use the stock ns-3 FlowMonitor with delay/jitter histograms and per-probe stats, written to swarm-flow.xml (single process only)", param_flowmon);
+    cmd.AddValue("scream", "Instruct all servers to scream at a given rate to every other server for the whole simulation", param_screamRate);
+    cmd.AddValue("pingall", "Instruct all servers to ping each other in the beginning and write the RTT matrix into <out>-pingall.csv", param_pingall);
     cmd.AddValue("micro", "Set time resolution to micro-seconds", param_micro);
     cmd.AddValue("noAcks", "Do not monitor ACKs", param_no_acks);
     cmd.AddValue("tcp", "Set the TCP variant to use", param_tcp_variant);
+    cmd.AddValue("red", "Install RED queue discs with ECN marking on both directions of every link", param_red);
+    cmd.AddValue("sinkRecords", "Write the bytes and first/last byte times of every flow seen by the packet sinks into <out>-sink-<rank>.bin, no flow monitor needed", param_sink_records);
+    cmd.AddValue("persistent", "Send flows as messages over one long-lived connection per host pair and write their completion times into <out>-messages-<rank>.csv", param_persistent);
+    cmd.AddValue("bulk", "Let TCP pull flow data from the socket buffer instead of pacing it at the link rate with one timer per packet", param_bulk);
+    cmd.AddValue("incast", "Start incast queries at this rate per second and write their completion times into <out>-incast-<rank>.csv, 0 disables it", param_incast_rate);
+    cmd.AddValue("incastFanIn", "Number of hosts responding to each incast query", param_incast_fan_in);
+    cmd.AddValue("incastSize", "Bytes each host responds with to an incast query", param_incast_size);
+    cmd.AddValue("incastTarget", "Target of the incast queries: random, roundrobin or a host index", param_incast_target);
     cmd.AddValue("out", "Flow Monitor output prefix name", FLOW_FILE_PREFIX);
     cmd.AddValue("until", "When to stop monitoring new flows", param_monitor_until);
+    cmd.AddValue("sample", "Only monitor 1-in-N flows, picked by a hash of their five-tuple (MPI monitor only)", param_sampling_rate);
+    cmd.AddValue("hopSample", "Trace per-hop delays of 1-in-N packets of monitored flows on all switches, 0 disables it (MPI monitor only)", param_hop_sampling_rate);
+    cmd.AddValue("snapshot", "Append goodput and active/completed flow counts per size class and source pod to a binary file every this many seconds, 0 disables it (MPI monitor only)", param_snapshot_interval);
+    cmd.AddValue("linkStats", "Write the mean/max queue length, marks and drops of every link queue disc every this many seconds, sampled every 10us, 0 disables it", param_link_stats_interval);
+    cmd.AddValue("linkDrops", "Count the drops of every link direction by reason and write them as a matrix on rank 0", param_link_drops);
+    cmd.AddValue("tcpEvents", "Count RTOs, fast retransmits and ECN window reductions of every flow in its record (MPI monitor only)", param_tcp_events);
+    cmd.AddValue("telemetry", "Publish live counters of each rank every second into the shared memory ring /dev/shm/<name>-<rank>", param_telemetry);
+    cmd.AddValue("binary", "Write compact binary flow records instead of XML (MPI monitor only)", param_binary);
+    cmd.AddValue("merge", "Gather binary flow records into a single file and summary on rank 0 (MPI monitor only)", param_merge);
+    cmd.AddValue("sketch", "Only report FCT/throughput percentiles of completed flows, no per-flow output (MPI monitor only)", param_sketch);
     
     #if MPI_ENABLED
     cmd.AddValue("mpi", "Enable MPI", topo_params->mpi);
@@ -1328,10 +1479,15 @@ void setupClosTopology(ClosTopology *nodes) {
     // Create nodes and links
     nodes->createTopology();
     nodes->createLinks();
+    if (param_red) {
+        SWARM_INFO("Installing RED queue discs with ECN on all links");
+        nodes->installRedQueueDisc();
+    }
 
     // Assign IP addresses and create fabric interfaces
     nodes->assignServerIps();
     nodes->createFabricInterfaces();
+    nodes->collectLinkQueues();
 
     // Do ECMP
     nodes->setupServerRouting();
@@ -1356,20 +1512,58 @@ void setupMonitoringAndBeingExperiment(
 
     // Setup flow monitor
     T flowMonitorHelper;
+    if constexpr (std::is_same_v<T, MpiFlowMonitorHelper>) {
+        if (param_sketch)
+            flowMonitorHelper.SetMonitorAttribute("PerFlowStats", BooleanValue(false));
+    }
+
     if (param_monitor) {
         Ptr<Node> ptr;
+        auto t_install = std::chrono::steady_clock::now();
         SWARM_INFO("Installing Flow Monitor on all local servers");
         for (uint32_t i = 0; i < totalNumberOfServers; i++) {
             if ((ptr = nodes->getLocalHost(i))) {
                 flowMonitorHelper.Install(ptr);
             }
         }
+
+        if constexpr (std::is_same_v<T, MpiFlowMonitorHelper>)
+            flow_info_helper = &flowMonitorHelper;
+
+        if constexpr (std::is_same_v<T, MpiFlowMonitorHelper>) {
+            if (param_hop_sampling_rate) {
+                SWARM_INFO("Installing hop delay probes on all local switches");
+                flowMonitorHelper.InstallHopProbes(nodes->getLocalSwitches());
+            }
+        }
+
+        if constexpr (std::is_same_v<T, MpiFlowMonitorHelper>) {
+            if (param_snapshot_interval > 0) {
+                SWARM_INFO("Writing snapshots every " << param_snapshot_interval << " s into prefix " + flow_output_file_name + "-snapshots");
+                flowMonitorHelper.EnableSnapshots(flow_output_file_name, Seconds(param_snapshot_interval));
+            }
+        }
+        else if (param_snapshot_interval > 0)
+            SWARM_WARN("Snapshots need the MPI flow monitor, ignoring --snapshot");
+
+        if constexpr (std::is_same_v<T, MpiFlowMonitorHelper>) {
+            if (param_tcp_events) {
+                SWARM_INFO("Counting TCP congestion events of every flow");
+                tcp_events_helper = &flowMonitorHelper;
+            }
+        }
+        else if (param_tcp_events)
+            SWARM_WARN("TCP event counters need the MPI flow monitor, ignoring --tcpEvents");
+
+        std::chrono::duration<float> took = std::chrono::steady_clock::now() - t_install;
+        SWARM_INFO("Flow Monitor installed in " << (std::chrono::duration_cast<std::chrono::milliseconds>(took).count()) / 1000.0 << " s");
     }
 
-    // Get the flow file
+    // Get the flow file and the incast queries
     FlowScheduler *flowScheduler = nullptr;
-    if (param_flow_file_path.length()) {
-        SWARM_INFO("Scheduling flows on network from " << param_flow_file_path);
+    IncastScheduler *incastScheduler = nullptr;
+    if (param_flow_file_path.length() || param_incast_rate > 0) {
+        NS_ABORT_MSG_IF(param_incast_rate > 0 && param_persistent, "Incast queries need one connection per flow, they do not work with --persistent");
 
         // Bind the flow dispatcher function
         host_flow_dispatcher_function = [nodes](host_flow *flow) {
@@ -1377,10 +1571,66 @@ void setupMonitoringAndBeingExperiment(
         };
 
         // Install packet sinks on each server
-        nodes->installTcpPacketSinks();
+        if (param_persistent) {
+            std::string message_file_name = FLOW_FILE_PREFIX + "-messages-" + std::to_string(systemId) + ".csv";
+            SWARM_INFO("Sending flows as messages over one connection per host pair, completions go into " + message_file_name);
+            message_output.open(message_file_name, std::ios::out | std::ios::trunc);
+            NS_ABORT_MSG_IF(!message_output.is_open(), "Could not open " << message_file_name);
+            message_output << "index,size,start,fct\n";
+            nodes->installTcpMessageSinks(MakeCallback(&reportMessageCompletion));
+        }
+        else
+            nodes->installTcpPacketSinks();
 
         // Create the flow scheduler
-        flowScheduler = new FlowScheduler(param_flow_file_path, host_flow_dispatcher_function);
+        if (param_flow_file_path.length()) {
+            SWARM_INFO("Scheduling flows on network from " << param_flow_file_path);
+            flowScheduler = new FlowScheduler(param_flow_file_path, host_flow_dispatcher_function);
+        }
+    }
+
+    if (param_incast_rate > 0) {
+        incast_params incast;
+        incast.fan_in = param_incast_fan_in;
+        incast.size = param_incast_size;
+        incast.rate = param_incast_rate;
+        if (param_incast_target == "random")
+            incast.target = INCAST_TARGET_RANDOM;
+        else if (param_incast_target == "roundrobin")
+            incast.target = INCAST_TARGET_ROUND_ROBIN;
+        else {
+            NS_ABORT_MSG_IF(param_incast_target.empty() || param_incast_target.size() > 9
+                || param_incast_target.find_first_not_of("0123456789") != std::string::npos
+                || std::stoul(param_incast_target) >= totalNumberOfServers,
+                "--incastTarget must be random, roundrobin or a host index below " << totalNumberOfServers
+                << ", not " << param_incast_target);
+            incast.target = std::stoul(param_incast_target);
+        }
+        incast.start = APPLICATION_START_TIME;
+        incast.until = param_end;
+        incast.seed = RngSeedManager::GetRun();
+
+        vector<uint32_t> host_addresses;
+        for (uint32_t i = 0; i < totalNumberOfServers; i++)
+            host_addresses.push_back(nodes->getServerAddress(i).Get());
+
+        // Indices of the incast flows follow the ones of the flow file
+        incastScheduler = new IncastScheduler(
+            incast, host_addresses, flowScheduler ? flowScheduler->getNumFlows() : 0,
+            host_flow_dispatcher_function, [nodes](uint32_t host) { return bool(nodes->getLocalHost(host)); }
+        );
+
+        std::string incast_file_name = FLOW_FILE_PREFIX + "-incast-" + std::to_string(systemId) + ".csv";
+        SWARM_INFO("Starting " << param_incast_rate << " incast queries per second with a fan-in of " << param_incast_fan_in
+            << ", completion times go into " + incast_file_name);
+        incast_output.open(incast_file_name, std::ios::out | std::ios::trunc);
+        NS_ABORT_MSG_IF(!incast_output.is_open(), "Could not open " << incast_file_name);
+        incast_output << "query,target,fan_in,size,start,qct\n";
+        incastScheduler->setOutput(&incast_output);
+
+        // The sinks of the targets complete the queries
+        for (uint32_t i = 0; i < nodes->getFlowSinks().GetN(); i++)
+            nodes->getFlowSinks().Get(i)->TraceConnectWithoutContext("Flow", MakeBoundCallback(&reportIncastFlow, incastScheduler));
     }
 
     // Bind scenario functions and get the file
@@ -1404,14 +1654,56 @@ void setupMonitoringAndBeingExperiment(
         nodes->doAllToAllTcp(totalNumberOfServers, param_screamRate);
     }
 
+    Ptr<MpiReachabilityMatrix> pingMatrix;
     if (param_pingall) {
         SWARM_INFO("Doing a global ping");
-        nodes->doAllToAllPing(totalNumberOfServers);
+        pingMatrix = CreateObject<MpiReachabilityMatrix>();
+        pingMatrix->SetNumHosts(totalNumberOfServers);
+        nodes->doAllToAllPing(totalNumberOfServers, pingMatrix);
+    }
+
+    // Queue telemetry of the link queue discs and drop counters of the links on this rank
+    Ptr<MpiLinkMonitor> linkMonitor;
+    if (param_link_stats_interval > 0 || param_link_drops) {
+        linkMonitor = CreateObject<MpiLinkMonitor>();
+        linkMonitor->SetSystemId(systemId);
+    }
+
+    if (param_link_stats_interval > 0) {
+        linkMonitor->SetAttribute("ReportInterval", TimeValue(Seconds(param_link_stats_interval)));
+        for (auto const &elem: nodes->getLocalQueueDiscs())
+            linkMonitor->AddQueueDisc(elem.second, elem.first);
+
+        SWARM_INFO("Writing queue statistics of " << linkMonitor->GetNQueueDiscs() << " queues into prefix " + flow_output_file_name + "-links");
+        linkMonitor->Start(flow_output_file_name);
+    }
+
+    if (param_link_drops) {
+        for (auto const &elem: nodes->getLinkDirections())
+            linkMonitor->AddLink(std::get<1>(elem), std::get<2>(elem), std::get<0>(elem));
+        SWARM_INFO("Counting drops on " << linkMonitor->GetNLinks() << " link directions");
+    }
+
+    // Live counters for dashboards and watchdogs, sampled by a thread outside of the simulation
+    Ptr<MpiTelemetryExporter> telemetry;
+    if (param_telemetry.length()) {
+        telemetry = CreateObject<MpiTelemetryExporter>();
+        telemetry->SetSystemId(systemId);
+        if constexpr (std::is_same_v<T, MpiFlowMonitorHelper>) {
+            if (param_monitor)
+                telemetry->SetFlowMonitor(flowMonitorHelper.GetMonitor());
+        }
+        telemetry->SetLinkMonitor(linkMonitor);
+
+        SWARM_INFO("Publishing live telemetry into /dev/shm/" + param_telemetry + "-" << systemId);
+        telemetry->Start(param_telemetry);
     }
 
     SWARM_INFO("Starting applications");
     if (flowScheduler)
         flowScheduler->begin();
+    if (incastScheduler)
+        incastScheduler->begin();
 
     nodes->startApplications(APPLICATION_START_TIME, param_end);
 
@@ -1421,20 +1713,78 @@ void setupMonitoringAndBeingExperiment(
 
     Simulator::Stop(Seconds(param_end + QUIET_INTERVAL_LENGTH));
     Simulator::Run();
+    tcp_events_helper = nullptr;
+    if (flow_info_helper) {
+        // flows whose first packet never made it, nothing will take them now
+        flow_info_helper->ClearRegisteredFlows();
+        flow_info_helper = nullptr;
+    }
+    if (param_sink_records) {
+        std::string sink_file_name = FLOW_FILE_PREFIX + "-sink-" + std::to_string(systemId) + ".bin";
+        uint64_t records = FlowSinkHelper::SerializeToFile(sink_file_name, systemId, nodes->getFlowSinks());
+        SWARM_INFO("Wrote " << records << " sink records into " + sink_file_name);
+    }
+    if (telemetry)
+        telemetry->Stop();
+    if (linkMonitor)
+        linkMonitor->Stop();
     Simulator::Destroy();
 
     if (flowScheduler) {
         flowScheduler->close();
         delete flowScheduler;
     }
+    if (message_output.is_open())
+        message_output.close();
+    if (incastScheduler) {
+        incastScheduler->close();
+        SWARM_INFO_ALL("Started " << incastScheduler->getNumQueries() << " incast queries, "
+            << incastScheduler->getNumCompletedQueries() << " of the ones targeting this rank completed");
+        delete incastScheduler;
+        incast_output.close();
+    }
 
     auto t_end = std::chrono::system_clock::now();
 
     std::chrono::duration<float> took = t_end - t_start;
     SWARM_INFO("Run finished! Took " << (std::chrono::duration_cast<std::chrono::milliseconds>(took).count()) / 1000.0 << " s");
 
+    if (pingMatrix) {
+        uint64_t unreachable = pingMatrix->SerializeToFile(FLOW_FILE_PREFIX);
+        SWARM_INFO("Wrote the RTT matrix of the global ping into " + FLOW_FILE_PREFIX + "-pingall.csv, " << unreachable << " pairs did not reply");
+    }
+
+    if (param_link_drops) {
+        SWARM_INFO("Writing drops per link into " + flow_output_file_name + "-drops.csv");
+        linkMonitor->SerializeDropsToFile(flow_output_file_name);
+    }
+
     // Serialize the results
     if (param_monitor) {
+        if constexpr (std::is_same_v<T, MpiFlowMonitorHelper>) {
+            if (param_hop_sampling_rate) {
+                SWARM_INFO("Serializing hop delays into prefix " + flow_output_file_name + "-hops");
+                flowMonitorHelper.SerializeHopDelaysToFile(flow_output_file_name);
+            }
+            if (param_sketch) {
+                SWARM_INFO("Writing FCT summary of all ranks into " + flow_output_file_name + "-summary.txt");
+                flowMonitorHelper.SerializeSummaryToFile(flow_output_file_name);
+                return;
+            }
+            if (param_merge) {
+                SWARM_INFO("Merging flow records on rank 0 into " + flow_output_file_name);
+                flowMonitorHelper.SerializeToMergedFile(flow_output_file_name);
+                return;
+            }
+            if (param_binary) {
+                SWARM_INFO("Serializing flow records into prefix " + flow_output_file_name);
+                flowMonitorHelper.SerializeToBinaryFile(flow_output_file_name);
+                return;
+            }
+        }
+        else if (param_binary || param_merge || param_sketch || param_hop_sampling_rate)
+            SWARM_WARN("Binary records, sketches and hop tracing need the MPI flow monitor, falling back to XML");
+
         SWARM_INFO("Serializing FCT information into prefix " + flow_output_file_name);
         flowMonitorHelper.SerializeToXmlFile(flow_output_file_name, false, false);
     }
@@ -1476,7 +1826,6 @@ int main(int argc, char *argv[]) {
     Ipv4RoutingHelper::PrintRoutingTableAt(Seconds(1.0), nodes.getCore(1), routingStream);
 
     // Setup FlowMonitor and begin the experiment
-    #if MPI_ENABLED
     MpiFlowMonitorHelper::SetSystemId(systemId);
     
     if (param_no_acks)
@@ -1485,28 +1834,37 @@ int main(int argc, char *argv[]) {
     if (param_monitor_until)
         MpiFlowMonitorHelper::SetMonitorUntil(param_monitor_until + APPLICATION_START_TIME);
 
-    if (topo_params.mpi) {
-        setupMonitoringAndBeingExperiment<MpiFlowMonitorHelper>(
-            &nodes, 
-            totalNumberOfServers,
-            FLOW_FILE_PREFIX
-        );
+    NS_ABORT_MSG_IF(param_sampling_rate == 0, "--sample must be at least 1, use 1 to monitor every flow");
+    if (param_sampling_rate > 1)
+        MpiFlowMonitorHelper::SetSamplingRate(param_sampling_rate);
 
-        MpiInterface::Disable();
+    if (param_hop_sampling_rate)
+        MpiFlowMonitorHelper::SetHopSamplingRate(param_hop_sampling_rate);
+
+    if (param_flowmon && topo_params.mpi) {
+        SWARM_WARN("The stock FlowMonitor does not work under MPI, ignoring --flowmon");
+        param_flowmon = false;
     }
-    else {
+
+    // The MPI monitor works in a single process too, where it writes the same outputs as rank 0
+    if (param_flowmon) {
         setupMonitoringAndBeingExperiment<FlowMonitorHelper>(
             &nodes, 
             totalNumberOfServers,
             FLOW_FILE_OUTPUT
         );
     }
-    #else
-        setupMonitoringAndBeingExperiment<FlowMonitorHelper>(
+    else {
+        setupMonitoringAndBeingExperiment<MpiFlowMonitorHelper>(
             &nodes, 
             totalNumberOfServers,
-            FLOW_FILE_OUTPUT
+            FLOW_FILE_PREFIX
         );
+    }
+
+    #if MPI_ENABLED
+    if (topo_params.mpi)
+        MpiInterface::Disable();
     #endif
 
     return 0;
@@ -25,6 +25,11 @@
 #include "ns3/applications-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/wcmp-static-routing-helper.h"
+#include "ns3/mpi-flow-monitor-helper.h"
+#include "ns3/mpi-reachability-matrix.h"
+#include "ns3/persistent-flow-helper.h"
+#include "ns3/flow-sink-helper.h"
+#include "ns3/queue-disc.h"
 
 using namespace std;
 
@@ -100,6 +105,7 @@ const uint32_t DEFAULT_NUM_SERVERS = DEFAULT_SWITCH_RADIX / 2;
 */
 #define UDP_DISCARD_PORT 9                         // For UDP packet sinks
 #define TCP_DISCARD_PORT 10                        // For TCP packet sinks
+#define TCP_SCREAM_PORT 11                         // For the sinks of the all-to-all scream
 #define TCP_LOCAL_START_PORT 20                    // The starting local port for binding
 
 #define UDP_PACKET_SIZE_BIG 1024
@@ -147,12 +153,39 @@ ns3::if_up_down_func wcmp_if_up_func;
 */
 host_flow_dispatcher host_flow_dispatcher_function;
 
+/**
+ * Counts the TCP events of dispatched flows when set
+*/
+ns3::MpiFlowMonitorHelper *tcp_events_helper = nullptr;
+
+/**
+ * Joins dispatched flows with their flow file entry when set
+*/
+ns3::MpiFlowMonitorHelper *flow_info_helper = nullptr;
+
+/**
+ * Completion times of the messages received on this rank, with persistent connections
+*/
+std::ofstream message_output;
+
+/**
+ * Completion times of the incast queries targeting hosts of this rank
+*/
+std::ofstream incast_output;
+
 /************************************
  *  Simulation inputs
 ************************************/
 
 double param_end = 4.0;                       // When simulation ends in seconds
 double param_monitor_until = 3.0;             // When to stop monitoring new flows?
+uint32_t param_sampling_rate = 1;             // Monitor 1-in-N flows
+uint32_t param_hop_sampling_rate = 0;         // Trace per-hop delays of 1-in-N packets, 0 is off
+double param_snapshot_interval = 0;           // Period of the goodput snapshots in seconds, 0 is off
+double param_link_stats_interval = 0;         // Period of the queue telemetry rows in seconds, 0 is off
+bool param_link_drops = false;                // Count drops per link direction and reason
+std::string param_telemetry = "";             // Shared memory name of the live telemetry, empty is off
+bool param_tcp_events = false;                // Count RTOs, fast retransmits and ECN reductions per flow
 
 std::string param_flow_file_path = "";        // Path to traffic file
 std::string param_scneario_file_path = "";    // Path to scenario file
@@ -164,7 +197,19 @@ bool param_monitor = false;                   // Enable FlowMonitor and FCT repo
 bool param_plain_ecmp = false;                // Do plain ECMP
 bool param_use_cache = false;                 // Use ECMP/WCMP cache
 bool param_no_acks = false;                   // Do not monitor ACK flows
+bool param_red = false;                       // Install RED with ECN marking on every link
+bool param_flowmon = false;                   // Use the stock FlowMonitor instead of the MPI one
+bool param_bulk = false;                      // Fill socket buffers instead of pacing flows with timers
+bool param_persistent = false;                // Send flows as messages over one connection per host pair
+double param_incast_rate = 0;                 // Incast queries per second, 0 is off
+uint32_t param_incast_fan_in = 8;             // Senders of each incast query
+uint32_t param_incast_size = 20000;           // Bytes each incast sender responds with
+std::string param_incast_target = "random";   // Target of the incast queries: random, roundrobin or a host index
+bool param_sink_records = false;              // Write what the packet sinks saw of every flow
 bool param_pingall = false;                   // Pingall servers in the beginning
+bool param_binary = false;                    // Write binary flow records instead of XML
+bool param_merge = false;                     // Gather binary flow records on rank 0
+bool param_sketch = false;                    // Only keep FCT/throughput sketches, no per-flow stats
 
 #if MPI_ENABLED
 uint32_t param_pod_procs = DEFAULT_NUM_PODS;  // Number of processes for pod
@@ -236,12 +281,18 @@ class ClosTopology {
         map<tuple<uint32_t, uint32_t>, ns3::NetDeviceContainer> aggToCoreLinks;
         map<tuple<uint32_t, uint32_t>, ns3::NetDeviceContainer> serverToEdgeLinks;
 
+        // The root queue discs of all links, one per direction, named after the link
+        vector<pair<string, ns3::Ptr<ns3::QueueDisc>>> queueDiscs;
+        // Both directions of every link as (name, sending device, receiving device)
+        vector<tuple<string, ns3::Ptr<ns3::NetDevice>, ns3::Ptr<ns3::NetDevice>>> linkDirections;
+
         // These hold the NIC and IPv4 interfaces of the servers, given the ToR index
         map<uint32_t, ns3::NetDeviceContainer> serverDevices;
         map<uint32_t, ns3::Ipv4InterfaceContainer> serverInterfaces;
 
         // Application containers for each server
         vector<ns3::ApplicationContainer> serverApplications;
+        ns3::ApplicationContainer flowSinks;    // Sinks of the flow file flows on this rank
  
         #if NETANIM_ENABLED
         ns3::AnimationInterface *anim = NULL;
@@ -292,9 +343,19 @@ class ClosTopology {
          * DCTCP. We use the same configuration rationale outlined for that
          * protocol. You may wish to see the DCTCP example of NS-3 to see what
          * those are.
+         * This needs the links, and should be called before any IP address is
+         * assigned, otherwise the address helper installs its own default
+         * queue discs on the servers.
         */
         void installRedQueueDisc();
 
+        /**
+         * Name both directions of every link and keep the root queue disc of
+         * each, whichever was installed, for the link telemetry. Call it once
+         * the IP addresses are assigned.
+        */
+        void collectLinkQueues();
+
         /**
          * This is technically WCMP, but without explicit
          * modification by the user in terms of what weights to use, it just
@@ -345,11 +406,6 @@ class ClosTopology {
         void doUpdateWcmp(topology_level node_level, uint32_t node_idx, uint32_t interface_idx, uint16_t level, uint16_t weight);
         void doSetLinkLoss(topology_level src_level, uint32_t src_idx, topology_level dst_level, uint32_t dst_idx, const string packetLossRate);
 
-        /**
-         * Just a UDP echo between two hosts.
-        */
-        void echoBetweenHosts(uint32_t client_host, uint32_t server_host, double interval=0.1);
-
         /**
          * Open a CBR TCP stream from one host to another with a given rate.
          * The bidirectional case does this for both sides.
@@ -362,7 +418,7 @@ class ClosTopology {
          * network for debugging.
         */
         void doAllToAllTcp(uint32_t totalNumberOfServers, const string scream_rate);
-        void doAllToAllPing(uint32_t totalNumberOfServers);
+        void doAllToAllPing(uint32_t totalNumberOfServers, ns3::Ptr<ns3::MpiReachabilityMatrix> matrix);
 
         /**
          * These utility functions are pretty self-explanatory.
@@ -456,6 +512,49 @@ class ClosTopology {
             return getHost(host_idx);
         }
 
+        /**
+         * The root queue discs on nodes of the current rank, along with the
+         * name of their link as `<from>:<to>`, e.g. `edge3:agg1`.
+        */
+        vector<pair<string, ns3::Ptr<ns3::QueueDisc>>> getLocalQueueDiscs() const {
+            vector<pair<string, ns3::Ptr<ns3::QueueDisc>>> local;
+            for (auto const &elem: this->queueDiscs) {
+                if (elem.second->GetNetDevice()->GetNode()->GetSystemId() == systemId)
+                    local.push_back(elem);
+            }
+            return local;
+        }
+
+        /**
+         * Every link direction of the fabric, named like the queue discs.
+         * The same on every rank.
+        */
+        const vector<tuple<string, ns3::Ptr<ns3::NetDevice>, ns3::Ptr<ns3::NetDevice>>> &getLinkDirections() const {
+            return this->linkDirections;
+        }
+
+        /**
+         * All switches that belong to the current rank, i.e. the ones this rank
+         * may install probes on.
+        */
+        ns3::NodeContainer getLocalSwitches() const {
+            ns3::NodeContainer local;
+            auto addLocal = [&local](const ns3::NodeContainer &nodes) {
+                for (auto it = nodes.Begin(); it != nodes.End(); ++it) {
+                    if ((*it)->GetSystemId() == systemId)
+                        local.Add(*it);
+                }
+            };
+
+            addLocal(this->coreSwitches);
+            for (auto const &pod: this->aggSwitches)
+                addLocal(pod);
+            for (auto const &pod: this->edgeSwitches)
+                addLocal(pod);
+
+            return local;
+        }
+
         uint32_t getPodNum(uint32_t full_idx) {
             return full_idx / (this->params.switchRadix / 2);
         }
@@ -472,8 +571,30 @@ class ClosTopology {
                 if (!ptr)
                     continue;
 
-                ns3::PacketSinkHelper sink("ns3::TcpSocketFactory", ns3::InetSocketAddress(this->getServerAddress(idx), TCP_DISCARD_PORT));
-                this->serverApplications[idx].Add(sink.Install(ptr));
+                // Releases the socket of every finished flow, its record is only kept for --sinkRecords
+                ns3::FlowSinkHelper sink("ns3::TcpSocketFactory", ns3::InetSocketAddress(this->getServerAddress(idx), TCP_DISCARD_PORT));
+                sink.SetAttribute("KeepRecords", ns3::BooleanValue(param_sink_records));
+                ns3::ApplicationContainer apps = sink.Install(ptr);
+                this->flowSinks.Add(apps);
+                this->serverApplications[idx].Add(apps);
+                this->serverApplications[idx].Start(ns3::Seconds(0));
+            }
+        }
+
+        const ns3::ApplicationContainer &getFlowSinks() const {
+            return this->flowSinks;
+        }
+
+        void installTcpMessageSinks(ns3::Callback<void, const ns3::SeqTsSizeHeader&, const ns3::Address&> sinkCallback) {
+            for (uint32_t idx = 0; idx < this->params.numPods * this->params.numServers * this->params.switchRadix / 2; idx++) {
+                ns3::Ptr<ns3::Node> ptr = this->getLocalHost(idx);
+                if (!ptr)
+                    continue;
+
+                ns3::MessageSinkHelper sink("ns3::TcpSocketFactory", ns3::InetSocketAddress(this->getServerAddress(idx), TCP_DISCARD_PORT));
+                ns3::ApplicationContainer apps = sink.Install(ptr);
+                apps.Get(0)->TraceConnectWithoutContext("Message", sinkCallback);
+                this->serverApplications[idx].Add(apps);
                 this->serverApplications[idx].Start(ns3::Seconds(0));
             }
         }
@@ -572,7 +693,7 @@ void setLossRate(ClosTopology *topology, topology_level src_level, uint32_t src_
 
 uint16_t podLevelMapper(ns3::Ipv4Address dest, const topology_descriptor_t *topo_params);
 uint16_t torLevelMapper(ns3::Ipv4Address dest, const topology_descriptor_t *topo_params);
-void closHostFlowDispatcher(host_flow *flow, const ClosTopology *topo);
+uint16_t closHostFlowDispatcher(host_flow *flow, const ClosTopology *topo);
 
 template<typename... Args> void schedule(double t, link_state_change_func func, Args... args);
 template<typename... Args> void schedule(double t, link_attribute_change_func func, Args... args);
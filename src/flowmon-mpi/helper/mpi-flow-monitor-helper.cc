@@ -4,6 +4,8 @@
 #include "ns3/ipv4-mpi-flow-classifier.h"
 #include "ns3/ipv4-l3-protocol.h"
 #include "ns3/ipv6-l3-protocol.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/tcp-socket-base.h"
 #include "ns3/node-list.h"
 #include "ns3/node.h"
 
@@ -13,6 +15,7 @@ namespace ns3
 MpiFlowMonitorHelper::MpiFlowMonitorHelper()
 {
     NS_OBJECT_ENSURE_REGISTERED(Ipv4MpiFlowProbeTag);
+    NS_OBJECT_ENSURE_REGISTERED(Ipv4MpiFlowHopTag);
     m_monitorFactory.SetTypeId("ns3::MpiFlowMonitor");
 }
 
@@ -39,6 +42,7 @@ MpiFlowMonitorHelper::GetMonitor()
     {
         m_flowMonitor = m_monitorFactory.Create<MpiFlowMonitor>();
         m_flowMonitor->SetSystemId(GetSystemId());
+        m_flowMonitor->SetSamplingRate(Ipv4MpiFlowClassifier::GetSamplingRate());
         m_flowClassifier4 = Create<Ipv4MpiFlowClassifier>();
         m_flowClassifier4->SetSystemId(GetSystemId());
         m_flowMonitor->AddFlowClassifier(m_flowClassifier4);
@@ -105,6 +109,62 @@ MpiFlowMonitorHelper::InstallAll()
     return m_flowMonitor;
 }
 
+Ptr<MpiFlowMonitor>
+MpiFlowMonitorHelper::InstallHopProbes(NodeContainer nodes)
+{
+    Ptr<MpiFlowMonitor> monitor = GetMonitor();
+    Ptr<Ipv4MpiFlowClassifier> classifier = DynamicCast<Ipv4MpiFlowClassifier>(GetClassifier());
+    for (auto i = nodes.Begin(); i != nodes.End(); ++i)
+    {
+        NS_ABORT_MSG_IF(!(*i)->GetObject<Ipv4L3Protocol>(), "Hop probes need IPv4");
+        Create<Ipv4MpiFlowProbe>(monitor, classifier, *i, true);
+    }
+    return m_flowMonitor;
+}
+
+/// Bound to the congestion state trace of a TCP socket, the flow is looked up once per event
+static void
+TcpCongStateLogger(Ptr<MpiFlowMonitor> monitor,
+                   Ptr<Ipv4MpiFlowClassifier> classifier,
+                   Ipv4MpiFlowClassifier::FiveTuple tuple,
+                   TcpSocketState::TcpCongState_t oldState,
+                   TcpSocketState::TcpCongState_t newState)
+{
+    FlowId flowId;
+    if (classifier->LookupFlow(tuple, flowId))
+    {
+        monitor->ReportTcpCongState(flowId, newState);
+    }
+}
+
+void
+MpiFlowMonitorHelper::TraceTcpSocket(Ptr<Socket> socket)
+{
+    Ptr<TcpSocketBase> tcpSocket = DynamicCast<TcpSocketBase>(socket);
+    Address local;
+    Address peer;
+    if (!tcpSocket || tcpSocket->GetSockName(local) != 0 || tcpSocket->GetPeerName(peer) != 0 ||
+        !InetSocketAddress::IsMatchingType(local) || !InetSocketAddress::IsMatchingType(peer))
+    {
+        NS_ABORT_MSG("Only connected IPv4 TCP sockets can be traced");
+    }
+
+    InetSocketAddress localAddress = InetSocketAddress::ConvertFrom(local);
+    InetSocketAddress peerAddress = InetSocketAddress::ConvertFrom(peer);
+    Ipv4MpiFlowClassifier::FiveTuple tuple = {localAddress.GetIpv4(),
+                                              peerAddress.GetIpv4(),
+                                              TCP_PROT_NUMBER,
+                                              localAddress.GetPort(),
+                                              peerAddress.GetPort()};
+
+    tcpSocket->TraceConnectWithoutContext(
+        "CongState",
+        MakeBoundCallback(&TcpCongStateLogger,
+                          GetMonitor(),
+                          DynamicCast<Ipv4MpiFlowClassifier>(GetClassifier()),
+                          tuple));
+}
+
 void
 MpiFlowMonitorHelper::SerializeToXmlStream(
     std::ostream& os,
@@ -141,4 +201,42 @@ MpiFlowMonitorHelper::SerializeToXmlFile(
     }
 }
 
+void
+MpiFlowMonitorHelper::SerializeToBinaryFile(std::string fileName)
+{
+    if (m_flowMonitor)
+    {
+        m_flowMonitor->SerializeToBinaryFile(fileName);
+    }
+}
+
+void
+MpiFlowMonitorHelper::SerializeToMergedFile(std::string fileName)
+{
+    // collective, every rank has to take part even without a monitor
+    GetMonitor()->SerializeToMergedFile(fileName);
+}
+
+void
+MpiFlowMonitorHelper::SerializeSummaryToFile(std::string fileName)
+{
+    // collective as well
+    GetMonitor()->SerializeSummaryToFile(fileName);
+}
+
+void
+MpiFlowMonitorHelper::SerializeHopDelaysToFile(std::string fileName)
+{
+    if (m_flowMonitor)
+    {
+        m_flowMonitor->SerializeHopDelaysToFile(fileName);
+    }
+}
+
+void
+MpiFlowMonitorHelper::EnableSnapshots(std::string fileName, Time interval)
+{
+    GetMonitor()->EnableSnapshots(fileName, interval);
+}
+
 } // namespace ns3
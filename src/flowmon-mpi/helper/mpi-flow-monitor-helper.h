@@ -6,6 +6,7 @@
 #include "ns3/node-container.h"
 #include "ns3/object-factory.h"
 #include "ns3/ipv4-mpi-flow-probe.h"
+#include "ns3/socket.h"
 
 #include <string>
 
@@ -32,6 +33,9 @@ class MpiFlowMonitorHelper
     Ptr<MpiFlowMonitor> Install(NodeContainer nodes);
     Ptr<MpiFlowMonitor> Install(Ptr<Node> node);
     Ptr<MpiFlowMonitor> InstallAll();
+
+    /// Install probes that only account the hop delays of sampled packets, for switches
+    Ptr<MpiFlowMonitor> InstallHopProbes(NodeContainer nodes);
     Ptr<MpiFlowMonitor> GetMonitor();
     Ptr<MpiFlowClassifier> GetClassifier();
 
@@ -45,6 +49,16 @@ class MpiFlowMonitorHelper
 
     void SerializeToXmlFile(std::string fileName, bool enableHistograms, bool enableProbes);
 
+    void SerializeToBinaryFile(std::string fileName);
+
+    void SerializeToMergedFile(std::string fileName);
+
+    void SerializeSummaryToFile(std::string fileName);
+
+    void SerializeHopDelaysToFile(std::string fileName);
+
+    void EnableSnapshots(std::string fileName, Time interval);
+
     static void SetSystemId(uint32_t systemId) {
       MpiFlowMonitorHelper :: m_systemId = systemId;
     }
@@ -58,6 +72,39 @@ class MpiFlowMonitorHelper
       Ipv4MpiFlowClassifier :: SetMonitorUntil(when);
     }
 
+    static void SetSamplingRate(uint32_t rate) {
+      Ipv4MpiFlowClassifier :: SetSamplingRate(rate);
+    }
+
+    static void SetHopSamplingRate(uint32_t rate) {
+      Ipv4MpiFlowClassifier :: SetHopSamplingRate(rate);
+    }
+
+    /**
+     * Join a TCP flow about to start with its flow file entry, so that its
+     * slowdown is computed when the receiver sees it finish. Only needed on
+     * the receiver's rank.
+     */
+    void RegisterFlow(Ipv4Address src, uint16_t sport, Ipv4Address dst, uint16_t dport, const MpiFlowInfo& info) {
+      Ipv4MpiFlowClassifier::FiveTuple tuple = {src, dst, TCP_PROT_NUMBER, sport, dport};
+      DynamicCast<Ipv4MpiFlowClassifier>(GetClassifier())->RegisterFlow(tuple, info);
+    }
+
+    /// Forget the flows registered with RegisterFlow whose first packet never arrived
+    void ClearRegisteredFlows() {
+      if (m_flowClassifier4)
+        DynamicCast<Ipv4MpiFlowClassifier>(m_flowClassifier4)->ClearFlowInfos();
+    }
+
+    /**
+     * Count the congestion events of a connected TCP socket in the stats of
+     * its flow: RTOs, fast retransmits and ECN window reductions. Only the
+     * congestion state trace is hooked, so the cost is a few callbacks per
+     * congestion episode. Events of flows that were not classified, e.g.
+     * sampled out, are ignored.
+     */
+    void TraceTcpSocket(Ptr<Socket> socket);
+
     uint32_t GetSystemId() {
       return MpiFlowMonitorHelper :: m_systemId;
     }
@@ -1,4 +1,5 @@
 #include "ipv4-mpi-flow-classifier.h"
+#include "mpi-flow-record.h"
 
 #include "ns3/packet.h"
 #include "ns3/tcp-header.h"
@@ -10,74 +11,145 @@
 namespace ns3
 {
 
-/* see http://www.iana.org/assignments/protocol-numbers */
-const uint8_t TCP_PROT_NUMBER = 6;  //!< TCP Protocol number
-const uint8_t UDP_PROT_NUMBER = 17; //!< UDP Protocol number
+/// Initial number of slots in the flow table, must be a power of two
+const uint32_t INITIAL_FLOW_TABLE_SIZE = 1024;
 
 uint16_t Ipv4MpiFlowClassifier :: m_sourcePortToFilter;
 Time Ipv4MpiFlowClassifier :: m_monitorUntil = Seconds(MAXFLOAT);
+uint32_t Ipv4MpiFlowClassifier :: m_samplingRate = 1;
+uint32_t Ipv4MpiFlowClassifier :: m_hopSamplingRate = 0;
+
+/**
+ * Mixes the two words of a packed five-tuple into a table index.
+ * Consecutive ports and addresses are common, so the bits are spread
+ * with multiply/xor-shift rounds before masking.
+ */
+static inline uint64_t
+HashPackedTuple(uint64_t addresses, uint64_t portsAndProtocol)
+{
+    uint64_t h = addresses * 0x9E3779B97F4A7C15ULL;
+    h ^= portsAndProtocol + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return h;
+}
 
 bool
-operator<(const Ipv4MpiFlowClassifier::FiveTuple& t1, const Ipv4MpiFlowClassifier::FiveTuple& t2)
+operator==(const Ipv4MpiFlowClassifier::FiveTuple& t1, const Ipv4MpiFlowClassifier::FiveTuple& t2)
 {
-    if (t1.sourceAddress < t2.sourceAddress)
-    {
-        return true;
-    }
-    if (t1.sourceAddress != t2.sourceAddress)
-    {
-        return false;
-    }
+    return (t1.sourceAddress == t2.sourceAddress &&
+            t1.destinationAddress == t2.destinationAddress && t1.protocol == t2.protocol &&
+            t1.sourcePort == t2.sourcePort && t1.destinationPort == t2.destinationPort);
+}
 
-    if (t1.destinationAddress < t2.destinationAddress)
-    {
-        return true;
-    }
-    if (t1.destinationAddress != t2.destinationAddress)
-    {
-        return false;
-    }
+size_t
+Ipv4MpiFlowClassifier::FiveTupleHash::operator()(const FiveTuple& tuple) const
+{
+    uint64_t addresses =
+        (static_cast<uint64_t>(tuple.sourceAddress.Get()) << 32) | tuple.destinationAddress.Get();
+    uint64_t portsAndProtocol = (static_cast<uint64_t>(tuple.protocol) << 32) |
+                                (static_cast<uint64_t>(tuple.sourcePort) << 16) |
+                                tuple.destinationPort;
+    return HashPackedTuple(addresses, portsAndProtocol);
+}
+
+Ipv4MpiFlowClassifier::Ipv4MpiFlowClassifier()
+    : m_flowInfoTimeout(Seconds(1)),
+      m_flowSlots(INITIAL_FLOW_TABLE_SIZE, FlowSlot{0, 0, 0, 0}),
+      m_numFlows(0)
+{
+}
+
+void
+Ipv4MpiFlowClassifier::RegisterFlow(const FiveTuple& tuple, const MpiFlowInfo& info)
+{
+    ExpireFlowInfos();
 
-    if (t1.protocol < t2.protocol)
+    // flows sampled out or starting after monitoring ends are never joined
+    if (Simulator::Now() > GetMonitorUntil())
     {
-        return true;
+        return;
     }
-    if (t1.protocol != t2.protocol)
+    if (m_samplingRate > 1 && (FiveTupleHash()(tuple) >> 32) % m_samplingRate != 0)
     {
-        return false;
+        return;
     }
 
-    if (t1.sourcePort < t2.sourcePort)
-    {
-        return true;
-    }
-    if (t1.sourcePort != t2.sourcePort)
+    Time now = Simulator::Now();
+    m_flowInfos[tuple] = PendingFlowInfo{info, now};
+    m_flowInfoOrder.emplace_back(now, tuple);
+}
+
+bool
+Ipv4MpiFlowClassifier::TakeFlowInfo(const FiveTuple& tuple, MpiFlowInfo& info)
+{
+    auto iter = m_flowInfos.find(tuple);
+    if (iter == m_flowInfos.end())
     {
         return false;
     }
+    info = iter->second.info;
+    // its entry in m_flowInfoOrder goes when it expires
+    m_flowInfos.erase(iter);
+    return true;
+}
 
-    if (t1.destinationPort < t2.destinationPort)
-    {
-        return true;
-    }
-    if (t1.destinationPort != t2.destinationPort)
+void
+Ipv4MpiFlowClassifier::ExpireFlowInfos()
+{
+    Time now = Simulator::Now();
+    while (!m_flowInfoOrder.empty() && now - m_flowInfoOrder.front().first > m_flowInfoTimeout)
     {
-        return false;
+        auto iter = m_flowInfos.find(m_flowInfoOrder.front().second);
+        // the tuple may have been taken, or registered again since
+        if (iter != m_flowInfos.end() && iter->second.registered == m_flowInfoOrder.front().first)
+        {
+            m_flowInfos.erase(iter);
+        }
+        m_flowInfoOrder.pop_front();
     }
+}
 
-    return false;
+void
+Ipv4MpiFlowClassifier::ClearFlowInfos()
+{
+    m_flowInfos.clear();
+    m_flowInfoOrder.clear();
 }
 
-bool
-operator==(const Ipv4MpiFlowClassifier::FiveTuple& t1, const Ipv4MpiFlowClassifier::FiveTuple& t2)
+Ipv4MpiFlowClassifier::FlowSlot*
+Ipv4MpiFlowClassifier::FindSlot(uint64_t addresses, uint64_t portsAndProtocol, uint64_t hash)
 {
-    return (t1.sourceAddress == t2.sourceAddress &&
-            t1.destinationAddress == t2.destinationAddress && t1.protocol == t2.protocol &&
-            t1.sourcePort == t2.sourcePort && t1.destinationPort == t2.destinationPort);
+    uint64_t mask = m_flowSlots.size() - 1;
+    uint64_t idx = hash & mask;
+    while (true)
+    {
+        FlowSlot* slot = &m_flowSlots[idx];
+        if (slot->flowId == 0 ||
+            (slot->addresses == addresses && slot->portsAndProtocol == portsAndProtocol))
+        {
+            return slot;
+        }
+        idx = (idx + 1) & mask;
+    }
 }
 
-Ipv4MpiFlowClassifier::Ipv4MpiFlowClassifier()
+void
+Ipv4MpiFlowClassifier::Grow()
 {
+    std::vector<FlowSlot> previous;
+    previous.swap(m_flowSlots);
+    m_flowSlots.assign(previous.size() * 2, FlowSlot{0, 0, 0, 0});
+    for (const auto& slot : previous)
+    {
+        if (slot.flowId != 0)
+        {
+            *FindSlot(slot.addresses,
+                      slot.portsAndProtocol,
+                      HashPackedTuple(slot.addresses, slot.portsAndProtocol)) = slot;
+        }
+    }
 }
 
 bool
@@ -134,28 +206,49 @@ Ipv4MpiFlowClassifier::Classify(
     if (srcPort == Ipv4MpiFlowClassifier :: GetSourcePortToFilter())
         return false;
 
-    if (!m_flowMap.count(tuple) && (Simulator::Now() > GetMonitorUntil())) {
-        // No longer need to monitor this!
+    uint64_t addresses =
+        (static_cast<uint64_t>(tuple.sourceAddress.Get()) << 32) | tuple.destinationAddress.Get();
+    uint64_t portsAndProtocol = (static_cast<uint64_t>(tuple.protocol) << 32) |
+                                (static_cast<uint64_t>(srcPort) << 16) | dstPort;
+
+    uint64_t hash = HashPackedTuple(addresses, portsAndProtocol);
+    // the table index uses the low bits, sample on the high ones
+    if (m_samplingRate > 1 && (hash >> 32) % m_samplingRate != 0)
+    {
         return false;
     }
 
-    // try to insert the tuple, but check if it already exists
-    auto insert = m_flowMap.insert(std::pair<FiveTuple, FlowId>(tuple, 0));
+    FlowSlot* slot = FindSlot(addresses, portsAndProtocol, hash);
 
-    // if the insertion succeeded, we need to assign this tuple a new flow identifier
-    if (insert.second)
-    {
-        FlowId newFlowId = GetNewFlowId();
-        insert.first->second = newFlowId;
-        m_flowPktIdMap[newFlowId] = 0;
-    }
-    else
+    // if the tuple is new, we need to assign it a new flow identifier
+    if (slot->flowId == 0)
     {
-        m_flowPktIdMap[insert.first->second]++;
+        if (Simulator::Now() > GetMonitorUntil())
+        {
+            // No longer need to monitor this!
+            return false;
+        }
+
+        slot->addresses = addresses;
+        slot->portsAndProtocol = portsAndProtocol;
+        slot->flowId = GetNewFlowId();
+        slot->nextPacketId = 0;
+        m_flowTuples.push_back(tuple);
+        NS_ASSERT(slot->flowId - GetFlowIdBase() == m_flowTuples.size());
+
+        *out_flowId = slot->flowId;
+        *out_packetId = slot->nextPacketId++;
+
+        // keep the load factor under one half, `slot` is invalid after this
+        if (++m_numFlows * 2 > m_flowSlots.size())
+        {
+            Grow();
+        }
+        return true;
     }
 
-    *out_flowId = insert.first->second;
-    *out_packetId = m_flowPktIdMap[*out_flowId];
+    *out_flowId = slot->flowId;
+    *out_packetId = slot->nextPacketId++;
 
     return true;
 }
@@ -163,18 +256,66 @@ Ipv4MpiFlowClassifier::Classify(
 Ipv4MpiFlowClassifier::FiveTuple
 Ipv4MpiFlowClassifier::FindFlow(FlowId flowId) const
 {
-    for (auto iter = m_flowMap.begin(); iter != m_flowMap.end(); iter++)
+    FlowId index = flowId - GetFlowIdBase() - 1;
+    if (flowId > GetFlowIdBase() && index < m_flowTuples.size())
     {
-        if (iter->second == flowId)
-        {
-            return iter->first;
-        }
+        return m_flowTuples[index];
     }
     NS_FATAL_ERROR("Could not find the flow with ID " << flowId);
     FiveTuple retval = {Ipv4Address::GetZero(), Ipv4Address::GetZero(), 0, 0, 0};
     return retval;
 }
 
+bool
+Ipv4MpiFlowClassifier::LookupFlow(const FiveTuple& tuple, FlowId& flowId)
+{
+    uint64_t addresses =
+        (static_cast<uint64_t>(tuple.sourceAddress.Get()) << 32) | tuple.destinationAddress.Get();
+    uint64_t portsAndProtocol = (static_cast<uint64_t>(tuple.protocol) << 32) |
+                                (static_cast<uint64_t>(tuple.sourcePort) << 16) |
+                                tuple.destinationPort;
+
+    FlowSlot* slot = FindSlot(addresses, portsAndProtocol, HashPackedTuple(addresses, portsAndProtocol));
+    if (slot->flowId == 0)
+    {
+        return false;
+    }
+    flowId = slot->flowId;
+    return true;
+}
+
+bool
+Ipv4MpiFlowClassifier::IsSrcDstValid(FlowId flowId, Ipv4Address src, Ipv4Address dst) const
+{
+    FlowId index = flowId - GetFlowIdBase() - 1;
+    if (flowId <= GetFlowIdBase() || index >= m_flowTuples.size())
+    {
+        return true;
+    }
+
+    const FiveTuple& tuple = m_flowTuples[index];
+    return tuple.sourceAddress == src && tuple.destinationAddress == dst;
+}
+
+bool
+Ipv4MpiFlowClassifier::FillFlowRecord(FlowId flowId, MpiFlowRecord& record) const
+{
+    FlowId index = flowId - GetFlowIdBase() - 1;
+    if (flowId <= GetFlowIdBase() || index >= m_flowTuples.size())
+    {
+        // classified by another rank
+        return false;
+    }
+
+    const FiveTuple& tuple = m_flowTuples[index];
+    record.sourceAddress = tuple.sourceAddress.Get();
+    record.destinationAddress = tuple.destinationAddress.Get();
+    record.sourcePort = tuple.sourcePort;
+    record.destinationPort = tuple.destinationPort;
+    record.protocol = tuple.protocol;
+    return true;
+}
+
 bool
 Ipv4MpiFlowClassifier::SortByCount::operator()(std::pair<Ipv4Header::DscpType, uint32_t> left,
                                             std::pair<Ipv4Header::DscpType, uint32_t> right)
@@ -189,15 +330,16 @@ Ipv4MpiFlowClassifier::SerializeToXmlStream(std::ostream& os, uint16_t indent) c
     os << "<Ipv4FlowClassifier>\n";
 
     indent += 2;
-    for (auto iter = m_flowMap.begin(); iter != m_flowMap.end(); iter++)
+    for (uint32_t index = 0; index < m_flowTuples.size(); index++)
     {
+        const FiveTuple& tuple = m_flowTuples[index];
         Indent(os, indent);
-        os << "<Flow flowId=\"" << iter->second << "\""
-           << " sourceAddress=\"" << iter->first.sourceAddress << "\""
-           << " destinationAddress=\"" << iter->first.destinationAddress << "\""
-           << " protocol=\"" << int(iter->first.protocol) << "\""
-           << " sourcePort=\"" << iter->first.sourcePort << "\""
-           << " destinationPort=\"" << iter->first.destinationPort << "\">\n";
+        os << "<Flow flowId=\"" << (GetFlowIdBase() + index + 1) << "\""
+           << " sourceAddress=\"" << tuple.sourceAddress << "\""
+           << " destinationAddress=\"" << tuple.destinationAddress << "\""
+           << " protocol=\"" << int(tuple.protocol) << "\""
+           << " sourcePort=\"" << tuple.sourcePort << "\""
+           << " destinationPort=\"" << tuple.destinationPort << "\">\n";
 
         Indent(os, indent);
         os << "</Flow>\n";
@@ -2,22 +2,31 @@
 #define IPV4_MPI_FLOW_CLASSIFIER_H
 
 #include "mpi-flow-classifier.h"
+#include "ns3/abort.h"
 #include "ns3/nstime.h"
 #include "ns3/ipv4-header.h"
 
-#include <map>
+#include <deque>
 #include <stdint.h>
+#include <unordered_map>
+#include <vector>
 
 namespace ns3
 {
 
 class Packet;
 
+/* see http://www.iana.org/assignments/protocol-numbers */
+const uint8_t TCP_PROT_NUMBER = 6;  //!< TCP Protocol number
+const uint8_t UDP_PROT_NUMBER = 17; //!< UDP Protocol number
+
 class Ipv4MpiFlowClassifier : public MpiFlowClassifier
 {
   public:
     static uint16_t m_sourcePortToFilter;
     static Time m_monitorUntil;
+    static uint32_t m_samplingRate;
+    static uint32_t m_hopSamplingRate;
 
     static void SetSourcePortToFilter(uint16_t port) {
       Ipv4MpiFlowClassifier :: m_sourcePortToFilter = port;
@@ -35,6 +44,33 @@ class Ipv4MpiFlowClassifier : public MpiFlowClassifier
       return Ipv4MpiFlowClassifier :: m_monitorUntil;
     }
 
+    /**
+     * Only monitor 1-in-`rate` flows. Flows are picked by a hash of their
+     * five-tuple, so the choice is the same on every rank and every run, and
+     * packets of other flows are neither classified nor tagged.
+     */
+    static void SetSamplingRate(uint32_t rate) {
+      NS_ABORT_MSG_IF(rate == 0, "Sampling rate must be at least 1");
+      Ipv4MpiFlowClassifier :: m_samplingRate = rate;
+    }
+
+    static uint32_t GetSamplingRate() {
+      return Ipv4MpiFlowClassifier :: m_samplingRate;
+    }
+
+    /**
+     * Trace the per-hop latency of 1-in-`rate` packets of each monitored
+     * flow (by packet id), 0 disables it. Probes must be installed on the
+     * switches as well for this to see anything.
+     */
+    static void SetHopSamplingRate(uint32_t rate) {
+      Ipv4MpiFlowClassifier :: m_hopSamplingRate = rate;
+    }
+
+    static uint32_t GetHopSamplingRate() {
+      return Ipv4MpiFlowClassifier :: m_hopSamplingRate;
+    }
+
     /// Structure to classify a packet
     struct FiveTuple
     {
@@ -45,8 +81,38 @@ class Ipv4MpiFlowClassifier : public MpiFlowClassifier
         uint16_t destinationPort;       //!< Destination port
     };
 
+    /// Hash of a five-tuple, mixes the same packed words as the flow table
+    struct FiveTupleHash
+    {
+        size_t operator()(const FiveTuple& tuple) const;
+    };
+
     Ipv4MpiFlowClassifier();
 
+    /**
+     * Announce a flow that is about to start, so that the rank that sees it
+     * finish can join it with its flow file entry. Entries are dropped once
+     * taken, register only on the receiver's rank to keep this small. Flows
+     * that will not be monitored are not kept, and entries nobody took
+     * within the flow info timeout are dropped by later registrations.
+     */
+    void RegisterFlow(const FiveTuple& tuple, const MpiFlowInfo& info);
+
+    /// Look up and forget the info registered for a five-tuple, false if there is none
+    bool TakeFlowInfo(const FiveTuple& tuple, MpiFlowInfo& info);
+
+    /// How long a registered flow info waits to be taken, its first packet should be in by then
+    void SetFlowInfoTimeout(Time timeout) {
+      m_flowInfoTimeout = timeout;
+    }
+
+    /// Forget the flow infos that were never taken, e.g. at the end of the run
+    void ClearFlowInfos();
+
+    uint32_t GetNFlowInfos() const {
+      return m_flowInfos.size();
+    }
+
     bool Classify(const Ipv4Header& ipHeader,
                   Ptr<const Packet> ipPayload,
                   uint32_t* out_flowId,
@@ -54,6 +120,16 @@ class Ipv4MpiFlowClassifier : public MpiFlowClassifier
 
     FiveTuple FindFlow(FlowId flowId) const;
 
+    /// Flow identifier of an already classified five-tuple, false if it was never seen or sampled out
+    bool LookupFlow(const FiveTuple& tuple, FlowId& flowId);
+
+    /**
+     * Check the addresses of a received packet against the five-tuple of its
+     * flow, to skip encapsulated packets. Flows classified by another rank
+     * can not be checked and are always valid.
+     */
+    bool IsSrcDstValid(FlowId flowId, Ipv4Address src, Ipv4Address dst) const;
+
     /// Comparator used to sort the vector of DSCP values
     class SortByCount
     {
@@ -66,21 +142,49 @@ class Ipv4MpiFlowClassifier : public MpiFlowClassifier
 
     void SerializeToXmlStream(std::ostream& os, uint16_t indent) const override;
 
+    bool FillFlowRecord(FlowId flowId, MpiFlowRecord& record) const override;
+
   private:
-    /// Map to Flows Identifiers to FlowIds
-    std::map<FiveTuple, FlowId> m_flowMap;
-    /// Map to FlowIds to FlowPacketId
-    std::map<FlowId, FlowPacketId> m_flowPktIdMap;
-};
+    /// A flow announced by RegisterFlow and when
+    struct PendingFlowInfo
+    {
+        MpiFlowInfo info;
+        Time registered;
+    };
 
-/**
- * \brief Less than operator.
- *
- * \param t1 the first operand
- * \param t2 the first operand
- * \returns true if the operands are equal
- */
-bool operator<(const Ipv4MpiFlowClassifier::FiveTuple& t1, const Ipv4MpiFlowClassifier::FiveTuple& t2);
+    /// Drop the flow infos registered more than the timeout ago
+    void ExpireFlowInfos();
+
+    /// Flows announced by RegisterFlow whose first packet did not arrive yet
+    std::unordered_map<FiveTuple, PendingFlowInfo, FiveTupleHash> m_flowInfos;
+    /// The same flows in the order they were registered, for ExpireFlowInfos
+    std::deque<std::pair<Time, FiveTuple>> m_flowInfoOrder;
+    Time m_flowInfoTimeout;
+
+    /**
+     * A slot of the open-addressing flow table. The 13 bytes of the five-tuple
+     * are packed into two words so that probing compares two integers.
+     */
+    struct FlowSlot
+    {
+        uint64_t addresses;         //!< Source address (high) and destination address (low)
+        uint64_t portsAndProtocol;  //!< Protocol, source port and destination port
+        FlowId flowId;              //!< Flow identifier, 0 marks an empty slot
+        FlowPacketId nextPacketId;  //!< Packet identifier handed to the next packet
+    };
+
+    /// Find the slot of a packed tuple, or the empty slot where it should go
+    FlowSlot* FindSlot(uint64_t addresses, uint64_t portsAndProtocol, uint64_t hash);
+    /// Double the flow table and re-insert all flows
+    void Grow();
+
+    /// Open-addressing (linear probing) table, its size is always a power of two
+    std::vector<FlowSlot> m_flowSlots;
+    /// Number of occupied slots in m_flowSlots
+    uint32_t m_numFlows;
+    /// Five-tuples indexed by (FlowId - GetFlowIdBase () - 1), for reverse lookups
+    std::vector<FiveTuple> m_flowTuples;
+};
 
 /**
  * \brief Equal to operator.
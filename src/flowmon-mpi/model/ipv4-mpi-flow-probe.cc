@@ -2,19 +2,27 @@
 #include "ipv4-mpi-flow-classifier.h"
 #include "mpi-flow-monitor.h"
 
-#include "ns3/config.h"
 #include "ns3/flow-id-tag.h"
 #include "ns3/log.h"
+#include "ns3/net-device.h"
 #include "ns3/node.h"
 #include "ns3/packet.h"
+#include "ns3/point-to-point-net-device.h"
 #include "ns3/pointer.h"
-#include "ns3/tcp-header.h"
+#include "ns3/ppp-header.h"
+#include "ns3/queue-disc.h"
+#include "ns3/traffic-control-layer.h"
+
+#include <algorithm>
 
 namespace ns3
 {
 
 NS_LOG_COMPONENT_DEFINE("Ipv4MpiFlowProbe");
 
+const uint8_t TCP_FIN_FLAG = 0x01;  //!< FIN bit of the TCP flags octet
+const uint8_t TCP_SYN_FLAG = 0x02;  //!< SYN bit of the TCP flags octet
+
 
 TypeId
 Ipv4MpiFlowProbeTag::GetTypeId()
@@ -35,7 +43,7 @@ Ipv4MpiFlowProbeTag::GetInstanceTypeId() const
 uint32_t
 Ipv4MpiFlowProbeTag::GetSerializedSize() const
 {
-    return 4 + 4 + 4 + 8 + 16;
+    return 4 + 4 + 8;
 }
 
 void
@@ -43,16 +51,7 @@ Ipv4MpiFlowProbeTag::Serialize(TagBuffer buf) const
 {
     buf.WriteU32(m_flowId);
     buf.WriteU32(m_packetId);
-    buf.WriteU32(m_packetSize);
-
-    uint8_t tBuf[4];
-    m_src.Serialize(tBuf);
-    buf.Write(tBuf, 4);
-    m_dst.Serialize(tBuf);
-    buf.Write(tBuf, 4);
-
     buf.WriteU64(m_tStart);
-    buf.WriteU64(m_tLastRx);
 }
 
 void
@@ -60,16 +59,7 @@ Ipv4MpiFlowProbeTag::Deserialize(TagBuffer buf)
 {
     m_flowId = buf.ReadU32();
     m_packetId = buf.ReadU32();
-    m_packetSize = buf.ReadU32();
-
-    uint8_t tBuf[4];
-    buf.Read(tBuf, 4);
-    m_src = Ipv4Address::Deserialize(tBuf);
-    buf.Read(tBuf, 4);
-    m_dst = Ipv4Address::Deserialize(tBuf);
-
     m_tStart = buf.ReadU64();
-    m_tLastRx = buf.ReadU64();
 }
 
 void
@@ -77,32 +67,22 @@ Ipv4MpiFlowProbeTag::Print(std::ostream& os) const
 {
     os << "FlowId=" << m_flowId;
     os << " PacketId=" << m_packetId;
-    os << " PacketSize=" << m_packetSize;
     os << " tStart=" << m_tStart;
-    os << " tLastRx=" << m_tLastRx;
 }
 
 Ipv4MpiFlowProbeTag::Ipv4MpiFlowProbeTag()
-    : Tag()
+    : Tag(),
+      m_flowId(0),
+      m_packetId(0),
+      m_tStart(0)
 {
 }
 
-Ipv4MpiFlowProbeTag::Ipv4MpiFlowProbeTag(
-    uint32_t flowId,
-    uint32_t packetId,
-    uint32_t packetSize,
-    Ipv4Address src,
-    Ipv4Address dst,
-    uint64_t tStart,
-    uint64_t tLastRx)
+Ipv4MpiFlowProbeTag::Ipv4MpiFlowProbeTag(uint32_t flowId, uint32_t packetId, uint64_t tStart)
     : Tag(),
       m_flowId(flowId),
       m_packetId(packetId),
-      m_packetSize(packetSize),
-      m_src(src),
-      m_dst(dst),
-      m_tStart(tStart),
-      m_tLastRx(tLastRx)
+      m_tStart(tStart)
 {
 }
 
@@ -115,15 +95,9 @@ Ipv4MpiFlowProbeTag::SetPacketId(uint32_t id) {
     m_packetId = id;
 }
 void
-Ipv4MpiFlowProbeTag::SetPacketSize(uint32_t size) {
-    m_packetSize = size;
-}
-void Ipv4MpiFlowProbeTag :: SettTStart(uint64_t tStart) {
+Ipv4MpiFlowProbeTag::SetTStart(uint64_t tStart) {
     m_tStart = tStart;
 }
-void Ipv4MpiFlowProbeTag :: SetTLastRx(uint64_t tLastRx) {
-    m_tLastRx = tLastRx;
-}
 
 uint32_t
 Ipv4MpiFlowProbeTag::GetFlowId() const {
@@ -133,21 +107,84 @@ uint32_t
 Ipv4MpiFlowProbeTag::GetPacketId() const {
     return m_packetId;
 }
+uint64_t
+Ipv4MpiFlowProbeTag::GetTStart() const {
+    return m_tStart;
+}
+
+TypeId
+Ipv4MpiFlowHopTag::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::Ipv4MpiFlowHopTag")
+                            .SetParent<Tag>()
+                            .SetGroupName("FlowMonitor")
+                            .AddConstructor<Ipv4MpiFlowHopTag>();
+    return tid;
+}
+
+TypeId
+Ipv4MpiFlowHopTag::GetInstanceTypeId() const
+{
+    return GetTypeId();
+}
+
 uint32_t
-Ipv4MpiFlowProbeTag::GetPacketSize() const {
-    return m_packetSize;
+Ipv4MpiFlowHopTag::GetSerializedSize() const
+{
+    return 4 + 4 + 8;
 }
-bool
-Ipv4MpiFlowProbeTag::IsSrcDstValid(Ipv4Address src, Ipv4Address dst) const {
-    return ((m_src == src) && (m_dst == dst));
+
+void
+Ipv4MpiFlowHopTag::Serialize(TagBuffer buf) const
+{
+    buf.WriteU32(m_nodeId);
+    buf.WriteU32(m_interface);
+    buf.WriteU64(m_tLast);
 }
-uint64_t 
-Ipv4MpiFlowProbeTag :: GettTStart() const {
-    return m_tStart;
+
+void
+Ipv4MpiFlowHopTag::Deserialize(TagBuffer buf)
+{
+    m_nodeId = buf.ReadU32();
+    m_interface = buf.ReadU32();
+    m_tLast = buf.ReadU64();
+}
+
+void
+Ipv4MpiFlowHopTag::Print(std::ostream& os) const
+{
+    os << "NodeId=" << m_nodeId;
+    os << " Interface=" << m_interface;
+    os << " tLast=" << m_tLast;
+}
+
+Ipv4MpiFlowHopTag::Ipv4MpiFlowHopTag()
+    : Tag(),
+      m_nodeId(0),
+      m_interface(0),
+      m_tLast(0)
+{
+}
+
+Ipv4MpiFlowHopTag::Ipv4MpiFlowHopTag(uint32_t nodeId, uint32_t interface, uint64_t tLast)
+    : Tag(),
+      m_nodeId(nodeId),
+      m_interface(interface),
+      m_tLast(tLast)
+{
 }
-uint64_t 
-Ipv4MpiFlowProbeTag:: GetTLastRx() const {
-    return m_tLastRx;
+
+uint32_t
+Ipv4MpiFlowHopTag::GetNodeId() const {
+    return m_nodeId;
+}
+uint32_t
+Ipv4MpiFlowHopTag::GetInterface() const {
+    return m_interface;
+}
+uint64_t
+Ipv4MpiFlowHopTag::GetTLast() const {
+    return m_tLast;
 }
 
 ///////////////////////////////////////////
@@ -156,23 +193,31 @@ Ipv4MpiFlowProbeTag:: GetTLastRx() const {
 
 Ipv4MpiFlowProbe::Ipv4MpiFlowProbe(Ptr<MpiFlowMonitor> monitor,
                              Ptr<Ipv4MpiFlowClassifier> classifier,
-                             Ptr<Node> node)
+                             Ptr<Node> node,
+                             bool hopOnly)
     : MpiFlowProbe(monitor),
-      m_classifier(classifier)
+      m_classifier(classifier),
+      m_nodeId(node->GetId())
 {
-    NS_LOG_FUNCTION(this << node->GetId());
+    NS_LOG_FUNCTION(this << node->GetId() << hopOnly);
 
     m_ipv4 = node->GetObject<Ipv4L3Protocol>();
 
     if (!m_ipv4->TraceConnectWithoutContext(
-        "SendOutgoing",
-        MakeCallback(&Ipv4MpiFlowProbe::SendOutgoingLogger, Ptr<Ipv4MpiFlowProbe>(this))))
+        "UnicastForward",
+        MakeCallback(&Ipv4MpiFlowProbe::ForwardLogger, Ptr<Ipv4MpiFlowProbe>(this))))
     {
         NS_FATAL_ERROR("trace fail");
     }
+    if (hopOnly)
+    {
+        // no flow stats on this node, so its drops do not create any either
+        return;
+    }
+
     if (!m_ipv4->TraceConnectWithoutContext(
-        "UnicastForward",
-        MakeCallback(&Ipv4MpiFlowProbe::ForwardLogger, Ptr<Ipv4MpiFlowProbe>(this))))
+        "SendOutgoing",
+        MakeCallback(&Ipv4MpiFlowProbe::SendOutgoingLogger, Ptr<Ipv4MpiFlowProbe>(this))))
     {
         NS_FATAL_ERROR("trace fail");
     }
@@ -190,18 +235,32 @@ Ipv4MpiFlowProbe::Ipv4MpiFlowProbe(Ptr<MpiFlowMonitor> monitor,
         NS_FATAL_ERROR("trace fail");
     }
 
-    std::ostringstream qd;
-    qd << "/NodeList/" << node->GetId() << "/$ns3::TrafficControlLayer/RootQueueDiscList/*/Drop";
-    Config::ConnectWithoutContextFailSafe(
-        qd.str(),
-        MakeCallback(&Ipv4MpiFlowProbe::QueueDiscDropLogger, Ptr<Ipv4MpiFlowProbe>(this)));
+    // Connect to the queues of the node directly, resolving the equivalent
+    // Config paths walks the whole node list for every probe
+    Ptr<TrafficControlLayer> tc = node->GetObject<TrafficControlLayer>();
+    for (uint32_t i = 0; i < node->GetNDevices(); i++)
+    {
+        Ptr<NetDevice> device = node->GetDevice(i);
+
+        Ptr<QueueDisc> qdisc = tc ? tc->GetRootQueueDiscOnDevice(device) : nullptr;
+        if (qdisc)
+        {
+            qdisc->TraceConnectWithoutContext(
+                "Drop",
+                MakeCallback(&Ipv4MpiFlowProbe::QueueDiscDropLogger, Ptr<Ipv4MpiFlowProbe>(this)));
+        }
 
-    // code copied from point-to-point-helper.cc
-    std::ostringstream oss;
-    oss << "/NodeList/" << node->GetId() << "/DeviceList/*/TxQueue/Drop";
-    Config::ConnectWithoutContextFailSafe(
-        oss.str(),
-        MakeCallback(&Ipv4MpiFlowProbe::QueueDropLogger, Ptr<Ipv4MpiFlowProbe>(this)));
+        // same as DeviceList/*/TxQueue/Drop, any device with a TxQueue will do.
+        // Its frames carry the L2 header, which is not counted on the other drop paths
+        PointerValue txQueue;
+        if (device->GetAttributeFailSafe("TxQueue", txQueue) && txQueue.GetObject())
+        {
+            uint32_t l2HeaderSize = DynamicCast<PointToPointNetDevice>(device) ? PppHeader().GetSerializedSize() : 0;
+            txQueue.GetObject()->TraceConnectWithoutContext(
+                "Drop",
+                MakeBoundCallback(&Ipv4MpiFlowProbe::QueueDropLogger, Ptr<Ipv4MpiFlowProbe>(this), l2HeaderSize));
+        }
+    }
 }
 
 Ipv4MpiFlowProbe::~Ipv4MpiFlowProbe()
@@ -227,6 +286,7 @@ Ipv4MpiFlowProbe::DoDispose()
 {
     m_ipv4 = nullptr;
     m_classifier = nullptr;
+    m_tcpRx.clear();
     MpiFlowProbe::DoDispose();
 }
 
@@ -245,8 +305,7 @@ Ipv4MpiFlowProbe::SendOutgoingLogger(
     }
 
     Ipv4MpiFlowProbeTag fTag;
-    bool found = ipPayload->FindFirstMatchingByteTag(fTag);
-    if (found)
+    if (ipPayload->PeekPacketTag(fTag))
     {
         NS_ABORT_MSG("Found in sendOutgoing");
         return;
@@ -261,16 +320,12 @@ Ipv4MpiFlowProbe::SendOutgoingLogger(
 
         // tag the packet with the flow id and packet id, so that the packet can be identified even
         // when Ipv4Header is not accessible at some non-IPv4 protocol layer
-        Time now = Simulator::Now();
-        Ipv4MpiFlowProbeTag fTag(flowId,
-            packetId,
-            size,
-            ipHeader.GetSource(),
-            ipHeader.GetDestination(),
-            now.ToInteger(Time::GetResolution()),
-            now.ToInteger(Time::GetResolution())
-        );
-        ipPayload->AddByteTag(fTag);
+        uint64_t now = Simulator::Now().GetNanoSeconds();
+        ipPayload->AddPacketTag(Ipv4MpiFlowProbeTag(flowId, packetId, now));
+
+        uint32_t hopSamplingRate = Ipv4MpiFlowClassifier :: GetHopSamplingRate();
+        if (hopSamplingRate && packetId % hopSamplingRate == 0)
+            ipPayload->AddPacketTag(Ipv4MpiFlowHopTag(m_nodeId, interface, now));
     }
 }
 
@@ -280,7 +335,30 @@ Ipv4MpiFlowProbe::ForwardLogger(
     Ptr<const Packet> ipPayload,
     uint32_t interface)
 {
-    NS_ABORT_MSG("Not implemented yet!");
+    ReportHop(ipPayload, interface, true);
+}
+
+void
+Ipv4MpiFlowProbe::ReportHop(Ptr<const Packet> ipPayload, uint32_t interface, bool forwarded)
+{
+    Ipv4MpiFlowHopTag hTag;
+    if (!ipPayload->PeekPacketTag(hTag))
+    {
+        // not sampled, this is all it costs
+        return;
+    }
+
+    uint64_t now = Simulator::Now().GetNanoSeconds();
+    m_flowMonitor->ReportForwarding(this, hTag.GetNodeId(), hTag.GetInterface(), now - hTag.GetTLast());
+
+    if (forwarded)
+    {
+        // The trace hands out the very packet that is sent next: take the
+        // tag of the last hop off it and tag it with this one instead
+        Ptr<Packet> packet = ConstCast<Packet>(ipPayload);
+        packet->RemovePacketTag(hTag);
+        packet->AddPacketTag(Ipv4MpiFlowHopTag(m_nodeId, interface, now));
+    }
 }
 
 void
@@ -288,44 +366,133 @@ Ipv4MpiFlowProbe::ForwardUpLogger(
     const Ipv4Header& ipHeader,
     Ptr<const Packet> ipPayload,
     uint32_t interface)
-{   
-    Ipv4MpiFlowProbeTag fTag;
-    bool found = ipPayload->FindFirstMatchingByteTag(fTag);
+{
+    // Same trick as the classifier: the source port is in the first two
+    // octets for both TCP and UDP and the TCP flags are at octet 13, no need
+    // to deserialize the whole header
+    uint8_t data[14] = {0};
+    uint32_t copied = ipPayload->CopyData(data, sizeof(data));
+
+    uint16_t portToFilter = Ipv4MpiFlowClassifier :: GetSourcePortToFilter();
+    if (portToFilter && copied >= 2 && ((data[0] << 8) | data[1]) == portToFilter)
+        return;
 
-    TcpHeader tcpHeader;
-    ipPayload->PeekHeader(tcpHeader);
+    Ipv4MpiFlowClassifier::FiveTuple tuple;
+    tuple.sourceAddress = ipHeader.GetSource();
+    tuple.destinationAddress = ipHeader.GetDestination();
+    tuple.protocol = ipHeader.GetProtocol();
+    tuple.sourcePort = (data[0] << 8) | data[1];
+    tuple.destinationPort = (data[2] << 8) | data[3];
 
-    if (tcpHeader.GetSourcePort() == Ipv4MpiFlowClassifier :: GetSourcePortToFilter())
-        return;
+    bool finished = tuple.protocol == TCP_PROT_NUMBER && copied >= 14 && (data[13] & TCP_FIN_FLAG);
+    if (finished)
+    {
+        // Drop the flow file entries of flows that were never joined, e.g.
+        // the ones not sampled, so that the registry does not keep growing
+        MpiFlowInfo info;
+        m_classifier->TakeFlowInfo(tuple, info);
+    }
+
+    Ipv4MpiFlowProbeTag fTag;
+    bool found = ipPayload->PeekPacketTag(fTag);
 
     if (found)
     {
-        if (!fTag.IsSrcDstValid(ipHeader.GetSource(), ipHeader.GetDestination()))
+        FlowId flowId = fTag.GetFlowId();
+        if (!m_classifier->IsSrcDstValid(flowId, ipHeader.GetSource(), ipHeader.GetDestination()))
         {
             NS_LOG_INFO("Not reporting encapsulated packet");
             return;
         }
 
-        FlowId flowId = fTag.GetFlowId();
         FlowPacketId packetId = fTag.GetPacketId();
-        uint64_t tStart = fTag.GettTStart();
-        uint64_t tLast = fTag.GetTLastRx();
+        uint64_t tStart = fTag.GetTStart();
 
         uint32_t size = (ipPayload->GetSize() + ipHeader.GetSerializedSize());
         NS_LOG_DEBUG("ReportLastRx (" << this << ", " << flowId << ", " << packetId << ", " << size
                                       << "); " << ipHeader << *ipPayload);
-        m_flowMonitor->ReportLastRx(this, flowId, packetId, size, tStart, tLast);
-        // if (tcpHeader.GetFlags() & tcpHeader.FIN) 
-        //     std::cout << "Flow " << flowId << " just finihsed. It has flag " << std::to_string(tcpHeader.GetFlags()) << "\n";
+        if (m_flowMonitor->ReportLastRx(this, flowId, packetId, size, tStart))
+        {
+            // first packet of the flow on this rank, join it with its flow file entry
+            MpiFlowInfo info;
+            if (m_classifier->TakeFlowInfo(tuple, info))
+                m_flowMonitor->ReportFlowInfo(this, flowId, info);
+        }
+        ReportHop(ipPayload, interface, false);
+
+        // The FIN can arrive before retransmissions of earlier bytes, the
+        // flow is only done once all of them are in
+        if (tuple.protocol == TCP_PROT_NUMBER && copied >= 14 &&
+            ReportTcpSegment(flowId, data, ipPayload->GetSize()))
+            m_flowMonitor->ReportFlowFinished(this, flowId);
     }
     else {
         if (Simulator::Now() > Ipv4MpiFlowClassifier :: GetMonitorUntil())
             return;
+
+        // not one of the sampled flows
+        if (Ipv4MpiFlowClassifier :: GetSamplingRate() > 1)
+            return;
         
         NS_ABORT_MSG("This should not happen!");
     }
 }
 
+bool
+Ipv4MpiFlowProbe::ReportTcpSegment(FlowId flowId, const uint8_t* header, uint32_t size)
+{
+    uint32_t seq = (header[4] << 24) | (header[5] << 16) | (header[6] << 8) | header[7];
+    uint32_t headerLength = (header[12] >> 4) * 4;
+    uint8_t flags = header[13];
+    // SYN and FIN take a sequence number each
+    uint32_t end = seq + (size > headerLength ? size - headerLength : 0) + ((flags & (TCP_SYN_FLAG | TCP_FIN_FLAG)) ? 1 : 0);
+
+    auto iter = m_tcpRx.find(flowId);
+    if (iter == m_tcpRx.end())
+    {
+        // Segments after the flow finished (or of a flow whose SYN was
+        // never seen) are not tracked, so finished flows leave nothing behind
+        if (!(flags & TCP_SYN_FLAG))
+        {
+            return false;
+        }
+        m_tcpRx.emplace(flowId, TcpRxState{end, 0, false, {}});
+        return false;
+    }
+
+    // Sequence numbers are compared as is: ns-3 starts connections at 0 and
+    // flows stay below 4 GB
+    TcpRxState& state = iter->second;
+    if (flags & TCP_FIN_FLAG)
+    {
+        state.fin = end;
+        state.finReceived = true;
+    }
+
+    if (seq <= state.next)
+    {
+        state.next = std::max(state.next, end);
+        // the segment may fill the hole in front of the ones past it
+        while (!state.outOfOrder.empty() && state.outOfOrder.begin()->first <= state.next)
+        {
+            state.next = std::max(state.next, state.outOfOrder.begin()->second);
+            state.outOfOrder.erase(state.outOfOrder.begin());
+        }
+    }
+    else if (end > seq)
+    {
+        uint32_t& known = state.outOfOrder[seq];
+        known = std::max(known, end);
+    }
+
+    if (state.finReceived && state.next >= state.fin)
+    {
+        m_tcpRx.erase(iter);
+        return true;
+    }
+    return false;
+}
+
 void
 Ipv4MpiFlowProbe::DropLogger(
     const Ipv4Header& ipHeader,
@@ -335,7 +502,7 @@ Ipv4MpiFlowProbe::DropLogger(
     uint32_t ifIndex)
 {
     Ipv4MpiFlowProbeTag fTag;
-    bool found = ipPayload->FindFirstMatchingByteTag(fTag);
+    bool found = ipPayload->PeekPacketTag(fTag);
 
     if (found)
     {
@@ -386,10 +553,10 @@ Ipv4MpiFlowProbe::DropLogger(
 }
 
 void
-Ipv4MpiFlowProbe::QueueDropLogger(Ptr<const Packet> ipPayload)
+Ipv4MpiFlowProbe::QueueDropLogger(Ptr<Ipv4MpiFlowProbe> probe, uint32_t l2HeaderSize, Ptr<const Packet> frame)
 {
     Ipv4MpiFlowProbeTag fTag;
-    bool tagFound = ipPayload->FindFirstMatchingByteTag(fTag);
+    bool tagFound = frame->PeekPacketTag(fTag);
 
     if (!tagFound)
     {
@@ -399,19 +566,20 @@ Ipv4MpiFlowProbe::QueueDropLogger(Ptr<const Packet> ipPayload)
 
     FlowId flowId = fTag.GetFlowId();
     FlowPacketId packetId = fTag.GetPacketId();
-    uint32_t size = fTag.GetPacketSize();
+    // the IPv4 packet of the frame, like the sizes of the other drops
+    uint32_t size = frame->GetSize() - std::min(frame->GetSize(), l2HeaderSize);
 
-    NS_LOG_INFO("Drop (" << this << ", " << flowId << ", " << packetId << ", " << size << ", "
+    NS_LOG_INFO("Drop (" << probe << ", " << flowId << ", " << packetId << ", " << size << ", "
                           << DROP_QUEUE << "); ");
 
-    m_flowMonitor->ReportDrop(this, flowId, packetId, size, DROP_QUEUE);
+    probe->m_flowMonitor->ReportDrop(probe, flowId, packetId, size, DROP_QUEUE);
 }
 
 void
 Ipv4MpiFlowProbe::QueueDiscDropLogger(Ptr<const QueueDiscItem> item)
 {
     Ipv4MpiFlowProbeTag fTag;
-    bool tagFound = item->GetPacket()->FindFirstMatchingByteTag(fTag);
+    bool tagFound = item->GetPacket()->PeekPacketTag(fTag);
 
     if (!tagFound)
     {
@@ -420,7 +588,8 @@ Ipv4MpiFlowProbe::QueueDiscDropLogger(Ptr<const QueueDiscItem> item)
 
     FlowId flowId = fTag.GetFlowId();
     FlowPacketId packetId = fTag.GetPacketId();
-    uint32_t size = fTag.GetPacketSize();
+    // accounts for the IPv4 header, which is kept apart from the packet in the item
+    uint32_t size = item->GetSize();
 
     NS_LOG_INFO("Drop (" << this << ", " << flowId << ", " << packetId << ", " << size << ", "
                           << DROP_QUEUE_DISC << "); ");
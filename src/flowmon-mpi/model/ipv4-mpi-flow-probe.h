@@ -7,12 +7,24 @@
 #include "ns3/ipv4-l3-protocol.h"
 #include "ns3/queue-item.h"
 
+#include <map>
+#include <unordered_map>
+
 namespace ns3
 {
 
 class MpiFlowMonitor;
 class Node;
 
+/**
+ * Packet tag carried by monitored packets from the sender to the receiver.
+ *
+ * Kept to 16 bytes since it is copied with every packet and serialized into
+ * every packet that crosses ranks. The source and destination addresses are
+ * not carried, the receiver checks them against the flow's five-tuple when
+ * the flow was classified on its own rank. The packet size is taken from
+ * the packet itself wherever it is needed.
+ */
 class Ipv4MpiFlowProbeTag : public Tag
 {
   public:
@@ -28,41 +40,62 @@ class Ipv4MpiFlowProbeTag : public Tag
     void Print(std::ostream& os) const override;
     Ipv4MpiFlowProbeTag();
     
-    Ipv4MpiFlowProbeTag(uint32_t flowId,
-                     uint32_t packetId,
-                     uint32_t packetSize,
-                     Ipv4Address src,
-                     Ipv4Address dst,
-                     uint64_t tStart,
-                     uint64_t tLasttRx);
+    Ipv4MpiFlowProbeTag(uint32_t flowId, uint32_t packetId, uint64_t tStart);
                      
     void SetFlowId(uint32_t flowId);
     void SetPacketId(uint32_t packetId);
-    void SetPacketSize(uint32_t packetSize);
-    void SettTStart(uint64_t tStart);
-    void SetTLastRx(uint64_t tLastRx);
+    void SetTStart(uint64_t tStart);
 
     uint32_t GetFlowId() const;
     uint32_t GetPacketId() const;
-    uint32_t GetPacketSize() const;
-    uint64_t GettTStart() const;
-    uint64_t GetTLastRx() const;
-    bool IsSrcDstValid(Ipv4Address src, Ipv4Address dst) const;
+    uint64_t GetTStart() const;
 
   private:
     uint32_t m_flowId;     //!< flow identifier
     uint32_t m_packetId;   //!< packet identifier
-    uint32_t m_packetSize; //!< packet size
-    Ipv4Address m_src;     //!< IP source
-    Ipv4Address m_dst;     //!< IP destination
-    uint64_t m_tStart;     //!< Timestamp of first time seeing this packet
-    uint64_t m_tLastRx;    //!< Timestamp of last time receiving this packet
+    uint64_t m_tStart;     //!< Time the packet was first sent, in nanoseconds
+};
+
+/**
+ * Extra packet tag on the packets sampled for per-hop latency tracing.
+ *
+ * It holds the node and egress interface the packet was last sent on and
+ * when. The next node that sees the packet accounts the time since then to
+ * that interface, i.e. the queueing, transmission and propagation delay of
+ * the link, and moves the tag along.
+ */
+class Ipv4MpiFlowHopTag : public Tag
+{
+  public:
+    static TypeId GetTypeId();
+    TypeId GetInstanceTypeId() const override;
+    uint32_t GetSerializedSize() const override;
+    void Serialize(TagBuffer buf) const override;
+    void Deserialize(TagBuffer buf) override;
+    void Print(std::ostream& os) const override;
+    Ipv4MpiFlowHopTag();
+
+    Ipv4MpiFlowHopTag(uint32_t nodeId, uint32_t interface, uint64_t tLast);
+
+    uint32_t GetNodeId() const;
+    uint32_t GetInterface() const;
+    uint64_t GetTLast() const;
+
+  private:
+    uint32_t m_nodeId;     //!< Node that last sent the packet
+    uint32_t m_interface;  //!< Interface of that node the packet was sent on
+    uint64_t m_tLast;      //!< Time it was sent, in nanoseconds
 };
 
 class Ipv4MpiFlowProbe : public MpiFlowProbe
 {
   public:
-    Ipv4MpiFlowProbe(Ptr<MpiFlowMonitor> monitor, Ptr<Ipv4MpiFlowClassifier> classifier, Ptr<Node> node);
+    /**
+     * A probe that follows the monitored flows sent from, received on and
+     * dropped at `node`, or with `hopOnly` one that only accounts the hop
+     * delays of the sampled packets it forwards, for switches.
+     */
+    Ipv4MpiFlowProbe(Ptr<MpiFlowMonitor> monitor, Ptr<Ipv4MpiFlowClassifier> classifier, Ptr<Node> node, bool hopOnly = false);
     ~Ipv4MpiFlowProbe() override;
 
     static TypeId GetTypeId();
@@ -110,11 +143,34 @@ class Ipv4MpiFlowProbe : public MpiFlowProbe
                     Ipv4L3Protocol::DropReason reason,
                     Ptr<Ipv4> ipv4,
                     uint32_t ifIndex);
-    void QueueDropLogger(Ptr<const Packet> ipPayload);
+    /// Drops of a device queue, whose frames start with an L2 header of `l2HeaderSize` bytes
+    static void QueueDropLogger(Ptr<Ipv4MpiFlowProbe> probe, uint32_t l2HeaderSize, Ptr<const Packet> frame);
     void QueueDiscDropLogger(Ptr<const QueueDiscItem> item);
 
+    /// Account the last hop of a sampled packet and move its hop tag to (this node, interface)
+    void ReportHop(Ptr<const Packet> ipPayload, uint32_t interface, bool forwarded);
+
+    /**
+     * Account a received TCP segment of a monitored flow, given the first
+     * 14 octets of its TCP header and its size with the header.
+     *
+     * \return true once the FIN was received along with every byte before it
+     */
+    bool ReportTcpSegment(FlowId flowId, const uint8_t* header, uint32_t size);
+
+    /// What the receiver has of a TCP flow, from its SYN on
+    struct TcpRxState
+    {
+        uint32_t next;                   //!< First sequence number not received yet
+        uint32_t fin;                    //!< Sequence number right after the FIN, once it arrived
+        bool finReceived;
+        std::map<uint32_t, uint32_t> outOfOrder; //!< Segments received past a hole, start --> end
+    };
+
     Ptr<Ipv4MpiFlowClassifier> m_classifier; //!< the Ipv4MpiFlowClassifier this probe is associated with
     Ptr<Ipv4L3Protocol> m_ipv4;              //!< the Ipv4L3Protocol this probe is bound to
+    uint32_t m_nodeId;                       //!< Id of the node this probe is installed on
+    std::unordered_map<FlowId, TcpRxState> m_tcpRx; //!< TCP flows received on this node and not finished
 };
 
 } // namespace ns3
@@ -4,7 +4,8 @@ namespace ns3
 {
 
 MpiFlowClassifier::MpiFlowClassifier()
-    : m_lastNewFlowId(0)
+    : m_lastNewFlowId(0),
+      m_systemId(0)
 {
 }
 
@@ -12,6 +12,23 @@ typedef uint32_t FlowId;
 
 typedef uint32_t FlowPacketId;
 
+/// Flow identifiers carry the systemId of the classifier that created them in their top bits
+#define MPI_FLOW_ID_SYSTEM_SHIFT 26
+
+struct MpiFlowRecord;
+
+/**
+ * What the traffic generator knows about a flow before it starts, joined to
+ * the monitored flow by its five-tuple when the receiver first sees it.
+ */
+struct MpiFlowInfo
+{
+    uint32_t index;     //!< Position of the flow in the flow file
+    uint32_t size;      //!< Bytes the application sends
+    int64_t idealFct;   //!< Completion time on an idle network in ns, 0 if unknown
+    uint32_t group;     //!< Group of the source (e.g. its pod) the snapshots are broken down by
+};
+
 class MpiFlowClassifier : public SimpleRefCount<MpiFlowClassifier>
 {
   private:
@@ -28,14 +45,22 @@ class MpiFlowClassifier : public SimpleRefCount<MpiFlowClassifier>
 
     virtual void SerializeToXmlStream(std::ostream& os, uint16_t indent) const = 0;
 
+    /// Fill the flow description fields of a record, false if the flow is not known here
+    virtual bool FillFlowRecord(FlowId flowId, MpiFlowRecord& record) const = 0;
+
     void SetSystemId(uint32_t systemId) {
       m_systemId = systemId;
-      m_lastNewFlowId = systemId << 26;
+      m_lastNewFlowId = systemId << MPI_FLOW_ID_SYSTEM_SHIFT;
     }
 
   protected:
     FlowId GetNewFlowId();
 
+    /// Flow identifiers handed out by this classifier start right after this value
+    FlowId GetFlowIdBase() const {
+      return m_systemId << MPI_FLOW_ID_SYSTEM_SHIFT;
+    }
+
     void Indent(std::ostream& os, uint16_t level) const;
 };
 
@@ -1,9 +1,20 @@
 #include "mpi-flow-monitor.h"
+#include "mpi-flow-record.h"
 
+#include "ns3/boolean.h"
 #include "ns3/double.h"
 #include "ns3/log.h"
 #include "ns3/simulator.h"
+#include "ns3/uinteger.h"
 
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+
+#include <mpi.h>
+#endif /* NS3_MPI */
+
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
@@ -14,6 +25,9 @@ NS_LOG_COMPONENT_DEFINE("MpiFlowMonitor");
 
 NS_OBJECT_ENSURE_REGISTERED(MpiFlowMonitor);
 
+/// Hop delays only need a rough shape, 16 buckets per power of two (~6%) keep each link small
+const uint32_t HOP_DELAY_SKETCH_SUB_BITS = 4;
+
 TypeId
 MpiFlowMonitor::GetTypeId()
 {
@@ -22,13 +36,6 @@ MpiFlowMonitor::GetTypeId()
             .SetParent<Object>()
             .SetGroupName("MpiFlowMonitor")
             .AddConstructor<MpiFlowMonitor>()
-            .AddAttribute(
-                "MaxPerHopDelay",
-                ("The maximum per-hop delay that should be considered.  "
-                 "Packets still not received after this delay are to be considered lost."),
-                TimeValue(Seconds(10.0)),
-                MakeTimeAccessor(&MpiFlowMonitor::m_maxPerHopDelay),
-                MakeTimeChecker())
             .AddAttribute("StartTime",
                           ("The time when the monitoring starts."),
                           TimeValue(Seconds(0.0)),
@@ -39,7 +46,20 @@ MpiFlowMonitor::GetTypeId()
                 ("The minimum inter-arrival time that is considered a flow interruption."),
                 TimeValue(Seconds(0.5)),
                 MakeTimeAccessor(&MpiFlowMonitor::m_flowInterruptionsMinTime),
-                MakeTimeChecker());
+                MakeTimeChecker())
+            .AddAttribute("SmallFlowThreshold",
+                          ("Flows with fewer received bytes are reported as small flows, "
+                           "the others as large flows."),
+                          UintegerValue(150 * 1024),
+                          MakeUintegerAccessor(&MpiFlowMonitor::m_smallFlowThreshold),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("PerFlowStats",
+                          ("Keep per-flow statistics for the XML and binary outputs. When false, "
+                           "flows are only accounted in the FCT and throughput sketches and "
+                           "forgotten once they complete."),
+                          BooleanValue(true),
+                          MakeBooleanAccessor(&MpiFlowMonitor::m_perFlowStats),
+                          MakeBooleanChecker());
     return tid;
 }
 
@@ -51,17 +71,33 @@ MpiFlowMonitor::GetInstanceTypeId() const
 
 MpiFlowMonitor::MpiFlowMonitor()
     : m_enabled(false),
-      m_systemId(0)
+      m_systemId(0),
+      m_samplingRate(1),
+      m_smallFlowThreshold(150 * 1024),
+      m_perFlowStats(true)
 {
     NS_LOG_FUNCTION(this);
 }
 
+void
+MpiFlowMonitor::NotifyConstructionCompleted()
+{
+    Object::NotifyConstructionCompleted();
+    m_summary.SetSmallFlowThreshold(m_smallFlowThreshold);
+}
+
 void
 MpiFlowMonitor::DoDispose()
 {
     NS_LOG_FUNCTION(this);
     Simulator::Cancel(m_startEvent);
     Simulator::Cancel(m_stopEvent);
+    Simulator::Cancel(m_snapshotEvent);
+    if (m_snapshotStream.is_open())
+    {
+        m_snapshotStream.close();
+    }
+    m_activeFlows.clear();
     for (auto iter = m_classifiers.begin(); iter != m_classifiers.end(); iter++)
     {
         *iter = nullptr;
@@ -84,6 +120,13 @@ MpiFlowMonitor::GetStatsForFlow(FlowId flowId)
         MpiFlowMonitor::FlowStats& ref = m_flowStats[flowId];
         ref.txBytes = 0;
         ref.rxBytes = 0;
+        ref.flowFileIndex = MPI_FLOW_FILE_INDEX_NONE;
+        ref.flowSize = 0;
+        ref.idealFct = 0;
+        ref.flowGroup = MPI_FLOW_GROUP_NONE;
+        ref.tcpTimeouts = 0;
+        ref.tcpFastRetransmits = 0;
+        ref.tcpEcnReductions = 0;
         return ref;
     }
     else
@@ -104,10 +147,12 @@ MpiFlowMonitor::ReportFirstTx(Ptr<MpiFlowProbe> probe,
         NS_LOG_DEBUG("MpiFlowMonitor not enabled; returning");
         return;
     }
+    if (!m_perFlowStats)
+    {
+        // the receiver gets the first transmission time from the tag
+        return;
+    }
     Time now = Simulator::Now();
-    TrackedPacket& tracked = m_trackedPackets[std::make_pair(flowId, packetId)];
-    tracked.firstSeenTime = now;
-    tracked.lastSeenTime = tracked.firstSeenTime;
     probe->AddPacketStats(flowId, packetSize, Seconds(0));
 
     FlowStats& stats = GetStatsForFlow(flowId);
@@ -122,53 +167,85 @@ MpiFlowMonitor::ReportFirstTx(Ptr<MpiFlowProbe> probe,
 void
 MpiFlowMonitor::ReportForwarding(
     Ptr<MpiFlowProbe> probe,
-    uint32_t flowId,
-    uint32_t packetId,
-    uint32_t packetSize, 
-    uint64_t tStart, 
-    uint64_t tLastRx)
+    uint32_t nodeId,
+    uint32_t interface,
+    uint64_t delay)
 {
-    NS_ABORT_MSG("Forwarding check not yet implement!");
+    NS_LOG_FUNCTION(this << probe << nodeId << interface << delay);
+    if (!m_enabled)
+    {
+        NS_LOG_DEBUG("MpiFlowMonitor not enabled; returning");
+        return;
+    }
+
+    m_hopDelays.try_emplace(std::make_pair(nodeId, interface), HOP_DELAY_SKETCH_SUB_BITS)
+        .first->second.Add(delay);
 }
 
-void
+bool
 MpiFlowMonitor::ReportLastRx(
     Ptr<MpiFlowProbe> probe,
     uint32_t flowId,
     uint32_t packetId,
     uint32_t packetSize,
-    uint64_t tStart, 
-    uint64_t tLastRx)
+    uint64_t tStart)
 {
-    NS_LOG_FUNCTION(this << probe << flowId << packetId << packetSize);
+    NS_LOG_FUNCTION(this << probe << flowId << packetId << packetSize << tStart);
     if (!m_enabled)
     {
         NS_LOG_DEBUG("MpiFlowMonitor not enabled; returning");
-        return;
+        return false;
+    }
+
+    if (!m_perFlowStats && IsFinished(flowId))
+    {
+        // duplicates after all the bytes were in, the flow was already accounted and forgotten
+        return false;
     }
 
     Time now = Simulator::Now();
-    Time delay = (now - Time::FromInteger(tStart, Time::NS));
-    probe->AddPacketStats(flowId, packetSize, delay);
+    if (m_perFlowStats)
+    {
+        Time delay = (now - Time::FromInteger(tStart, Time::NS));
+        probe->AddPacketStats(flowId, packetSize, delay);
+    }
 
     FlowStats& stats = GetStatsForFlow(flowId);
 
-    if (stats.timeFirstTxPacket.ToInteger(Time::GetResolution()) == 0)
-        stats.timeFirstTxPacket = Time::FromInteger(tStart, Time::GetResolution());
+    if (stats.timeFirstTxPacket.IsZero())
+        stats.timeFirstTxPacket = Time::FromInteger(tStart, Time::NS);
 
-    if (stats.rxBytes == 1)
+    bool first = stats.rxBytes == 0;
+    if (first)
     {
         stats.timeFirstRxPacket = now;
+        m_numStartedFlows.Increment();
+        if (!m_snapshotInterval.IsZero() && !IsFinished(flowId))
+        {
+            m_activeFlows[flowId] = ActiveFlow{&stats, 0};
+        }
     }
     stats.rxBytes += packetSize;
     stats.timeLastRxPacket = now;
+    return first;
+}
+
+void
+MpiFlowMonitor::ReportFlowInfo(Ptr<MpiFlowProbe> probe, FlowId flowId, const MpiFlowInfo& info)
+{
+    NS_LOG_FUNCTION(this << probe << flowId << info.index);
 
-    NS_LOG_DEBUG("ReportLastTx: removing tracked packet (flowId=" << flowId << ", packetId="
-                                                                  << packetId << ").");
+    auto iter = m_flowStats.find(flowId);
+    if (iter == m_flowStats.end())
+    {
+        return;
+    }
 
-    auto tracked = m_trackedPackets.find(std::make_pair(flowId, packetId));
-    if (tracked != m_trackedPackets.end())
-        m_trackedPackets.erase(tracked); // we don't need to track this packet anymore
+    FlowStats& stats = iter->second;
+    stats.flowFileIndex = info.index;
+    stats.flowSize = info.size;
+    stats.idealFct = info.idealFct;
+    stats.flowGroup = info.group;
 }
 
 void
@@ -186,6 +263,12 @@ MpiFlowMonitor::ReportDrop(
         return;
     }
 
+    m_numDrops.Increment();
+    if (!m_perFlowStats)
+    {
+        return;
+    }
+
     probe->AddPacketDropStats(flowId, packetSize, reasonCode);
 
     FlowStats& stats = GetStatsForFlow(flowId);
@@ -198,28 +281,114 @@ MpiFlowMonitor::ReportDrop(
     stats.bytesDropped[reasonCode] += packetSize;
     NS_LOG_DEBUG("++stats.packetsDropped["
                  << reasonCode << "]; // becomes: " << stats.packetsDropped[reasonCode]);
+}
+
+void
+MpiFlowMonitor::ReportFlowFinished(Ptr<MpiFlowProbe> probe, FlowId flowId)
+{
+    NS_LOG_FUNCTION(this << probe << flowId);
+    if (!m_enabled)
+    {
+        NS_LOG_DEBUG("MpiFlowMonitor not enabled; returning");
+        return;
+    }
+
+    auto iter = m_flowStats.find(flowId);
+    if (iter == m_flowStats.end() || !MarkFinished(flowId))
+    {
+        return;
+    }
+
+    m_numCompletedFlows.Increment();
+    const FlowStats& stats = iter->second;
+    int64_t fct = (stats.timeLastRxPacket - stats.timeFirstTxPacket).GetNanoSeconds();
+    m_summary.AddFlow(stats.flowSize ? stats.flowSize : stats.rxBytes, fct, stats.idealFct);
+
+    auto activeI = m_activeFlows.find(flowId);
+    if (activeI != m_activeFlows.end())
+    {
+        // the rest of its bytes go into the next snapshot along with the completion
+        MpiFlowSnapshot& row = GetSnapshotRow(m_finishedRows, stats);
+        row.rxBytes += stats.rxBytes - std::min(stats.rxBytes, activeI->second.rxBytes);
+        row.completedFlows++;
+        m_activeFlows.erase(activeI);
+    }
 
-    auto tracked = m_trackedPackets.find(std::make_pair(flowId, packetId));
-    if (tracked != m_trackedPackets.end())
+    if (!m_perFlowStats)
     {
-        // we don't need to track this packet anymore
-        // FIXME: this will not necessarily be true with broadcast/multicast
-        NS_LOG_DEBUG("ReportDrop: removing tracked packet (flowId=" << flowId << ", packetId="
-                                                                    << packetId << ").");
-        m_trackedPackets.erase(tracked);
+        m_flowStats.erase(iter);
     }
 }
 
-const MpiFlowMonitor::FlowStatsContainer&
-MpiFlowMonitor::GetFlowStats() const
+void
+MpiFlowMonitor::ReportTcpCongState(FlowId flowId, TcpSocketState::TcpCongState_t newState)
 {
-    return m_flowStats;
+    NS_LOG_FUNCTION(this << flowId << newState);
+    if (!m_enabled)
+    {
+        NS_LOG_DEBUG("MpiFlowMonitor not enabled; returning");
+        return;
+    }
+
+    // the sender's stats exist since its first packet, never create them here
+    auto iter = m_flowStats.find(flowId);
+    if (iter == m_flowStats.end())
+    {
+        return;
+    }
+
+    switch (newState)
+    {
+    case TcpSocketState::CA_LOSS:
+        iter->second.tcpTimeouts++;
+        break;
+    case TcpSocketState::CA_RECOVERY:
+        iter->second.tcpFastRetransmits++;
+        break;
+    case TcpSocketState::CA_CWR:
+        iter->second.tcpEcnReductions++;
+        break;
+    default:
+        break;
+    }
 }
 
-void
-MpiFlowMonitor::NotifyConstructionCompleted()
+bool
+MpiFlowMonitor::IsFinished(FlowId flowId) const
 {
-    Object::NotifyConstructionCompleted();
+    uint32_t system = flowId >> MPI_FLOW_ID_SYSTEM_SHIFT;
+    uint32_t index = flowId & ((1u << MPI_FLOW_ID_SYSTEM_SHIFT) - 1);
+    return system < m_finishedFlows.size() && index < m_finishedFlows[system].size() &&
+           m_finishedFlows[system][index];
+}
+
+bool
+MpiFlowMonitor::MarkFinished(FlowId flowId)
+{
+    uint32_t system = flowId >> MPI_FLOW_ID_SYSTEM_SHIFT;
+    uint32_t index = flowId & ((1u << MPI_FLOW_ID_SYSTEM_SHIFT) - 1);
+    if (system >= m_finishedFlows.size())
+    {
+        m_finishedFlows.resize(system + 1);
+    }
+
+    std::vector<bool>& finished = m_finishedFlows[system];
+    if (index >= finished.size())
+    {
+        finished.resize(std::max<size_t>(index + 1, finished.size() * 2), false);
+    }
+    if (finished[index])
+    {
+        return false;
+    }
+    finished[index] = true;
+    return true;
+}
+
+const MpiFlowMonitor::FlowStatsContainer&
+MpiFlowMonitor::GetFlowStats() const
+{
+    return m_flowStats;
 }
 
 void
@@ -296,7 +465,7 @@ MpiFlowMonitor::SerializeToXmlStream(
 {
     NS_LOG_FUNCTION(this << indent << enableHistograms << enableProbes);
 
-    os << std::string(indent, ' ') << "<FlowMonitor>\n";
+    os << std::string(indent, ' ') << "<FlowMonitor samplingRate=\"" << m_samplingRate << "\">\n";
     indent += 2;
     os << std::string(indent, ' ') << "<FlowStats>\n";
     indent += 2;
@@ -311,8 +480,16 @@ MpiFlowMonitor::SerializeToXmlStream(
         os << "<Flow flowId=\"" << flowI->first
            << "\"" ATTRIB_TIME(timeFirstTxPacket) ATTRIB_TIME(timeFirstRxPacket)
                   ATTRIB_TIME(timeLastTxPacket) ATTRIB_TIME(timeLastRxPacket) 
-                       ATTRIB(txBytes) ATTRIB(rxBytes)
-           << ">\n";
+                       ATTRIB(txBytes) ATTRIB(rxBytes);
+        if (flowI->second.flowFileIndex != MPI_FLOW_FILE_INDEX_NONE)
+        {
+            os ATTRIB(flowFileIndex) ATTRIB(flowSize);
+        }
+        if (flowI->second.tcpTimeouts || flowI->second.tcpFastRetransmits || flowI->second.tcpEcnReductions)
+        {
+            os ATTRIB(tcpTimeouts) ATTRIB(tcpFastRetransmits) ATTRIB(tcpEcnReductions);
+        }
+        os << ">\n";
 #undef ATTRIB_TIME
 #undef ATTRIB
 
@@ -372,21 +549,279 @@ MpiFlowMonitor::SerializeToXmlFile(std::string fileName, bool enableHistograms,
 {
     NS_LOG_FUNCTION(this << fileName << m_systemId << enableHistograms << enableProbes);
 
-    std::string fileNameWithSystemId;
-    std::string::size_type pos = fileName.find(".xml");
-    if (pos != std::string::npos) {
-        fileNameWithSystemId += fileName.substr(0, pos) + '-' + std::to_string(m_systemId) + ".xml";
+    std::ofstream os(GetSystemFileName(fileName, ".xml"), std::ios::out | std::ios::binary);
+    os << "<?xml version=\"1.0\" ?>\n";
+    SerializeToXmlStream(os, 0, enableHistograms, enableProbes);
+    os.close();
+}
+
+void
+MpiFlowMonitor::SerializeToBinaryFile(std::string fileName)
+{
+    NS_LOG_FUNCTION(this << fileName << m_systemId);
+
+    MpiFlowRecordWriter writer;
+    writer.Open(GetSystemFileName(fileName, ".bin"), m_systemId, m_samplingRate);
+
+    MpiFlowRecord record;
+    for (auto flowI = m_flowStats.begin(); flowI != m_flowStats.end(); flowI++)
+    {
+        FillFlowRecord(flowI->first, flowI->second, record);
+        writer.Write(record);
     }
-    else {
-        fileNameWithSystemId += fileName + '-' + std::to_string(m_systemId) + ".xml";
+
+    writer.Close();
+}
+
+void
+MpiFlowMonitor::FillFlowRecord(FlowId flowId, const FlowStats& stats, MpiFlowRecord& record) const
+{
+    std::memset(&record, 0, sizeof(record));
+    record.flowId = flowId;
+    for (auto iter = m_classifiers.begin(); iter != m_classifiers.end(); iter++)
+    {
+        if ((*iter)->FillFlowRecord(flowId, record))
+            break;
     }
 
-    std::ofstream os(fileNameWithSystemId, std::ios::out | std::ios::binary);
-    os << "<?xml version=\"1.0\" ?>\n";
-    SerializeToXmlStream(os, 0, enableHistograms, enableProbes);
+    record.timeFirstTxPacket = stats.timeFirstTxPacket.GetNanoSeconds();
+    record.timeFirstRxPacket = stats.timeFirstRxPacket.GetNanoSeconds();
+    record.timeLastTxPacket = stats.timeLastTxPacket.GetNanoSeconds();
+    record.timeLastRxPacket = stats.timeLastRxPacket.GetNanoSeconds();
+    record.txBytes = stats.txBytes;
+    record.rxBytes = stats.rxBytes;
+    record.flowFileIndex = stats.flowFileIndex;
+    record.flowSize = stats.flowSize;
+    record.tcpTimeouts = stats.tcpTimeouts;
+    record.tcpFastRetransmits = stats.tcpFastRetransmits;
+    record.tcpEcnReductions = stats.tcpEcnReductions;
+    for (uint32_t reasonCode = 0; reasonCode < stats.packetsDropped.size(); reasonCode++)
+    {
+        record.packetsDropped += stats.packetsDropped[reasonCode];
+        record.bytesDropped += stats.bytesDropped[reasonCode];
+    }
+}
+
+void
+MpiFlowMonitor::SerializeToMergedFile(std::string fileName)
+{
+    NS_LOG_FUNCTION(this << fileName << m_systemId);
+
+    std::vector<MpiFlowRecord> records(m_flowStats.size());
+    auto recordI = records.begin();
+    for (auto flowI = m_flowStats.begin(); flowI != m_flowStats.end(); flowI++, recordI++)
+    {
+        FillFlowRecord(flowI->first, flowI->second, *recordI);
+    }
+
+    uint32_t rank = m_systemId;
+#ifdef NS3_MPI
+    if (MpiInterface::IsEnabled() && MpiInterface::GetSize() > 1)
+    {
+        MPI_Comm comm = MpiInterface::GetCommunicator();
+        uint32_t size = MpiInterface::GetSize();
+        rank = MpiInterface::GetSystemId();
+
+        // counts and displacements are in records, not bytes, so that a rank
+        // can contribute more than 2 GB before the int arguments overflow
+        MPI_Datatype recordType;
+        MPI_Type_contiguous(sizeof(MpiFlowRecord), MPI_BYTE, &recordType);
+        MPI_Type_commit(&recordType);
+
+        int count = records.size();
+        std::vector<int> counts(rank == 0 ? size : 0);
+        MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+
+        std::vector<int> displacements(counts.size());
+        std::vector<MpiFlowRecord> gathered;
+        if (rank == 0)
+        {
+            int total = 0;
+            for (uint32_t i = 0; i < size; i++)
+            {
+                displacements[i] = total;
+                total += counts[i];
+            }
+            gathered.resize(total);
+        }
+
+        MPI_Gatherv(records.data(),
+                    count,
+                    recordType,
+                    gathered.data(),
+                    counts.data(),
+                    displacements.data(),
+                    recordType,
+                    0,
+                    comm);
+        MPI_Type_free(&recordType);
+        records.swap(gathered);
+    }
+#endif /* NS3_MPI */
+
+    if (rank != 0)
+    {
+        return;
+    }
+
+    MergeFlowRecords(records);
+
+    std::string::size_type pos = fileName.find(".bin");
+    if (pos != std::string::npos)
+    {
+        fileName = fileName.substr(0, pos);
+    }
+
+    MpiFlowRecordWriter writer;
+    writer.Open(fileName + ".bin", rank, m_samplingRate);
+    for (const auto& record : records)
+    {
+        writer.Write(record);
+    }
+    writer.Close();
+
+    MpiFlowSummary summary;
+    summary.SetSmallFlowThreshold(m_smallFlowThreshold);
+    for (const auto& record : records)
+    {
+        if (record.timeFirstTxPacket != 0)
+        {
+            summary.AddFlow(record.rxBytes, record.timeLastRxPacket - record.timeFirstTxPacket);
+        }
+    }
+
+    std::ofstream os(fileName + "-summary.txt", std::ios::out);
+    os << "flows " << records.size() << "\n";
+    os << "samplingRate " << m_samplingRate << "\n";
+    summary.Write(os);
+    os.close();
+}
+
+void
+MpiFlowMonitor::SerializeSummaryToFile(std::string fileName)
+{
+    NS_LOG_FUNCTION(this << fileName << m_systemId);
+
+    m_summary.Reduce();
+
+    uint32_t rank = m_systemId;
+#ifdef NS3_MPI
+    if (MpiInterface::IsEnabled())
+    {
+        rank = MpiInterface::GetSystemId();
+    }
+#endif /* NS3_MPI */
+
+    if (rank != 0)
+    {
+        return;
+    }
+
+    std::ofstream os(fileName + "-summary.txt", std::ios::out);
+    os << "samplingRate " << m_samplingRate << "\n";
+    m_summary.Write(os);
+    os.close();
+}
+
+void
+MpiFlowMonitor::SerializeHopDelaysToFile(std::string fileName)
+{
+    NS_LOG_FUNCTION(this << fileName << m_systemId);
+
+    std::ofstream os(GetSystemFileName(fileName + "-hops", ".csv"), std::ios::out);
+    os << "node,interface,packets,p50_ns,p99_ns,p999_ns\n";
+    for (const auto& [link, delays] : m_hopDelays)
+    {
+        os << link.first << "," << link.second << "," << delays.GetCount() << ","
+           << delays.GetPercentile(50) << "," << delays.GetPercentile(99) << ","
+           << delays.GetPercentile(99.9) << "\n";
+    }
     os.close();
 }
 
+std::string
+MpiFlowMonitor::GetSystemFileName(std::string fileName, std::string extension) const
+{
+    std::string::size_type pos = fileName.find(extension);
+    if (pos != std::string::npos) {
+        return fileName.substr(0, pos) + '-' + std::to_string(m_systemId) + extension;
+    }
+    return fileName + '-' + std::to_string(m_systemId) + extension;
+}
+
+void
+MpiFlowMonitor::EnableSnapshots(std::string fileName, Time interval)
+{
+    NS_LOG_FUNCTION(this << fileName << interval.As(Time::S));
+    NS_ABORT_MSG_IF(!interval.IsStrictlyPositive(), "Snapshot interval must be positive");
+
+    std::string snapshotFileName = GetSystemFileName(fileName + "-snapshots", ".bin");
+    m_snapshotStream.open(snapshotFileName, std::ios::out | std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_IF(!m_snapshotStream.is_open(), "Could not open snapshot file " << snapshotFileName);
+
+    MpiFlowSnapshotFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MPI_FLOW_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = MPI_FLOW_SNAPSHOT_VERSION;
+    header.recordSize = sizeof(MpiFlowSnapshot);
+    header.systemId = m_systemId;
+    header.samplingRate = m_samplingRate;
+    header.interval = interval.GetNanoSeconds();
+    m_snapshotStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_snapshotStream.flush();
+
+    m_snapshotInterval = interval;
+    Simulator::Cancel(m_snapshotEvent);
+    m_snapshotEvent = Simulator::Schedule(interval, &MpiFlowMonitor::DoSnapshot, this);
+}
+
+MpiFlowSnapshot&
+MpiFlowMonitor::GetSnapshotRow(SnapshotRows& rows, const FlowStats& stats) const
+{
+    // flows not joined with the flow file are classified by what they received so far
+    uint64_t size = stats.flowSize ? stats.flowSize : stats.rxBytes;
+    uint8_t sizeClass =
+        size < m_smallFlowThreshold ? MpiFlowSummary::SMALL_FLOWS : MpiFlowSummary::LARGE_FLOWS;
+
+    auto inserted = rows.try_emplace(std::make_pair(stats.flowGroup, sizeClass));
+    MpiFlowSnapshot& row = inserted.first->second;
+    if (inserted.second)
+    {
+        std::memset(&row, 0, sizeof(row));
+        row.group = stats.flowGroup;
+        row.sizeClass = sizeClass;
+    }
+    return row;
+}
+
+void
+MpiFlowMonitor::DoSnapshot()
+{
+    NS_LOG_FUNCTION(this << m_activeFlows.size());
+
+    SnapshotRows rows;
+    rows.swap(m_finishedRows);
+    for (auto& [flowId, active] : m_activeFlows)
+    {
+        uint64_t rxBytes = active.stats->rxBytes;
+        MpiFlowSnapshot& row = GetSnapshotRow(rows, *active.stats);
+        // the counters go back to zero after ResetAllStats
+        row.rxBytes += rxBytes - std::min(rxBytes, active.rxBytes);
+        row.activeFlows++;
+        active.rxBytes = rxBytes;
+    }
+
+    int64_t now = Simulator::Now().GetNanoSeconds();
+    for (auto& [key, row] : rows)
+    {
+        row.time = now;
+        m_snapshotStream.write(reinterpret_cast<const char*>(&row), sizeof(row));
+    }
+    m_snapshotStream.flush();
+
+    m_snapshotEvent = Simulator::Schedule(m_snapshotInterval, &MpiFlowMonitor::DoSnapshot, this);
+}
+
 void
 MpiFlowMonitor::ResetAllStats()
 {
@@ -3,14 +3,20 @@
 
 #include "mpi-flow-probe.h"
 #include "mpi-flow-classifier.h"
+#include "mpi-flow-record.h"
+#include "mpi-flow-sketch.h"
+#include "mpi-telemetry-exporter.h"
 
 #include "ns3/event-id.h"
 #include "ns3/histogram.h"
 #include "ns3/nstime.h"
 #include "ns3/object.h"
 #include "ns3/ptr.h"
+#include "ns3/tcp-socket-state.h"
 
+#include <fstream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 namespace ns3
@@ -33,6 +39,14 @@ class MpiFlowMonitor : public Object
             packetsDropped; // packetsDropped[reasonCode] => number of dropped packets
 
         std::vector<uint64_t> bytesDropped;   // bytesDropped[reasonCode] => number of dropped bytes
+
+        uint32_t flowFileIndex;     // position in the flow file, MPI_FLOW_FILE_INDEX_NONE if unknown
+        uint32_t flowSize;          // size in the flow file, 0 if unknown
+        int64_t idealFct;           // FCT on an idle network in ns, 0 if unknown
+        uint32_t flowGroup;         // source group for the snapshots, MPI_FLOW_GROUP_NONE if unknown
+        uint32_t tcpTimeouts;       // TCP sender entered loss recovery (RTO)
+        uint32_t tcpFastRetransmits; // TCP sender entered fast recovery
+        uint32_t tcpEcnReductions;  // TCP sender reduced its window on ECN echoes
     };
 
     // --- basic methods ---
@@ -46,6 +60,11 @@ class MpiFlowMonitor : public Object
         m_systemId = systemId;
     }
 
+    /// Only recorded in the outputs, sampling itself is done by the classifier
+    void SetSamplingRate(uint32_t samplingRate) {
+        m_samplingRate = samplingRate;
+    }
+
     void Start(const Time& time);
     void Stop(const Time& time);
     void StartRightNow();
@@ -59,19 +78,16 @@ class MpiFlowMonitor : public Object
         FlowPacketId packetId,
         uint32_t packetSize);
 
+    /**
+     * A packet sampled for hop tracing took `delay` ns from the moment it
+     * was sent on interface `interface` of node `nodeId` until it was seen
+     * by the next node.
+     */
     void ReportForwarding(
         Ptr<MpiFlowProbe> probe,
-        FlowId flowId,
-        FlowPacketId packetId,
-        uint32_t packetSize);
-
-    void ReportForwarding(
-        Ptr<MpiFlowProbe> probe,
-        FlowId flowId,
-        FlowPacketId packetId,
-        uint32_t packetSize,
-        uint64_t tStart,
-        uint64_t tLastRx);
+        uint32_t nodeId,
+        uint32_t interface,
+        uint64_t delay);
 
     void ReportLastRx(
         Ptr<MpiFlowProbe> probe,
@@ -79,13 +95,16 @@ class MpiFlowMonitor : public Object
         FlowPacketId packetId,
         uint32_t packetSize);
 
-    void ReportLastRx(
+    /// Returns true for the first packet of the flow received on this rank
+    bool ReportLastRx(
         Ptr<MpiFlowProbe> probe,
         FlowId flowId,
         FlowPacketId packetId,
         uint32_t packetSize,
-        uint64_t tStart,
-        uint64_t tLastRx);
+        uint64_t tStart);
+
+    /// The receiver joined a new flow with its flow file entry
+    void ReportFlowInfo(Ptr<MpiFlowProbe> probe, FlowId flowId, const MpiFlowInfo& info);
 
     void ReportDrop(
         Ptr<MpiFlowProbe> probe,
@@ -94,6 +113,21 @@ class MpiFlowMonitor : public Object
         uint32_t packetSize,
         uint32_t reasonCode); 
 
+    /**
+     * The receiver got the TCP FIN of the flow and every byte before it,
+     * retransmissions included. The flow is accounted
+     * in the FCT and throughput sketches once, and forgotten if per-flow
+     * statistics are disabled. Flows joined with their flow file entry are
+     * classified by their intended size and their slowdown is sketched too.
+     */
+    void ReportFlowFinished(Ptr<MpiFlowProbe> probe, FlowId flowId);
+
+    /**
+     * The TCP sender of a flow changed its congestion state. Entering loss,
+     * recovery and CWR is counted per flow, see MpiFlowMonitorHelper::TraceTcpSocket.
+     */
+    void ReportTcpCongState(FlowId flowId, TcpSocketState::TcpCongState_t newState);
+
     // --- methods to get the results ---
 
     typedef std::map<FlowId, FlowStats> FlowStatsContainer;
@@ -115,28 +149,76 @@ class MpiFlowMonitor : public Object
     std::string SerializeToXmlString(uint16_t indent, bool enableHistograms, bool enableProbes);
     void SerializeToXmlFile(std::string fileName, bool enableHistograms, bool enableProbes);
 
+    /**
+     * Write one fixed-width MpiFlowRecord per flow seen by this rank,
+     * see mpi-flow-record.h for the layout. Much cheaper to write and
+     * to parse than the XML output.
+     */
+    void SerializeToBinaryFile(std::string fileName);
+
+    /**
+     * Collective call: gather the flow records of all ranks on rank 0, which
+     * folds the sender and receiver halves of each flow and writes a single
+     * `<fileName>.bin` along with a `<fileName>-summary.txt` holding the flow
+     * count, FCT percentiles per size class and the long flow throughput p1.
+     * Must be called by every rank after the simulation and before MPI is
+     * disabled. Without MPI the local records are written the same way.
+     */
+    void SerializeToMergedFile(std::string fileName);
+
+    /**
+     * Collective call: sum the FCT and throughput sketches of all ranks and
+     * write the percentiles of finished flows into `<fileName>-summary.txt`
+     * on rank 0. Works with per-flow statistics disabled.
+     */
+    void SerializeSummaryToFile(std::string fileName);
+
+    /**
+     * Write the hop delay percentiles of every (node, interface) measured on
+     * this rank into `<fileName>-hops-<systemId>.csv`. Each link is measured
+     * by the node at its far end, so it appears in exactly one file.
+     */
+    void SerializeHopDelaysToFile(std::string fileName);
+
+    /**
+     * Every `interval`, append one MpiFlowSnapshot per (source group, size
+     * class) to `<fileName>-snapshots-<systemId>.bin`, with the bytes
+     * received, active and completed flows of that interval. The file is
+     * flushed after each snapshot so it can be followed during the run.
+     * Each snapshot only visits the flows that did not finish yet.
+     */
+    void EnableSnapshots(std::string fileName, Time interval);
+
     /// Reset all the statistics
     void ResetAllStats();
 
+    // --- live counters, safe to read from other threads ---
+
+    /// Flows that received their first packet on this rank
+    uint64_t GetNumStartedFlows() const {
+      return m_numStartedFlows.Get();
+    }
+
+    /// Flows that finished on this rank
+    uint64_t GetNumCompletedFlows() const {
+      return m_numCompletedFlows.Get();
+    }
+
+    /// Drops reported by the probes of this rank
+    uint64_t GetNumDrops() const {
+      return m_numDrops.Get();
+    }
+
   protected:
     void NotifyConstructionCompleted() override;
     void DoDispose() override;
 
   private:
-    /// Structure to represent a single tracked packet data
-    struct TrackedPacket
-    {
-        Time firstSeenTime;      //!< absolute time when the packet was first seen by a probe
-        Time lastSeenTime;       //!< absolute time when the packet was last seen by a probe
-    };
-
     /// FlowId --> FlowStats
     FlowStatsContainer m_flowStats;
 
-    /// (FlowId,PacketId) --> TrackedPacket
-    typedef std::map<std::pair<FlowId, FlowPacketId>, TrackedPacket> TrackedPacketMap;
-    TrackedPacketMap m_trackedPackets; //!< Tracked packets
-    Time m_maxPerHopDelay;             //!< Minimum per-hop delay
+    // note: packets are not tracked individually, the probe tag carries
+    // the first transmission time all the way to the receiver
     FlowProbeContainer m_flowProbes;   //!< all the FlowProbes
 
     // note: this is needed only for serialization
@@ -147,8 +229,48 @@ class MpiFlowMonitor : public Object
     bool m_enabled;                     //!< FlowMon is enabled
     Time m_flowInterruptionsMinTime;    //!< Flow interruptions minimum time
     uint32_t m_systemId;
+    uint32_t m_samplingRate;            //!< 1-in-N flows are monitored
+    uint32_t m_smallFlowThreshold;      //!< Flows with fewer bytes are reported as small
+    bool m_perFlowStats;                //!< Keep FlowStats of finished flows
+
+    /// Sketches of the flows that finished on this rank
+    MpiFlowSummary m_summary;
+    /// (node, interface) --> delay of the sampled packets sent on it, in ns
+    std::map<std::pair<uint32_t, uint32_t>, MpiFlowSketch> m_hopDelays;
+    /// One bit per finished flow, indexed by the systemId bits of the FlowId, then the rest
+    std::vector<std::vector<bool>> m_finishedFlows;
+
+    /// A flow that received data since the last snapshot
+    struct ActiveFlow
+    {
+        const FlowStats* stats;     //!< Into m_flowStats, removed from here before the stats
+        uint64_t rxBytes;           //!< stats->rxBytes at the last snapshot
+    };
+
+    /// (source group, size class) --> counters of the current interval
+    typedef std::map<std::pair<uint32_t, uint8_t>, MpiFlowSnapshot> SnapshotRows;
+
+    Time m_snapshotInterval;            //!< Zero when snapshots are disabled
+    EventId m_snapshotEvent;            //!< Next snapshot
+    std::ofstream m_snapshotStream;     //!< Snapshot file
+    /// FlowId --> flows that started receiving and did not finish, only with snapshots
+    std::unordered_map<FlowId, ActiveFlow> m_activeFlows;
+    /// Flows that finished since the last snapshot
+    SnapshotRows m_finishedRows;
+
+    MpiTelemetryCounter m_numStartedFlows;
+    MpiTelemetryCounter m_numCompletedFlows;
+    MpiTelemetryCounter m_numDrops;
 
     FlowStats& GetStatsForFlow(FlowId flowId);
+    MpiFlowSnapshot& GetSnapshotRow(SnapshotRows& rows, const FlowStats& stats) const;
+    void DoSnapshot();
+    void FillFlowRecord(FlowId flowId, const FlowStats& stats, MpiFlowRecord& record) const;
+    bool IsFinished(FlowId flowId) const;
+    /// False if the flow was already marked
+    bool MarkFinished(FlowId flowId);
+    /// Insert the systemId before the extension: `prefix.ext` => `prefix-<systemId>.ext`
+    std::string GetSystemFileName(std::string fileName, std::string extension) const;
 };
 
 } // namespace ns3
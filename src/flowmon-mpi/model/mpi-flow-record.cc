@@ -0,0 +1,146 @@
+#include "mpi-flow-record.h"
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("MpiFlowRecord");
+
+/// Number of records buffered before they are written to the file
+const uint32_t FLOW_RECORD_BUFFER_SIZE = 4096;
+
+MpiFlowRecordWriter::MpiFlowRecordWriter()
+    : m_numRecords(0)
+{
+}
+
+MpiFlowRecordWriter::~MpiFlowRecordWriter()
+{
+    if (m_os.is_open())
+    {
+        Close();
+    }
+}
+
+void
+MpiFlowRecordWriter::Open(const std::string& fileName, uint32_t systemId, uint32_t samplingRate)
+{
+    NS_LOG_FUNCTION(this << fileName << systemId << samplingRate);
+
+    m_os.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_IF(!m_os.is_open(), "Could not open flow record file " << fileName);
+
+    MpiFlowRecordFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MPI_FLOW_RECORD_MAGIC, sizeof(header.magic));
+    header.version = MPI_FLOW_RECORD_VERSION;
+    header.recordSize = sizeof(MpiFlowRecord);
+    header.systemId = systemId;
+    header.samplingRate = samplingRate;
+    m_os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    m_buffer.reserve(FLOW_RECORD_BUFFER_SIZE);
+    m_numRecords = 0;
+}
+
+void
+MpiFlowRecordWriter::Write(const MpiFlowRecord& record)
+{
+    m_buffer.push_back(record);
+    if (m_buffer.size() == FLOW_RECORD_BUFFER_SIZE)
+    {
+        Flush();
+    }
+}
+
+void
+MpiFlowRecordWriter::Flush()
+{
+    if (m_buffer.empty())
+    {
+        return;
+    }
+    m_os.write(reinterpret_cast<const char*>(m_buffer.data()),
+               m_buffer.size() * sizeof(MpiFlowRecord));
+    m_numRecords += m_buffer.size();
+    m_buffer.clear();
+}
+
+void
+MpiFlowRecordWriter::Close()
+{
+    NS_LOG_FUNCTION(this << m_numRecords);
+
+    Flush();
+    m_os.seekp(offsetof(MpiFlowRecordFileHeader, numRecords));
+    m_os.write(reinterpret_cast<const char*>(&m_numRecords), sizeof(m_numRecords));
+    m_os.close();
+}
+
+/// Earliest of two times where zero means never seen
+static inline int64_t
+EarliestSeen(int64_t t1, int64_t t2)
+{
+    if (t1 == 0 || t2 == 0)
+    {
+        return t1 + t2;
+    }
+    return std::min(t1, t2);
+}
+
+void
+MergeFlowRecords(std::vector<MpiFlowRecord>& records)
+{
+    std::sort(records.begin(), records.end(), [](const MpiFlowRecord& r1, const MpiFlowRecord& r2) {
+        return r1.flowId < r2.flowId;
+    });
+
+    size_t numMerged = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (numMerged == 0 || records[numMerged - 1].flowId != records[i].flowId)
+        {
+            records[numMerged++] = records[i];
+            continue;
+        }
+
+        MpiFlowRecord& into = records[numMerged - 1];
+        const MpiFlowRecord& from = records[i];
+        if (into.protocol == 0)
+        {
+            // only the classifying rank knows the five-tuple
+            into.sourceAddress = from.sourceAddress;
+            into.destinationAddress = from.destinationAddress;
+            into.sourcePort = from.sourcePort;
+            into.destinationPort = from.destinationPort;
+            into.protocol = from.protocol;
+        }
+        if (into.flowFileIndex == MPI_FLOW_FILE_INDEX_NONE)
+        {
+            // only the rank that saw the flow finish knows its flow file entry
+            into.flowFileIndex = from.flowFileIndex;
+            into.flowSize = from.flowSize;
+        }
+        into.timeFirstTxPacket = EarliestSeen(into.timeFirstTxPacket, from.timeFirstTxPacket);
+        into.timeFirstRxPacket = EarliestSeen(into.timeFirstRxPacket, from.timeFirstRxPacket);
+        into.timeLastTxPacket = std::max(into.timeLastTxPacket, from.timeLastTxPacket);
+        into.timeLastRxPacket = std::max(into.timeLastRxPacket, from.timeLastRxPacket);
+        into.txBytes += from.txBytes;
+        into.rxBytes += from.rxBytes;
+        into.packetsDropped += from.packetsDropped;
+        // only the sender counts TCP events
+        into.tcpTimeouts += from.tcpTimeouts;
+        into.tcpFastRetransmits += from.tcpFastRetransmits;
+        into.tcpEcnReductions += from.tcpEcnReductions;
+        into.bytesDropped += from.bytesDropped;
+    }
+    records.resize(numMerged);
+}
+
+} // namespace ns3
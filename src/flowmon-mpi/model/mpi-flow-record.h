@@ -0,0 +1,153 @@
+#ifndef MPI_FLOW_RECORD_H
+#define MPI_FLOW_RECORD_H
+
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/// Bumped whenever the layout of MpiFlowRecord or its file header changes
+#define MPI_FLOW_RECORD_VERSION 3
+
+/// flowFileIndex of flows that were not started from a flow file
+#define MPI_FLOW_FILE_INDEX_NONE 0xffffffff
+
+/// First eight bytes of every flow record file
+#define MPI_FLOW_RECORD_MAGIC "SWRMFLOW"
+
+/**
+ * Fixed-width flow record written by MpiFlowMonitor::SerializeToBinaryFile.
+ *
+ * Records are written in host byte order (little-endian on every machine we
+ * run on) with no padding, so a file is just a header followed by an array of
+ * these. Times are in nanoseconds and zero when the event was never seen by
+ * this rank. Since a flow is split between the sender and the receiver rank
+ * under MPI, the same flowId may show up once in each rank's file; the
+ * five-tuple is only known to the rank that classified the flow and is left
+ * zeroed elsewhere. Likewise the flow file index and size are only filled in
+ * by the rank that saw the flow finish, and the TCP event counters by the
+ * sender's rank.
+ */
+struct MpiFlowRecord
+{
+    uint32_t flowId;
+    uint32_t sourceAddress;
+    uint32_t destinationAddress;
+    uint16_t sourcePort;
+    uint16_t destinationPort;
+    uint8_t protocol;
+    uint8_t reserved[3];
+    uint32_t packetsDropped;        //!< Dropped packets, summed over all reason codes
+    int64_t timeFirstTxPacket;
+    int64_t timeFirstRxPacket;
+    int64_t timeLastTxPacket;
+    int64_t timeLastRxPacket;
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    uint64_t bytesDropped;          //!< Dropped bytes, summed over all reason codes
+    uint32_t flowFileIndex;         //!< Line of the flow in the flow file, MPI_FLOW_FILE_INDEX_NONE if unknown
+    uint32_t flowSize;              //!< Size of the flow in the flow file, 0 if unknown
+    uint32_t tcpTimeouts;           //!< Times the sender entered TCP loss recovery, i.e. RTOs
+    uint32_t tcpFastRetransmits;    //!< Times the sender entered TCP fast recovery
+    uint32_t tcpEcnReductions;      //!< Times the sender reduced its window on ECN echoes
+    uint32_t reserved2;             //!< Zero, keeps the record a multiple of 8 bytes
+};
+
+static_assert(sizeof(MpiFlowRecord) == 104, "MpiFlowRecord must stay packed, readers depend on it");
+
+/// Header at the start of every flow record file
+struct MpiFlowRecordFileHeader
+{
+    char magic[8];                  //!< MPI_FLOW_RECORD_MAGIC, not null terminated
+    uint32_t version;               //!< MPI_FLOW_RECORD_VERSION
+    uint32_t recordSize;            //!< sizeof(MpiFlowRecord)
+    uint32_t systemId;              //!< Rank that wrote the file
+    uint32_t samplingRate;          //!< 1-in-N flows were monitored, 0 in older files means 1
+    uint64_t numRecords;            //!< Patched in when the writer is closed
+};
+
+static_assert(sizeof(MpiFlowRecordFileHeader) == 32, "MpiFlowRecordFileHeader must stay packed");
+
+/// First eight bytes of every snapshot file
+#define MPI_FLOW_SNAPSHOT_MAGIC "SWRMSNAP"
+
+/// Bumped whenever the layout of MpiFlowSnapshot or its file header changes
+#define MPI_FLOW_SNAPSHOT_VERSION 1
+
+/// Snapshot group of flows that were not joined with a flow file entry
+#define MPI_FLOW_GROUP_NONE 0xffffffff
+
+/**
+ * One row of the periodic snapshots written by MpiFlowMonitor::EnableSnapshots,
+ * covering the flows of one (source group, size class) received on this rank
+ * during the interval that ends at `time`. Rows with nothing to report are
+ * not written.
+ */
+struct MpiFlowSnapshot
+{
+    int64_t time;                   //!< End of the interval, in ns
+    uint32_t group;                 //!< Source group, MPI_FLOW_GROUP_NONE if unknown
+    uint8_t sizeClass;              //!< MpiFlowSummary::SizeClass
+    uint8_t reserved[3];
+    uint64_t rxBytes;               //!< Bytes received in the interval, headers included
+    uint32_t activeFlows;           //!< Flows started and not finished at the end of the interval
+    uint32_t completedFlows;        //!< Flows that finished in the interval
+};
+
+static_assert(sizeof(MpiFlowSnapshot) == 32, "MpiFlowSnapshot must stay packed, readers depend on it");
+
+/// Header at the start of every snapshot file
+struct MpiFlowSnapshotFileHeader
+{
+    char magic[8];                  //!< MPI_FLOW_SNAPSHOT_MAGIC, not null terminated
+    uint32_t version;               //!< MPI_FLOW_SNAPSHOT_VERSION
+    uint32_t recordSize;            //!< sizeof(MpiFlowSnapshot)
+    uint32_t systemId;              //!< Rank that wrote the file
+    uint32_t samplingRate;          //!< 1-in-N flows were monitored
+    int64_t interval;               //!< Snapshot period, in ns
+};
+
+static_assert(sizeof(MpiFlowSnapshotFileHeader) == 32, "MpiFlowSnapshotFileHeader must stay packed");
+
+/**
+ * Fold the records that share a flowId, i.e. the sender and receiver halves
+ * of a flow gathered from different ranks, into a single record. Byte and drop
+ * counters are summed, first times take the earliest and last times the latest
+ * non-zero value, the tuple and flow file fields come from whichever half has
+ * them. The vector ends up sorted by flowId.
+ */
+void MergeFlowRecords(std::vector<MpiFlowRecord>& records);
+
+/**
+ * Buffered streaming writer for flow records. Records are collected in a
+ * fixed size buffer and written out in large blocks, the record count in the
+ * header is filled in by Close().
+ */
+class MpiFlowRecordWriter
+{
+  public:
+    MpiFlowRecordWriter();
+    ~MpiFlowRecordWriter();
+
+    // Delete copy constructor and assignment operator to avoid misuse
+    MpiFlowRecordWriter(const MpiFlowRecordWriter&) = delete;
+    MpiFlowRecordWriter& operator=(const MpiFlowRecordWriter&) = delete;
+
+    void Open(const std::string& fileName, uint32_t systemId, uint32_t samplingRate);
+    void Write(const MpiFlowRecord& record);
+    void Close();
+
+  private:
+    void Flush();
+
+    std::ofstream m_os;
+    std::vector<MpiFlowRecord> m_buffer;
+    uint64_t m_numRecords;
+};
+
+} // namespace ns3
+
+#endif /* MPI_FLOW_RECORD_H */
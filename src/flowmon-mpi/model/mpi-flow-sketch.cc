@@ -0,0 +1,240 @@
+#include "mpi-flow-sketch.h"
+
+#include "ns3/assert.h"
+
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+
+#include <mpi.h>
+#endif /* NS3_MPI */
+
+#include <cmath>
+
+namespace ns3
+{
+
+/// Slowdowns are sketched as integers in units of 1/SLOWDOWN_SCALE
+const uint64_t SLOWDOWN_SCALE = 1000;
+
+MpiFlowSketch::MpiFlowSketch(uint32_t subBits)
+    : m_subBits(subBits),
+      m_count(0)
+{
+}
+
+uint32_t
+MpiFlowSketch::GetBucketIndex(uint64_t value) const
+{
+    uint64_t subBuckets = 1ULL << m_subBits;
+    if (value < subBuckets)
+    {
+        return value;
+    }
+    uint32_t exponent = 63 - __builtin_clzll(value);
+    uint32_t shift = exponent - m_subBits;
+    // (value >> shift) is in [subBuckets, 2 * subBuckets), its low bits select the bucket
+    return (shift + 1) * subBuckets + ((value >> shift) - subBuckets);
+}
+
+uint64_t
+MpiFlowSketch::GetBucketValue(uint32_t index) const
+{
+    uint64_t subBuckets = 1ULL << m_subBits;
+    if (index < subBuckets)
+    {
+        return index;
+    }
+    uint32_t shift = index / subBuckets - 1;
+    uint64_t low = (subBuckets + index % subBuckets) << shift;
+    // middle of the bucket
+    return low + ((1ULL << shift) >> 1);
+}
+
+void
+MpiFlowSketch::Add(uint64_t value)
+{
+    uint32_t index = GetBucketIndex(value);
+    if (index >= m_buckets.size())
+    {
+        m_buckets.resize(index + 1, 0);
+    }
+    ++m_buckets[index];
+    ++m_count;
+}
+
+void
+MpiFlowSketch::Merge(const MpiFlowSketch& other)
+{
+    NS_ASSERT_MSG(m_subBits == other.m_subBits, "Can not merge sketches of different precision");
+    if (other.m_buckets.size() > m_buckets.size())
+    {
+        m_buckets.resize(other.m_buckets.size(), 0);
+    }
+    for (uint32_t i = 0; i < other.m_buckets.size(); i++)
+    {
+        m_buckets[i] += other.m_buckets[i];
+    }
+    m_count += other.m_count;
+}
+
+void
+MpiFlowSketch::Reset()
+{
+    m_buckets.clear();
+    m_count = 0;
+}
+
+std::vector<uint64_t>&
+MpiFlowSketch::GetBuckets()
+{
+    // one block of exact values, then one block per power of two above
+    m_buckets.resize((64 - m_subBits + 1) << m_subBits, 0);
+    return m_buckets;
+}
+
+void
+MpiFlowSketch::UpdateCount()
+{
+    m_count = 0;
+    for (uint32_t i = 0; i < m_buckets.size(); i++)
+    {
+        m_count += m_buckets[i];
+    }
+}
+
+uint64_t
+MpiFlowSketch::GetPercentile(double percentile) const
+{
+    if (m_count == 0)
+    {
+        return 0;
+    }
+
+    // nearest rank
+    uint64_t rank = std::ceil(percentile / 100.0 * m_count);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < m_buckets.size(); i++)
+    {
+        seen += m_buckets[i];
+        if (seen >= rank)
+        {
+            return GetBucketValue(i);
+        }
+    }
+    return GetBucketValue(m_buckets.size() - 1);
+}
+
+MpiFlowSummary::MpiFlowSummary()
+    : m_smallFlowThreshold(150 * 1024)
+{
+}
+
+void
+MpiFlowSummary::AddFlow(uint64_t bytes, int64_t fct, int64_t idealFct)
+{
+    if (fct <= 0)
+    {
+        return;
+    }
+
+    SizeClass sizeClass = bytes < m_smallFlowThreshold ? SMALL_FLOWS : LARGE_FLOWS;
+    m_fcts[sizeClass].Add(fct);
+    m_throughputs[sizeClass].Add(bytes * 8 * 1e9 / fct);
+    if (idealFct > 0)
+    {
+        m_slowdowns[sizeClass].Add(fct * SLOWDOWN_SCALE / idealFct);
+    }
+}
+
+void
+MpiFlowSummary::Merge(const MpiFlowSummary& other)
+{
+    for (uint32_t i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+        m_fcts[i].Merge(other.m_fcts[i]);
+        m_throughputs[i].Merge(other.m_throughputs[i]);
+        m_slowdowns[i].Merge(other.m_slowdowns[i]);
+    }
+}
+
+void
+MpiFlowSummary::Reset()
+{
+    for (uint32_t i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+        m_fcts[i].Reset();
+        m_throughputs[i].Reset();
+        m_slowdowns[i].Reset();
+    }
+}
+
+void
+MpiFlowSummary::Reduce()
+{
+#ifdef NS3_MPI
+    if (!MpiInterface::IsEnabled() || MpiInterface::GetSize() < 2)
+    {
+        return;
+    }
+
+    MPI_Comm comm = MpiInterface::GetCommunicator();
+    bool root = MpiInterface::GetSystemId() == 0;
+
+    MpiFlowSketch* sketches[] = {&m_fcts[SMALL_FLOWS],
+                                 &m_fcts[LARGE_FLOWS],
+                                 &m_throughputs[SMALL_FLOWS],
+                                 &m_throughputs[LARGE_FLOWS],
+                                 &m_slowdowns[SMALL_FLOWS],
+                                 &m_slowdowns[LARGE_FLOWS]};
+    for (MpiFlowSketch* sketch : sketches)
+    {
+        std::vector<uint64_t>& buckets = sketch->GetBuckets();
+        MPI_Reduce(root ? MPI_IN_PLACE : buckets.data(),
+                   buckets.data(),
+                   buckets.size(),
+                   MPI_UINT64_T,
+                   MPI_SUM,
+                   0,
+                   comm);
+        sketch->UpdateCount();
+    }
+#endif /* NS3_MPI */
+}
+
+uint64_t
+MpiFlowSummary::GetNumCompleted() const
+{
+    return m_fcts[SMALL_FLOWS].GetCount() + m_fcts[LARGE_FLOWS].GetCount();
+}
+
+void
+MpiFlowSummary::Write(std::ostream& os) const
+{
+    const char* names[NUM_SIZE_CLASSES] = {"small", "large"};
+
+    os << "completed " << GetNumCompleted() << "\n";
+    os << "smallFlowThreshold " << m_smallFlowThreshold << "\n";
+    for (uint32_t i = 0; i < NUM_SIZE_CLASSES; i++)
+    {
+        os << names[i] << ".count " << m_fcts[i].GetCount() << "\n";
+        os << names[i] << ".fct.p50 " << m_fcts[i].GetPercentile(50) / 1e3 << " us\n";
+        os << names[i] << ".fct.p99 " << m_fcts[i].GetPercentile(99) / 1e3 << " us\n";
+        os << names[i] << ".fct.p999 " << m_fcts[i].GetPercentile(99.9) / 1e3 << " us\n";
+        os << names[i] << ".throughput.p1 " << m_throughputs[i].GetPercentile(1) << " bps\n";
+        if (m_slowdowns[i].GetCount())
+        {
+            double scale = SLOWDOWN_SCALE;
+            os << names[i] << ".slowdown.count " << m_slowdowns[i].GetCount() << "\n";
+            os << names[i] << ".slowdown.p50 " << m_slowdowns[i].GetPercentile(50) / scale << "\n";
+            os << names[i] << ".slowdown.p99 " << m_slowdowns[i].GetPercentile(99) / scale << "\n";
+            os << names[i] << ".slowdown.p999 " << m_slowdowns[i].GetPercentile(99.9) / scale << "\n";
+        }
+    }
+}
+
+} // namespace ns3
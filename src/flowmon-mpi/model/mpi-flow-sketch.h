@@ -0,0 +1,101 @@
+#ifndef MPI_FLOW_SKETCH_H
+#define MPI_FLOW_SKETCH_H
+
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3
+{
+
+/// Default precision: each power of two is split into 2^MPI_FLOW_SKETCH_SUB_BITS linear buckets
+#define MPI_FLOW_SKETCH_SUB_BITS 7
+
+/**
+ * Log-linear histogram of unsigned integers, in the spirit of HDR histograms.
+ *
+ * Values below 2^subBits are counted exactly, larger ones fall in one of
+ * 2^subBits buckets per power of two, so any reported percentile is within
+ * 2^-subBits (< 1% by default) of the real value. Buckets are only allocated
+ * up to the largest value seen, and two sketches with the same precision are
+ * merged by adding their counts, across ranks too.
+ */
+class MpiFlowSketch
+{
+  public:
+    explicit MpiFlowSketch(uint32_t subBits = MPI_FLOW_SKETCH_SUB_BITS);
+
+    void Add(uint64_t value);
+    void Merge(const MpiFlowSketch& other);
+    void Reset();
+
+    uint64_t GetCount() const {
+      return m_count;
+    }
+
+    /// Value at the given percentile (0-100), 0 if the sketch is empty
+    uint64_t GetPercentile(double percentile) const;
+
+    /// Bucket counts grown to their full size, so that they line up for reductions over MPI
+    std::vector<uint64_t>& GetBuckets();
+
+    /// Recompute the total count after the buckets were changed in place
+    void UpdateCount();
+
+  private:
+    uint32_t GetBucketIndex(uint64_t value) const;
+    uint64_t GetBucketValue(uint32_t index) const;
+
+    uint32_t m_subBits;
+    std::vector<uint64_t> m_buckets;
+    uint64_t m_count;
+};
+
+/**
+ * FCT, throughput and slowdown sketches of completed flows, split into small
+ * and large flows by their size.
+ */
+class MpiFlowSummary
+{
+  public:
+    enum SizeClass
+    {
+        SMALL_FLOWS = 0,
+        LARGE_FLOWS,
+        NUM_SIZE_CLASSES
+    };
+
+    MpiFlowSummary();
+
+    void SetSmallFlowThreshold(uint32_t bytes) {
+      m_smallFlowThreshold = bytes;
+    }
+
+    /**
+     * Account a completed flow of `bytes` bytes that took `fct` nanoseconds.
+     * Its slowdown is only recorded when the ideal FCT is known.
+     */
+    void AddFlow(uint64_t bytes, int64_t fct, int64_t idealFct = 0);
+    void Merge(const MpiFlowSummary& other);
+    void Reset();
+
+    /**
+     * Collective call: sum the sketches of all ranks into the ones of rank 0.
+     * Other ranks are left with partial sums. Does nothing without MPI.
+     */
+    void Reduce();
+
+    uint64_t GetNumCompleted() const;
+
+    void Write(std::ostream& os) const;
+
+  private:
+    uint32_t m_smallFlowThreshold;
+    MpiFlowSketch m_fcts[NUM_SIZE_CLASSES];         //!< Flow completion times in ns
+    MpiFlowSketch m_throughputs[NUM_SIZE_CLASSES];  //!< Average throughputs in bps
+    MpiFlowSketch m_slowdowns[NUM_SIZE_CLASSES];    //!< FCT over ideal FCT, in thousandths
+};
+
+} // namespace ns3
+
+#endif /* MPI_FLOW_SKETCH_H */
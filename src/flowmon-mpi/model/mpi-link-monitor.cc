@@ -0,0 +1,369 @@
+#include "mpi-link-monitor.h"
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include "ns3/traffic-control-layer.h"
+
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+
+#include <mpi.h>
+#endif /* NS3_MPI */
+
+#include <algorithm>
+#include <cstring>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("MpiLinkMonitor");
+
+NS_OBJECT_ENSURE_REGISTERED(MpiLinkMonitor);
+
+TypeId
+MpiLinkMonitor::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::MpiLinkMonitor")
+            .SetParent<Object>()
+            .SetGroupName("MpiFlowMonitor")
+            .AddConstructor<MpiLinkMonitor>()
+            .AddAttribute("SampleInterval",
+                          ("Time between two samples of the queue lengths."),
+                          TimeValue(MicroSeconds(10)),
+                          MakeTimeAccessor(&MpiLinkMonitor::m_sampleInterval),
+                          MakeTimeChecker())
+            .AddAttribute("ReportInterval",
+                          ("Time covered by one row of statistics, rounded to a multiple of "
+                           "the sample interval."),
+                          TimeValue(MilliSeconds(1)),
+                          MakeTimeAccessor(&MpiLinkMonitor::m_reportInterval),
+                          MakeTimeChecker());
+    return tid;
+}
+
+MpiLinkMonitor::MpiLinkMonitor()
+    : m_samplesPerReport(0),
+      m_samples(0),
+      m_systemId(0)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+MpiLinkMonitor::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Simulator::Cancel(m_sampleEvent);
+    if (m_os.is_open())
+    {
+        m_os.close();
+    }
+    m_queues.clear();
+    m_ipv4Nodes.clear();
+    m_ipv4NodeHooks.clear();
+    Object::DoDispose();
+}
+
+void
+MpiLinkMonitor::AddQueueDisc(Ptr<QueueDisc> qdisc, std::string name)
+{
+    NS_LOG_FUNCTION(this << qdisc << name);
+    NS_ABORT_MSG_IF(m_os.is_open(), "Queue discs must be added before the link monitor starts");
+
+    const QueueDisc::Stats& stats = qdisc->GetStats();
+    m_queues.push_back(Queue{qdisc, name, 0, 0, stats.nTotalMarkedPackets, stats.nTotalDroppedPackets});
+}
+
+void
+MpiLinkMonitor::Start(std::string fileName)
+{
+    NS_LOG_FUNCTION(this << fileName);
+    NS_ABORT_MSG_IF(!m_sampleInterval.IsStrictlyPositive(), "Sample interval must be positive");
+
+    m_samplesPerReport = std::max<int64_t>(1, m_reportInterval.GetInteger() / m_sampleInterval.GetInteger());
+    m_samples = 0;
+    m_row.resize(m_queues.size());
+
+    std::string prefix = fileName + "-links-" + std::to_string(m_systemId);
+
+    std::ofstream names(prefix + ".csv", std::ios::out);
+    names << "column,name\n";
+    for (uint32_t i = 0; i < m_queues.size(); i++)
+    {
+        names << i << "," << m_queues[i].name << "\n";
+    }
+    names.close();
+
+    m_os.open(prefix + ".bin", std::ios::out | std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_IF(!m_os.is_open(), "Could not open link statistics file " << prefix << ".bin");
+
+    MpiLinkStatsFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MPI_LINK_STATS_MAGIC, sizeof(header.magic));
+    header.version = MPI_LINK_STATS_VERSION;
+    header.recordSize = sizeof(MpiLinkStats);
+    header.systemId = m_systemId;
+    header.numQueues = m_queues.size();
+    header.sampleInterval = m_sampleInterval.GetNanoSeconds();
+    header.reportInterval = (m_sampleInterval * m_samplesPerReport).GetNanoSeconds();
+    header.startTime = Simulator::Now().GetNanoSeconds();
+    m_os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    Simulator::Cancel(m_sampleEvent);
+    m_sampleEvent = Simulator::Schedule(m_sampleInterval, &MpiLinkMonitor::Sample, this);
+}
+
+void
+MpiLinkMonitor::Stop()
+{
+    NS_LOG_FUNCTION(this);
+    Simulator::Cancel(m_sampleEvent);
+    if (m_os.is_open())
+    {
+        if (m_samples)
+        {
+            Report();
+        }
+        m_os.close();
+    }
+}
+
+void
+MpiLinkMonitor::Sample()
+{
+    for (auto& queue : m_queues)
+    {
+        uint32_t packets = queue.qdisc->GetNPackets();
+        queue.sumPackets += packets;
+        queue.maxPackets = std::max(queue.maxPackets, packets);
+    }
+
+    if (++m_samples == m_samplesPerReport)
+    {
+        Report();
+    }
+    m_sampleEvent = Simulator::Schedule(m_sampleInterval, &MpiLinkMonitor::Sample, this);
+}
+
+void
+MpiLinkMonitor::Report()
+{
+    NS_LOG_FUNCTION(this << m_samples);
+
+    for (uint32_t i = 0; i < m_queues.size(); i++)
+    {
+        Queue& queue = m_queues[i];
+        const QueueDisc::Stats& stats = queue.qdisc->GetStats();
+
+        MpiLinkStats& cell = m_row[i];
+        cell.meanPackets = static_cast<float>(queue.sumPackets) / m_samples;
+        cell.maxPackets = queue.maxPackets;
+        cell.markedPackets = stats.nTotalMarkedPackets - queue.lastMarked;
+        cell.droppedPackets = stats.nTotalDroppedPackets - queue.lastDropped;
+
+        queue.sumPackets = 0;
+        queue.maxPackets = 0;
+        queue.lastMarked = stats.nTotalMarkedPackets;
+        queue.lastDropped = stats.nTotalDroppedPackets;
+    }
+    m_samples = 0;
+
+    m_os.write(reinterpret_cast<const char*>(m_row.data()), m_row.size() * sizeof(MpiLinkStats));
+}
+
+void
+MpiLinkMonitor::AddLink(Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, std::string name)
+{
+    NS_LOG_FUNCTION(this << txDevice << rxDevice << name);
+
+    uint32_t link = m_linkNames.size();
+    m_linkNames.push_back(name);
+    m_drops.resize(m_linkNames.size() * NUM_DROP_REASONS, 0);
+
+    Ptr<Node> txNode = txDevice->GetNode();
+    if (txNode->GetSystemId() == m_systemId)
+    {
+        Ptr<TrafficControlLayer> tc = txNode->GetObject<TrafficControlLayer>();
+        Ptr<QueueDisc> qdisc = tc ? tc->GetRootQueueDiscOnDevice(txDevice) : nullptr;
+        if (qdisc)
+        {
+            qdisc->TraceConnectWithoutContext(
+                "Drop",
+                MakeBoundCallback(&MpiLinkMonitor::QueueDiscDropLogger, Ptr<MpiLinkMonitor>(this), link));
+        }
+
+        PointerValue txQueue;
+        if (txDevice->GetAttributeFailSafe("TxQueue", txQueue) && txQueue.GetObject())
+        {
+            txQueue.GetObject()->TraceConnectWithoutContext(
+                "Drop",
+                MakeBoundCallback(&MpiLinkMonitor::DeviceQueueDropLogger, Ptr<MpiLinkMonitor>(this), link));
+        }
+    }
+
+    Ptr<Node> rxNode = rxDevice->GetNode();
+    if (rxNode->GetSystemId() == m_systemId)
+    {
+        rxDevice->TraceConnectWithoutContext(
+            "PhyRxDrop",
+            MakeBoundCallback(&MpiLinkMonitor::PhyRxDropLogger, Ptr<MpiLinkMonitor>(this), link));
+
+        Ptr<Ipv4L3Protocol> ipv4 = rxNode->GetObject<Ipv4L3Protocol>();
+        int32_t interface = ipv4 ? ipv4->GetInterfaceForDevice(rxDevice) : -1;
+        if (interface >= 0)
+        {
+            // one IPv4 rx and drop trace per node, the rx trace remembers the
+            // arrival link of the packet that a forwarding drop refers to
+            auto inserted = m_ipv4Nodes.try_emplace(rxNode->GetId(), m_ipv4NodeHooks.size());
+            if (inserted.second)
+            {
+                m_ipv4NodeHooks.push_back({{}, UINT64_MAX, UINT32_MAX});
+                ipv4->TraceConnectWithoutContext(
+                    "Rx",
+                    MakeBoundCallback(&MpiLinkMonitor::Ipv4RxLogger,
+                                      Ptr<MpiLinkMonitor>(this),
+                                      inserted.first->second));
+                ipv4->TraceConnectWithoutContext(
+                    "Drop",
+                    MakeBoundCallback(&MpiLinkMonitor::Ipv4DropLogger,
+                                      Ptr<MpiLinkMonitor>(this),
+                                      inserted.first->second));
+            }
+
+            std::vector<uint32_t>& links = m_ipv4NodeHooks[inserted.first->second].interfaceLinks;
+            if (links.size() <= static_cast<uint32_t>(interface))
+            {
+                links.resize(interface + 1, UINT32_MAX);
+            }
+            links[interface] = link;
+        }
+    }
+}
+
+void
+MpiLinkMonitor::QueueDiscDropLogger(Ptr<MpiLinkMonitor> monitor, uint32_t link, Ptr<const QueueDiscItem> item)
+{
+    monitor->CountDrop(link, DROP_QUEUE_DISC);
+}
+
+void
+MpiLinkMonitor::DeviceQueueDropLogger(Ptr<MpiLinkMonitor> monitor, uint32_t link, Ptr<const Packet> packet)
+{
+    monitor->CountDrop(link, DROP_DEVICE_QUEUE);
+}
+
+void
+MpiLinkMonitor::PhyRxDropLogger(Ptr<MpiLinkMonitor> monitor, uint32_t link, Ptr<const Packet> packet)
+{
+    monitor->CountDrop(link, DROP_PHY_RX);
+}
+
+void
+MpiLinkMonitor::Ipv4RxLogger(Ptr<MpiLinkMonitor> monitor,
+                             uint32_t node,
+                             Ptr<const Packet> packet,
+                             Ptr<Ipv4> ipv4,
+                             uint32_t interface)
+{
+    Ipv4Node& hook = monitor->m_ipv4NodeHooks[node];
+    hook.lastRxUid = packet->GetUid();
+    hook.lastRxLink = interface < hook.interfaceLinks.size() ? hook.interfaceLinks[interface] : UINT32_MAX;
+}
+
+void
+MpiLinkMonitor::Ipv4DropLogger(Ptr<MpiLinkMonitor> monitor,
+                               uint32_t node,
+                               const Ipv4Header& ipHeader,
+                               Ptr<const Packet> ipPayload,
+                               Ipv4L3Protocol::DropReason reason,
+                               Ptr<Ipv4> ipv4,
+                               uint32_t ifIndex)
+{
+    // Only interface down drops report the arrival interface, they happen
+    // before the rx trace. TTL drops report the output interface and route
+    // errors report 0, but both happen within the receive of the same packet,
+    // so it is matched against the last rx instead.
+    const Ipv4Node& hook = monitor->m_ipv4NodeHooks[node];
+    uint32_t link = UINT32_MAX;
+    if (reason == Ipv4L3Protocol::DROP_INTERFACE_DOWN)
+    {
+        if (ifIndex < hook.interfaceLinks.size())
+        {
+            link = hook.interfaceLinks[ifIndex];
+        }
+    }
+    else if (ipPayload->GetUid() == hook.lastRxUid)
+    {
+        link = hook.lastRxLink;
+    }
+    if (link == UINT32_MAX)
+    {
+        // not over a monitored link, e.g. sent by the node itself
+        return;
+    }
+
+    DropReason dropReason;
+    switch (reason)
+    {
+    case Ipv4L3Protocol::DROP_TTL_EXPIRED:
+        dropReason = DROP_TTL_EXPIRED;
+        break;
+    case Ipv4L3Protocol::DROP_ROUTE_ERROR:
+        // RouteInput found no route for a packet to forward
+    case Ipv4L3Protocol::DROP_NO_ROUTE:
+        dropReason = DROP_NO_ROUTE;
+        break;
+    case Ipv4L3Protocol::DROP_INTERFACE_DOWN:
+        dropReason = DROP_INTERFACE_DOWN;
+        break;
+    default:
+        dropReason = DROP_OTHER;
+        break;
+    }
+    monitor->CountDrop(link, dropReason);
+}
+
+void
+MpiLinkMonitor::SerializeDropsToFile(std::string fileName)
+{
+    NS_LOG_FUNCTION(this << fileName);
+
+    bool root = true;
+#ifdef NS3_MPI
+    if (MpiInterface::IsEnabled() && MpiInterface::GetSize() > 1)
+    {
+        root = MpiInterface::GetSystemId() == 0;
+        MPI_Reduce(root ? MPI_IN_PLACE : m_drops.data(),
+                   m_drops.data(),
+                   m_drops.size(),
+                   MPI_UINT64_T,
+                   MPI_SUM,
+                   0,
+                   MpiInterface::GetCommunicator());
+    }
+#endif /* NS3_MPI */
+
+    if (!root)
+    {
+        return;
+    }
+
+    std::ofstream os(fileName + "-drops.csv", std::ios::out);
+    os << "link,queueDisc,deviceQueue,phyRx,ttlExpired,noRoute,interfaceDown,other\n";
+    for (uint32_t link = 0; link < m_linkNames.size(); link++)
+    {
+        os << m_linkNames[link];
+        for (uint32_t reason = 0; reason < NUM_DROP_REASONS; reason++)
+        {
+            os << "," << m_drops[link * NUM_DROP_REASONS + reason];
+        }
+        os << "\n";
+    }
+    os.close();
+}
+
+} // namespace ns3
@@ -0,0 +1,208 @@
+#ifndef MPI_LINK_MONITOR_H
+#define MPI_LINK_MONITOR_H
+
+#include "mpi-telemetry-exporter.h"
+
+#include "ns3/event-id.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/net-device.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+#include "ns3/queue-disc.h"
+
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+/// First eight bytes of every link statistics file
+#define MPI_LINK_STATS_MAGIC "SWRMLINK"
+
+/// Bumped whenever the layout of MpiLinkStats or its file header changes
+#define MPI_LINK_STATS_VERSION 1
+
+/**
+ * Statistics of one queue disc over one report interval. A report is a row
+ * of these, one per queue in the order they were added, so the whole file is
+ * a dense (reports x queues) matrix.
+ */
+struct MpiLinkStats
+{
+    float meanPackets;              //!< Mean queue length over the samples of the interval
+    uint32_t maxPackets;            //!< Largest sampled queue length
+    uint32_t markedPackets;         //!< Packets marked (ECN) in the interval
+    uint32_t droppedPackets;        //!< Packets dropped in the interval
+};
+
+static_assert(sizeof(MpiLinkStats) == 16, "MpiLinkStats must stay packed, readers depend on it");
+
+/// Header at the start of every link statistics file
+struct MpiLinkStatsFileHeader
+{
+    char magic[8];                  //!< MPI_LINK_STATS_MAGIC, not null terminated
+    uint32_t version;               //!< MPI_LINK_STATS_VERSION
+    uint32_t recordSize;            //!< sizeof(MpiLinkStats)
+    uint32_t systemId;              //!< Rank that wrote the file
+    uint32_t numQueues;             //!< Columns of the matrix
+    int64_t sampleInterval;         //!< Time between two queue length samples, in ns
+    int64_t reportInterval;         //!< Time covered by one row, in ns
+    int64_t startTime;              //!< Row k covers [startTime + k * reportInterval, +reportInterval), in ns
+};
+
+static_assert(sizeof(MpiLinkStatsFileHeader) == 48, "MpiLinkStatsFileHeader must stay packed");
+
+/**
+ * Periodic queue telemetry for a set of queue discs.
+ *
+ * A single event samples the length of every queue each SampleInterval, and
+ * every ReportInterval one row with the mean and max length and the marks and
+ * drops of each queue since the previous row is appended to
+ * `<fileName>-links-<systemId>.bin`. Marks and drops are read from the queue
+ * disc counters, so no trace is connected. The names of the columns go into
+ * `<fileName>-links-<systemId>.csv`.
+ *
+ * Under MPI each rank should only add the queue discs of its own nodes.
+ *
+ * Separately, drops are counted per (link direction, reason) in one flat
+ * array, see AddLink.
+ */
+class MpiLinkMonitor : public Object
+{
+  public:
+    /// Where a packet was lost, the columns of the drop matrix
+    enum DropReason
+    {
+        DROP_QUEUE_DISC = 0,    //!< Root queue disc of the sender, e.g. RED
+        DROP_DEVICE_QUEUE,      //!< Transmit queue of the sending device
+        DROP_PHY_RX,            //!< Lost on the wire, e.g. by the receiver's error model
+        DROP_TTL_EXPIRED,       //!< Dropped by IPv4 on the receiver, TTL expired
+        DROP_NO_ROUTE,          //!< Dropped by IPv4 on the receiver, no route
+        DROP_INTERFACE_DOWN,    //!< Dropped by IPv4 on the receiver, interface down
+        DROP_OTHER,             //!< Dropped by IPv4 on the receiver, any other reason
+        NUM_DROP_REASONS
+    };
+
+    static TypeId GetTypeId();
+    MpiLinkMonitor();
+
+    void SetSystemId(uint32_t systemId) {
+      m_systemId = systemId;
+    }
+
+    /// Add a queue disc as the next column, `name` describes it in the CSV
+    void AddQueueDisc(Ptr<QueueDisc> qdisc, std::string name);
+
+    uint32_t GetNQueueDiscs() const {
+      return m_queues.size();
+    }
+
+    /// Open the output files and start sampling, no queue can be added afterwards
+    void Start(std::string fileName);
+
+    /// Write the row in progress and stop sampling
+    void Stop();
+
+    /**
+     * Count the drops of the direction of a link that `txDevice` sends on and
+     * `rxDevice` receives from. Queue drops are hooked on the sender, wire
+     * losses and IPv4 drops of packets that arrived over the link on the
+     * receiver, each only if its node belongs to this rank. Every rank should
+     * add the same links in the same order, so that the counters line up
+     * for SerializeDropsToFile.
+     */
+    void AddLink(Ptr<NetDevice> txDevice, Ptr<NetDevice> rxDevice, std::string name);
+
+    uint32_t GetNLinks() const {
+      return m_linkNames.size();
+    }
+
+    uint64_t GetDrops(uint32_t link, DropReason reason) const {
+      return m_drops[link * NUM_DROP_REASONS + reason];
+    }
+
+    /// Drops counted on all links by this rank, safe to read from other threads
+    uint64_t GetNumDrops() const {
+      return m_numDrops.Get();
+    }
+
+    /**
+     * Collective call: sum the drop counters of all ranks and write them into
+     * `<fileName>-drops.csv` on rank 0, one row per link direction and one
+     * column per reason. Without MPI the local counters are written.
+     */
+    void SerializeDropsToFile(std::string fileName);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /// A monitored queue and its running counters for the current row
+    struct Queue
+    {
+        Ptr<QueueDisc> qdisc;
+        std::string name;
+        uint64_t sumPackets;        //!< Sum of the sampled lengths of this row
+        uint32_t maxPackets;        //!< Max of the sampled lengths of this row
+        uint32_t lastMarked;        //!< Total marks when the row started
+        uint32_t lastDropped;       //!< Total drops when the row started
+    };
+
+    void Sample();
+    void Report();
+
+    static void QueueDiscDropLogger(Ptr<MpiLinkMonitor> monitor, uint32_t link, Ptr<const QueueDiscItem> item);
+    static void DeviceQueueDropLogger(Ptr<MpiLinkMonitor> monitor, uint32_t link, Ptr<const Packet> packet);
+    static void PhyRxDropLogger(Ptr<MpiLinkMonitor> monitor, uint32_t link, Ptr<const Packet> packet);
+    static void Ipv4RxLogger(Ptr<MpiLinkMonitor> monitor,
+                             uint32_t node,
+                             Ptr<const Packet> packet,
+                             Ptr<Ipv4> ipv4,
+                             uint32_t interface);
+    static void Ipv4DropLogger(Ptr<MpiLinkMonitor> monitor,
+                               uint32_t node,
+                               const Ipv4Header& ipHeader,
+                               Ptr<const Packet> ipPayload,
+                               Ipv4L3Protocol::DropReason reason,
+                               Ptr<Ipv4> ipv4,
+                               uint32_t ifIndex);
+
+    void CountDrop(uint32_t link, DropReason reason) {
+      m_drops[link * NUM_DROP_REASONS + reason]++;
+      m_numDrops.Increment();
+    }
+
+    std::vector<Queue> m_queues;
+    std::vector<MpiLinkStats> m_row;    //!< Reused buffer for the rows
+    Time m_sampleInterval;
+    Time m_reportInterval;
+    uint32_t m_samplesPerReport;
+    uint32_t m_samples;                 //!< Samples taken for the current row
+    uint32_t m_systemId;
+    EventId m_sampleEvent;
+    std::ofstream m_os;
+
+    std::vector<std::string> m_linkNames;
+    /// (link * NUM_DROP_REASONS + reason) --> dropped packets
+    std::vector<uint64_t> m_drops;
+    MpiTelemetryCounter m_numDrops;     //!< Sum of m_drops
+    /// A node with hooked IPv4 rx and drop traces
+    struct Ipv4Node
+    {
+        std::vector<uint32_t> interfaceLinks;   //!< Interface index --> monitored link
+        uint64_t lastRxUid;                     //!< Uid of the packet IPv4 received last
+        uint32_t lastRxLink;                    //!< The link it arrived over, or UINT32_MAX
+    };
+
+    /// nodeId --> index in m_ipv4NodeHooks
+    std::unordered_map<uint32_t, uint32_t> m_ipv4Nodes;
+    std::vector<Ipv4Node> m_ipv4NodeHooks;
+};
+
+} // namespace ns3
+
+#endif /* MPI_LINK_MONITOR_H */
@@ -0,0 +1,95 @@
+#include "mpi-reachability-matrix.h"
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+
+#include <mpi.h>
+#endif /* NS3_MPI */
+
+#include <fstream>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("MpiReachabilityMatrix");
+
+NS_OBJECT_ENSURE_REGISTERED(MpiReachabilityMatrix);
+
+TypeId
+MpiReachabilityMatrix::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::MpiReachabilityMatrix")
+            .SetParent<Object>()
+            .SetGroupName("MpiFlowMonitor")
+            .AddConstructor<MpiReachabilityMatrix>();
+    return tid;
+}
+
+MpiReachabilityMatrix::MpiReachabilityMatrix()
+    : m_numHosts(0)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+MpiReachabilityMatrix::SetNumHosts(uint32_t numHosts)
+{
+    NS_LOG_FUNCTION(this << numHosts);
+    m_numHosts = numHosts;
+    m_rtts.assign(static_cast<uint64_t>(numHosts) * numHosts, -1);
+}
+
+void
+MpiReachabilityMatrix::RttLogger(Ptr<MpiReachabilityMatrix> matrix, uint32_t src, uint32_t dst, Time rtt)
+{
+    matrix->RecordRtt(src, dst, rtt);
+}
+
+uint64_t
+MpiReachabilityMatrix::SerializeToFile(std::string fileName)
+{
+    NS_LOG_FUNCTION(this << fileName);
+
+    bool root = true;
+#ifdef NS3_MPI
+    if (MpiInterface::IsEnabled() && MpiInterface::GetSize() > 1)
+    {
+        root = MpiInterface::GetSystemId() == 0;
+        MPI_Reduce(root ? MPI_IN_PLACE : m_rtts.data(),
+                   m_rtts.data(),
+                   m_rtts.size(),
+                   MPI_INT64_T,
+                   MPI_MAX,
+                   0,
+                   MpiInterface::GetCommunicator());
+    }
+#endif /* NS3_MPI */
+
+    if (!root)
+    {
+        return 0;
+    }
+
+    uint64_t unreachable = 0;
+    std::ofstream os(fileName + "-pingall.csv", std::ios::out);
+    NS_ABORT_MSG_IF(!os.is_open(), "Could not open " << fileName << "-pingall.csv");
+    for (uint32_t src = 0; src < m_numHosts; src++)
+    {
+        for (uint32_t dst = 0; dst < m_numHosts; dst++)
+        {
+            int64_t rtt = src == dst ? 0 : m_rtts[static_cast<uint64_t>(src) * m_numHosts + dst];
+            unreachable += rtt < 0;
+            os << (dst ? "," : "") << rtt;
+        }
+        os << "\n";
+    }
+    os.close();
+
+    return unreachable;
+}
+
+} // namespace ns3
@@ -0,0 +1,61 @@
+#ifndef MPI_REACHABILITY_MATRIX_H
+#define MPI_REACHABILITY_MATRIX_H
+
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/**
+ * Dense (hosts x hosts) matrix of RTTs between hosts, e.g. measured by a
+ * ProberApplication on every host. Each rank records the rows of its own
+ * hosts, rank 0 gathers the rest with SerializeToFile.
+ *
+ * Cells hold the RTT in ns, -1 when no reply was recorded, so gathering is a
+ * single MPI_Reduce with MAX. This costs 8 bytes per pair on every rank,
+ * 8 MB for 1k hosts.
+ */
+class MpiReachabilityMatrix : public Object
+{
+  public:
+    static TypeId GetTypeId();
+    MpiReachabilityMatrix();
+
+    /// Clear the matrix and size it for `numHosts` hosts
+    void SetNumHosts(uint32_t numHosts);
+
+    uint32_t GetNumHosts() const {
+      return m_numHosts;
+    }
+
+    /// `src` got the reply of `dst` after `rtt`
+    void RecordRtt(uint32_t src, uint32_t dst, Time rtt) {
+      m_rtts[static_cast<uint64_t>(src) * m_numHosts + dst] = rtt.GetNanoSeconds();
+    }
+
+    /// Bound to the Rtt trace of the prober of host `src`
+    static void RttLogger(Ptr<MpiReachabilityMatrix> matrix, uint32_t src, uint32_t dst, Time rtt);
+
+    /**
+     * Collective call: gather the rows of all ranks and write the matrix
+     * into `<fileName>-pingall.csv` on rank 0, one line per source host with
+     * the RTT in ns to each destination, -1 if it did not reply and 0 on the
+     * diagonal. Without MPI the local matrix is written. Returns the number
+     * of pairs without a reply on rank 0, 0 elsewhere.
+     */
+    uint64_t SerializeToFile(std::string fileName);
+
+  private:
+    uint32_t m_numHosts;
+    /// (src * m_numHosts + dst) --> RTT in ns, -1 if none
+    std::vector<int64_t> m_rtts;
+};
+
+} // namespace ns3
+
+#endif /* MPI_REACHABILITY_MATRIX_H */
@@ -0,0 +1,211 @@
+#include "mpi-telemetry-exporter.h"
+
+#include "mpi-flow-monitor.h"
+#include "mpi-link-monitor.h"
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("MpiTelemetryExporter");
+
+NS_OBJECT_ENSURE_REGISTERED(MpiTelemetryExporter);
+
+TypeId
+MpiTelemetryExporter::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::MpiTelemetryExporter")
+            .SetParent<Object>()
+            .SetGroupName("MpiFlowMonitor")
+            .AddConstructor<MpiTelemetryExporter>()
+            .AddAttribute("Interval",
+                          ("Wall clock time between two samples."),
+                          TimeValue(Seconds(1)),
+                          MakeTimeAccessor(&MpiTelemetryExporter::m_interval),
+                          MakeTimeChecker())
+            .AddAttribute("Capacity",
+                          ("Number of samples kept in the ring."),
+                          UintegerValue(1024),
+                          MakeUintegerAccessor(&MpiTelemetryExporter::m_capacity),
+                          MakeUintegerChecker<uint32_t>(2));
+    return tid;
+}
+
+MpiTelemetryExporter::MpiTelemetryExporter()
+    : m_capacity(1024),
+      m_systemId(0),
+      m_header(nullptr),
+      m_samples(nullptr),
+      m_size(0),
+      m_stopping(false),
+      m_linkDrops(false),
+      m_lastClock(0),
+      m_lastSimTime(0),
+      m_lastEvents(0)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+MpiTelemetryExporter::~MpiTelemetryExporter()
+{
+    // the thread must never outlive the object, even without Dispose
+    Stop();
+}
+
+void
+MpiTelemetryExporter::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Stop();
+    m_flowMonitor = nullptr;
+    m_linkMonitor = nullptr;
+    Object::DoDispose();
+}
+
+static int64_t
+GetUnixTime()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+static int64_t
+GetSteadyClock()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void
+MpiTelemetryExporter::Start(std::string name)
+{
+    NS_LOG_FUNCTION(this << name);
+    NS_ABORT_MSG_IF(!m_name.empty(), "Telemetry exporter already started");
+    NS_ABORT_MSG_IF(!m_interval.IsStrictlyPositive(), "Telemetry interval must be positive");
+
+    m_name = "/" + name + "-" + std::to_string(m_systemId);
+    m_size = sizeof(MpiTelemetryHeader) + m_capacity * sizeof(MpiTelemetrySample);
+
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+    NS_ABORT_MSG_IF(fd < 0, "Could not create telemetry segment " << m_name << ": " << std::strerror(errno));
+    NS_ABORT_MSG_IF(ftruncate(fd, m_size) != 0,
+                    "Could not size telemetry segment " << m_name << ": " << std::strerror(errno));
+    void* mapping = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    NS_ABORT_MSG_IF(mapping == MAP_FAILED,
+                    "Could not map telemetry segment " << m_name << ": " << std::strerror(errno));
+
+    // the segment is zeroed by ftruncate, fill in everything but the counter
+    m_header = static_cast<MpiTelemetryHeader*>(mapping);
+    m_samples = reinterpret_cast<MpiTelemetrySample*>(m_header + 1);
+    std::memcpy(m_header->magic, MPI_TELEMETRY_MAGIC, sizeof(m_header->magic));
+    m_header->version = MPI_TELEMETRY_VERSION;
+    m_header->recordSize = sizeof(MpiTelemetrySample);
+    m_header->systemId = m_systemId;
+    m_header->capacity = m_capacity;
+    m_header->pid = getpid();
+    m_header->interval = m_interval.GetNanoSeconds();
+    m_header->startTime = GetUnixTime();
+    m_header->state = MPI_TELEMETRY_RUNNING;
+
+    // decided here, the link monitor is not changed once the simulation runs
+    m_linkDrops = m_linkMonitor && m_linkMonitor->GetNLinks() > 0;
+    m_lastClock = GetSteadyClock();
+    m_lastSimTime = Simulator::Now().GetNanoSeconds();
+    m_lastEvents = Simulator::GetEventCount();
+
+    m_stopping = false;
+    m_thread = std::thread(&MpiTelemetryExporter::Run, this);
+}
+
+void
+MpiTelemetryExporter::Stop()
+{
+    if (m_name.empty())
+    {
+        return;
+    }
+    NS_LOG_FUNCTION(this);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeup.notify_one();
+    m_thread.join();
+
+    Publish();
+    m_header->state = MPI_TELEMETRY_FINISHED;
+
+    // readers that mapped the segment keep it until they unmap it
+    munmap(m_header, m_size);
+    shm_unlink(m_name.c_str());
+    m_header = nullptr;
+    m_samples = nullptr;
+    m_name.clear();
+}
+
+void
+MpiTelemetryExporter::Run()
+{
+    std::chrono::nanoseconds interval(m_interval.GetNanoSeconds());
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_wakeup.wait_for(lock, interval, [this] { return m_stopping; }))
+    {
+        Publish();
+    }
+}
+
+void
+MpiTelemetryExporter::Publish()
+{
+    // no logging here, this runs on the exporter thread
+    int64_t clock = GetSteadyClock();
+    int64_t simTime = Simulator::Now().GetNanoSeconds();
+    uint64_t events = Simulator::GetEventCount();
+
+    uint64_t written = m_header->written.load(std::memory_order_relaxed);
+    MpiTelemetrySample& sample = m_samples[written % m_capacity];
+    sample.wallTime = GetUnixTime();
+    sample.simTime = simTime;
+    sample.events = events;
+    sample.activeFlows = 0;
+    sample.completedFlows = 0;
+    sample.drops = 0;
+    if (m_flowMonitor)
+    {
+        // completions first, a flow is always counted as started before it completes
+        sample.completedFlows = m_flowMonitor->GetNumCompletedFlows();
+        sample.activeFlows = m_flowMonitor->GetNumStartedFlows() - sample.completedFlows;
+        sample.drops = m_flowMonitor->GetNumDrops();
+    }
+    if (m_linkDrops)
+    {
+        sample.drops = m_linkMonitor->GetNumDrops();
+    }
+
+    double elapsed = (clock - m_lastClock) / 1e9;
+    sample.simRate = elapsed > 0 ? (simTime - m_lastSimTime) / 1e9 / elapsed : 0;
+    sample.eventRate = elapsed > 0 ? (events - m_lastEvents) / elapsed : 0;
+    m_lastClock = clock;
+    m_lastSimTime = simTime;
+    m_lastEvents = events;
+
+    m_header->written.store(written + 1, std::memory_order_release);
+}
+
+} // namespace ns3
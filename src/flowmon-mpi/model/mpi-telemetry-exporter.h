@@ -0,0 +1,160 @@
+#ifndef MPI_TELEMETRY_EXPORTER_H
+#define MPI_TELEMETRY_EXPORTER_H
+
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+namespace ns3
+{
+
+class MpiFlowMonitor;
+class MpiLinkMonitor;
+
+/// First eight bytes of every telemetry segment
+#define MPI_TELEMETRY_MAGIC "SWRMTELE"
+
+/// Bumped whenever the layout of MpiTelemetrySample or the segment header changes
+#define MPI_TELEMETRY_VERSION 1
+
+/// Values of MpiTelemetryHeader::state
+#define MPI_TELEMETRY_RUNNING 1
+#define MPI_TELEMETRY_FINISHED 2
+
+/**
+ * Counter written by the simulation thread only and read by the telemetry
+ * exporter thread. Increments are a plain load and store, so they cost no
+ * more than a normal counter, readers only ever see whole values.
+ */
+class MpiTelemetryCounter
+{
+  public:
+    void Increment(uint64_t n = 1) {
+      m_value.store(m_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    uint64_t Get() const {
+      return m_value.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<uint64_t> m_value{0};
+};
+
+/// One published sample, the slots of the ring
+struct MpiTelemetrySample
+{
+    int64_t wallTime;               //!< Unix time of the sample, in ns
+    int64_t simTime;                //!< Simulation time, in ns
+    uint64_t events;                //!< Events executed by this rank
+    uint64_t activeFlows;           //!< Monitored flows that started receiving and did not finish
+    uint64_t completedFlows;        //!< Monitored flows that finished
+    uint64_t drops;                 //!< Packets dropped on this rank
+    double simRate;                 //!< Simulated seconds per wall clock second since the previous sample
+    double eventRate;               //!< Events per wall clock second since the previous sample
+};
+
+static_assert(sizeof(MpiTelemetrySample) == 64, "MpiTelemetrySample must stay packed, readers depend on it");
+
+/// Start of the shared memory segment, followed by `capacity` samples
+struct MpiTelemetryHeader
+{
+    char magic[8];                  //!< MPI_TELEMETRY_MAGIC, not null terminated
+    uint32_t version;               //!< MPI_TELEMETRY_VERSION
+    uint32_t recordSize;            //!< sizeof(MpiTelemetrySample)
+    uint32_t systemId;              //!< Rank that owns the segment
+    uint32_t capacity;              //!< Slots in the ring
+    uint32_t state;                 //!< MPI_TELEMETRY_RUNNING, then MPI_TELEMETRY_FINISHED
+    int32_t pid;                    //!< Process of the rank, for watchdogs
+    int64_t interval;               //!< Wall clock time between two samples, in ns
+    int64_t startTime;              //!< Unix time the exporter started, in ns
+    std::atomic<uint64_t> written;  //!< Samples written so far, sample k is in slot k % capacity
+    uint64_t reserved;
+};
+
+static_assert(sizeof(MpiTelemetryHeader) == 64, "MpiTelemetryHeader must stay packed");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Readers of the segment can not take a lock");
+
+/**
+ * Publishes live counters of a rank into a POSIX shared memory ring, so that
+ * long runs can be followed and stopped early by a local dashboard or
+ * watchdog.
+ *
+ * A background thread wakes up every Interval of wall clock time and writes
+ * one MpiTelemetrySample into `/dev/shm/<name>-<systemId>`. No simulation
+ * event is scheduled: simulation time and event count are read from the
+ * simulator without synchronisation, and the flow and drop counters are
+ * MpiTelemetryCounter. A sample may thus be a few events old, which is fine
+ * for monitoring.
+ *
+ * The newest sample is slot `(written - 1) % capacity`. It is complete once
+ * `written` is published, and stays valid while fewer than `capacity - 1`
+ * further samples were written.
+ *
+ * Flow counters come from the flow monitor, drops from the link monitor if
+ * it counts drops and from the flow monitor otherwise.
+ */
+class MpiTelemetryExporter : public Object
+{
+  public:
+    static TypeId GetTypeId();
+    MpiTelemetryExporter();
+    ~MpiTelemetryExporter() override;
+
+    void SetSystemId(uint32_t systemId) {
+      m_systemId = systemId;
+    }
+
+    void SetFlowMonitor(Ptr<MpiFlowMonitor> monitor) {
+      m_flowMonitor = monitor;
+    }
+
+    void SetLinkMonitor(Ptr<MpiLinkMonitor> monitor) {
+      m_linkMonitor = monitor;
+    }
+
+    /// Create the segment `/<name>-<systemId>` and start the exporter thread
+    void Start(std::string name);
+
+    /// Publish a last sample, mark the segment finished and remove it
+    void Stop();
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    void Run();
+    void Publish();
+
+    Time m_interval;
+    uint32_t m_capacity;
+    uint32_t m_systemId;
+    Ptr<MpiFlowMonitor> m_flowMonitor;
+    Ptr<MpiLinkMonitor> m_linkMonitor;
+
+    std::string m_name;                     //!< Name of the segment, empty when not started
+    MpiTelemetryHeader* m_header;           //!< Start of the mapping
+    MpiTelemetrySample* m_samples;          //!< The ring, right after the header
+    size_t m_size;                          //!< Bytes mapped
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_stopping;                        //!< Guarded by m_mutex
+    bool m_linkDrops;                       //!< Drops come from the link monitor
+
+    int64_t m_lastClock;                    //!< Steady clock of the previous sample, for the rates
+    int64_t m_lastSimTime;
+    uint64_t m_lastEvents;
+};
+
+} // namespace ns3
+
+#endif /* MPI_TELEMETRY_EXPORTER_H */
@@ -0,0 +1,355 @@
+#include "ns3/ptr.h"
+#include "ns3/test.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ipv4-mpi-flow-classifier.h"
+#include "ns3/mpi-flow-record.h"
+#include "ns3/mpi-flow-sketch.h"
+
+#include <cstring>
+#include <vector>
+
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("MpiFlowMonitorTest");
+
+/// A TCP five-tuple between 10.0.<host / 256>.<host % 256> hosts
+static Ipv4MpiFlowClassifier::FiveTuple
+MakeTuple(uint32_t srcHost, uint32_t dstHost, uint16_t srcPort, uint16_t dstPort)
+{
+    Ipv4MpiFlowClassifier::FiveTuple tuple;
+    tuple.sourceAddress = Ipv4Address(0x0a000000 | srcHost);
+    tuple.destinationAddress = Ipv4Address(0x0a000000 | dstHost);
+    tuple.protocol = TCP_PROT_NUMBER;
+    tuple.sourcePort = srcPort;
+    tuple.destinationPort = dstPort;
+    return tuple;
+}
+
+/**
+ * Classify a packet of the five-tuple: the classifier only reads the ports
+ * from the first four bytes of the payload.
+ */
+static bool
+ClassifyTuple(Ipv4MpiFlowClassifier& classifier,
+              const Ipv4MpiFlowClassifier::FiveTuple& tuple,
+              FlowId* flowId,
+              FlowPacketId* packetId)
+{
+    Ipv4Header ipHeader;
+    ipHeader.SetSource(tuple.sourceAddress);
+    ipHeader.SetDestination(tuple.destinationAddress);
+    ipHeader.SetProtocol(tuple.protocol);
+
+    uint8_t ports[20] = {0};
+    ports[0] = tuple.sourcePort >> 8;
+    ports[1] = tuple.sourcePort & 0xff;
+    ports[2] = tuple.destinationPort >> 8;
+    ports[3] = tuple.destinationPort & 0xff;
+    Ptr<Packet> payload = Create<Packet>(ports, sizeof(ports));
+
+    return classifier.Classify(ipHeader, payload, flowId, packetId);
+}
+
+/**
+ * Flow identifiers of the open-addressing flow table: new tuples get new
+ * identifiers, packets of a known tuple get the next packet identifier, and
+ * both survive the table growing.
+ */
+class MpiFlowClassifierTableTest : public TestCase {
+    public:
+        MpiFlowClassifierTableTest();
+
+        void DoRun() override;
+};
+
+MpiFlowClassifierTableTest :: MpiFlowClassifierTableTest()
+    : TestCase("Classifier flow table")
+{
+}
+
+void
+MpiFlowClassifierTableTest :: DoRun()
+{
+    Ipv4MpiFlowClassifier::SetSamplingRate(1);
+    Ipv4MpiFlowClassifier classifier;
+    classifier.SetSystemId(1);
+
+    // well past the initial 1024 slots, so the table grows a few times
+    const uint32_t numFlows = 5000;
+    std::vector<FlowId> flowIds(numFlows);
+    for (uint32_t i = 0; i < numFlows; i++)
+    {
+        FlowPacketId packetId;
+        bool classified = ClassifyTuple(classifier, MakeTuple(i % 64, 100 + i / 64, 1000 + i, 80), &flowIds[i], &packetId);
+        NS_TEST_ASSERT_MSG_EQ(classified, true, "A TCP packet should be classified");
+        NS_TEST_ASSERT_MSG_EQ(packetId, 0, "The first packet of a flow should be packet 0");
+        NS_TEST_ASSERT_MSG_EQ(flowIds[i],
+                              (1u << MPI_FLOW_ID_SYSTEM_SHIFT) + i + 1,
+                              "Flow identifiers are handed out in order after the system id");
+    }
+
+    for (uint32_t i = 0; i < numFlows; i++)
+    {
+        Ipv4MpiFlowClassifier::FiveTuple tuple = MakeTuple(i % 64, 100 + i / 64, 1000 + i, 80);
+
+        FlowId flowId;
+        FlowPacketId packetId;
+        ClassifyTuple(classifier, tuple, &flowId, &packetId);
+        NS_TEST_ASSERT_MSG_EQ(flowId, flowIds[i], "A known tuple should keep its flow after the table grew");
+        NS_TEST_ASSERT_MSG_EQ(packetId, 1, "The second packet of a flow should be packet 1");
+
+        NS_TEST_ASSERT_MSG_EQ(classifier.LookupFlow(tuple, flowId), true, "LookupFlow should find a classified tuple");
+        NS_TEST_ASSERT_MSG_EQ(flowId, flowIds[i], "LookupFlow should return the flow of the tuple");
+        NS_TEST_ASSERT_MSG_EQ((classifier.FindFlow(flowIds[i]) == tuple), true, "FindFlow should return the tuple of the flow");
+    }
+
+    FlowId flowId;
+    NS_TEST_ASSERT_MSG_EQ(classifier.LookupFlow(MakeTuple(1, 2, 3, 4), flowId), false,
+                          "LookupFlow should not find a tuple that was never classified");
+    NS_TEST_ASSERT_MSG_EQ(classifier.IsSrcDstValid(flowIds[0], Ipv4Address(0x0a000000), Ipv4Address(0x0a000064)),
+                          true,
+                          "The addresses of the flow should be valid");
+    NS_TEST_ASSERT_MSG_EQ(classifier.IsSrcDstValid(flowIds[0], Ipv4Address(0x0a000064), Ipv4Address(0x0a000000)),
+                          false,
+                          "Swapped addresses should not be valid");
+    NS_TEST_ASSERT_MSG_EQ(classifier.IsSrcDstValid(42, Ipv4Address(0x0a000064), Ipv4Address(0x0a000000)),
+                          true,
+                          "Flows of other ranks can not be checked");
+}
+
+/**
+ * Flow infos registered by the traffic generator are taken once, and the
+ * ones nobody takes expire after the timeout.
+ */
+class MpiFlowClassifierFlowInfoTest : public TestCase {
+    public:
+        MpiFlowClassifierFlowInfoTest();
+
+        void DoRun() override;
+};
+
+MpiFlowClassifierFlowInfoTest :: MpiFlowClassifierFlowInfoTest()
+    : TestCase("Classifier flow infos")
+{
+}
+
+void
+MpiFlowClassifierFlowInfoTest :: DoRun()
+{
+    Ipv4MpiFlowClassifier::SetSamplingRate(1);
+    Ipv4MpiFlowClassifier classifier;
+    classifier.SetFlowInfoTimeout(Seconds(1));
+
+    classifier.RegisterFlow(MakeTuple(1, 2, 1000, 80), MpiFlowInfo{7, 1500, 0, 0});
+    classifier.RegisterFlow(MakeTuple(1, 2, 1001, 80), MpiFlowInfo{8, 3000, 0, 0});
+    NS_TEST_ASSERT_MSG_EQ(classifier.GetNFlowInfos(), 2, "Both flows should be registered");
+
+    MpiFlowInfo info;
+    NS_TEST_ASSERT_MSG_EQ(classifier.TakeFlowInfo(MakeTuple(1, 2, 1000, 80), info), true, "A registered flow should be found");
+    NS_TEST_ASSERT_MSG_EQ(info.index, 7, "The info of the flow should be returned");
+    NS_TEST_ASSERT_MSG_EQ(info.size, 1500, "The info of the flow should be returned");
+    NS_TEST_ASSERT_MSG_EQ(classifier.TakeFlowInfo(MakeTuple(1, 2, 1000, 80), info), false, "A flow info is taken only once");
+
+    // the second flow is never taken, a registration after the timeout drops it
+    Simulator::Schedule(Seconds(2), [&classifier]() {
+        classifier.RegisterFlow(MakeTuple(1, 2, 1002, 80), MpiFlowInfo{9, 100, 0, 0});
+    });
+    Simulator::Run();
+
+    NS_TEST_ASSERT_MSG_EQ(classifier.GetNFlowInfos(), 1, "The flow info that was not taken should expire");
+    NS_TEST_ASSERT_MSG_EQ(classifier.TakeFlowInfo(MakeTuple(1, 2, 1001, 80), info), false, "An expired flow info is gone");
+    NS_TEST_ASSERT_MSG_EQ(classifier.TakeFlowInfo(MakeTuple(1, 2, 1002, 80), info), true, "The new flow info should be found");
+
+    classifier.RegisterFlow(MakeTuple(1, 2, 1003, 80), MpiFlowInfo{10, 100, 0, 0});
+    classifier.ClearFlowInfos();
+    NS_TEST_ASSERT_MSG_EQ(classifier.GetNFlowInfos(), 0, "ClearFlowInfos should forget every flow info");
+
+    Simulator::Destroy();
+}
+
+/**
+ * Percentiles of the log-linear sketch stay within its precision, and
+ * merging sketches is the same as adding all values to one.
+ */
+class MpiFlowSketchTest : public TestCase {
+    public:
+        MpiFlowSketchTest();
+
+        void DoRun() override;
+};
+
+MpiFlowSketchTest :: MpiFlowSketchTest()
+    : TestCase("Sketch add and merge")
+{
+}
+
+void
+MpiFlowSketchTest :: DoRun()
+{
+    MpiFlowSketch empty;
+    NS_TEST_ASSERT_MSG_EQ(empty.GetPercentile(50), 0, "An empty sketch reports 0");
+
+    // values below 2^subBits are exact
+    MpiFlowSketch small;
+    for (uint64_t value = 1; value <= 100; value++)
+    {
+        small.Add(value);
+    }
+    NS_TEST_ASSERT_MSG_EQ(small.GetCount(), 100, "Every value should be counted");
+    NS_TEST_ASSERT_MSG_EQ(small.GetPercentile(50), 50, "Small values should be exact");
+    NS_TEST_ASSERT_MSG_EQ(small.GetPercentile(100), 100, "Small values should be exact");
+    NS_TEST_ASSERT_MSG_EQ(small.GetPercentile(0), 1, "Percentile 0 is the smallest value");
+
+    // odd and even values in two sketches, all of them in a third one
+    MpiFlowSketch odd;
+    MpiFlowSketch even;
+    MpiFlowSketch all;
+    for (uint64_t value = 1; value <= 1000000; value++)
+    {
+        (value % 2 ? odd : even).Add(value * 1000);
+        all.Add(value * 1000);
+    }
+
+    double precision = 1.0 / (1 << MPI_FLOW_SKETCH_SUB_BITS);
+    for (double percentile : {1.0, 50.0, 90.0, 99.0, 99.9})
+    {
+        double exact = percentile * 10000 * 1000;
+        NS_TEST_ASSERT_MSG_EQ_TOL(static_cast<double>(all.GetPercentile(percentile)),
+                                  exact,
+                                  exact * precision,
+                                  "Percentile " << percentile << " should be within the sketch precision");
+    }
+
+    odd.Merge(even);
+    NS_TEST_ASSERT_MSG_EQ(odd.GetCount(), all.GetCount(), "A merged sketch should count both sketches");
+    for (double percentile : {1.0, 50.0, 90.0, 99.0, 99.9})
+    {
+        NS_TEST_ASSERT_MSG_EQ(odd.GetPercentile(percentile),
+                              all.GetPercentile(percentile),
+                              "Merging should be the same as adding every value to one sketch");
+    }
+
+    // buckets lined up for MPI reductions add up the same way
+    MpiFlowSketch reduced;
+    std::vector<uint64_t>& buckets = reduced.GetBuckets();
+    const std::vector<uint64_t>& allBuckets = all.GetBuckets();
+    for (uint32_t i = 0; i < buckets.size(); i++)
+    {
+        buckets[i] += allBuckets[i];
+    }
+    reduced.UpdateCount();
+    NS_TEST_ASSERT_MSG_EQ(reduced.GetCount(), all.GetCount(), "UpdateCount should sum the buckets");
+    NS_TEST_ASSERT_MSG_EQ(reduced.GetPercentile(50), all.GetPercentile(50), "Bucket sums should keep the percentiles");
+
+    all.Reset();
+    NS_TEST_ASSERT_MSG_EQ(all.GetCount(), 0, "Reset should empty the sketch");
+}
+
+/**
+ * The sender and receiver halves of a flow, written by different ranks,
+ * fold into one record.
+ */
+class MpiFlowRecordMergeTest : public TestCase {
+    public:
+        MpiFlowRecordMergeTest();
+
+        void DoRun() override;
+};
+
+MpiFlowRecordMergeTest :: MpiFlowRecordMergeTest()
+    : TestCase("Record merge")
+{
+}
+
+void
+MpiFlowRecordMergeTest :: DoRun()
+{
+    MpiFlowRecord sender;
+    std::memset(&sender, 0, sizeof(sender));
+    sender.flowId = 7;
+    sender.sourceAddress = 0x0a000001;
+    sender.destinationAddress = 0x0a000002;
+    sender.sourcePort = 1000;
+    sender.destinationPort = 80;
+    sender.protocol = TCP_PROT_NUMBER;
+    sender.timeFirstTxPacket = 100;
+    sender.timeLastTxPacket = 900;
+    sender.txBytes = 15000;
+    sender.packetsDropped = 1;
+    sender.bytesDropped = 1500;
+    sender.flowFileIndex = MPI_FLOW_FILE_INDEX_NONE;
+    sender.tcpTimeouts = 1;
+
+    MpiFlowRecord receiver;
+    std::memset(&receiver, 0, sizeof(receiver));
+    receiver.flowId = 7;
+    receiver.timeFirstRxPacket = 150;
+    receiver.timeLastRxPacket = 1000;
+    receiver.rxBytes = 13500;
+    receiver.flowFileIndex = 3;
+    receiver.flowSize = 15000;
+
+    MpiFlowRecord other;
+    std::memset(&other, 0, sizeof(other));
+    other.flowId = 2;
+    other.timeFirstTxPacket = 50;
+    other.txBytes = 100;
+    other.flowFileIndex = MPI_FLOW_FILE_INDEX_NONE;
+
+    std::vector<MpiFlowRecord> records{receiver, other, sender};
+    MergeFlowRecords(records);
+
+    NS_TEST_ASSERT_MSG_EQ(records.size(), 2, "The two halves of flow 7 should be merged");
+    NS_TEST_ASSERT_MSG_EQ(records[0].flowId, 2, "Records should be sorted by flow id");
+    NS_TEST_ASSERT_MSG_EQ(records[0].txBytes, 100, "A flow with one half should be left as is");
+
+    const MpiFlowRecord& merged = records[1];
+    NS_TEST_ASSERT_MSG_EQ(merged.flowId, 7, "Records should be sorted by flow id");
+    NS_TEST_ASSERT_MSG_EQ(merged.sourceAddress, 0x0a000001, "The tuple comes from the classifying half");
+    NS_TEST_ASSERT_MSG_EQ(merged.sourcePort, 1000, "The tuple comes from the classifying half");
+    NS_TEST_ASSERT_MSG_EQ(unsigned(merged.protocol), unsigned(TCP_PROT_NUMBER), "The tuple comes from the classifying half");
+    NS_TEST_ASSERT_MSG_EQ(merged.flowFileIndex, 3, "The flow file entry comes from the receiving half");
+    NS_TEST_ASSERT_MSG_EQ(merged.flowSize, 15000, "The flow file entry comes from the receiving half");
+    NS_TEST_ASSERT_MSG_EQ(merged.timeFirstTxPacket, 100, "Times only seen by one half are kept");
+    NS_TEST_ASSERT_MSG_EQ(merged.timeFirstRxPacket, 150, "Times only seen by one half are kept");
+    NS_TEST_ASSERT_MSG_EQ(merged.timeLastTxPacket, 900, "Times only seen by one half are kept");
+    NS_TEST_ASSERT_MSG_EQ(merged.timeLastRxPacket, 1000, "Times only seen by one half are kept");
+    NS_TEST_ASSERT_MSG_EQ(merged.txBytes, 15000, "Byte counters are summed");
+    NS_TEST_ASSERT_MSG_EQ(merged.rxBytes, 13500, "Byte counters are summed");
+    NS_TEST_ASSERT_MSG_EQ(merged.packetsDropped, 1, "Drop counters are summed");
+    NS_TEST_ASSERT_MSG_EQ(merged.bytesDropped, 1500, "Drop counters are summed");
+    NS_TEST_ASSERT_MSG_EQ(merged.tcpTimeouts, 1, "TCP counters come from the sender");
+
+    // the same flow seen early by one rank and late by another
+    MpiFlowRecord early = other;
+    early.timeFirstTxPacket = 10;
+    early.timeLastTxPacket = 20;
+    MpiFlowRecord late = other;
+    late.timeFirstTxPacket = 30;
+    late.timeLastTxPacket = 40;
+    records = {late, early};
+    MergeFlowRecords(records);
+    NS_TEST_ASSERT_MSG_EQ(records.size(), 1, "Both records of flow 2 should be merged");
+    NS_TEST_ASSERT_MSG_EQ(records[0].timeFirstTxPacket, 10, "First times take the earliest");
+    NS_TEST_ASSERT_MSG_EQ(records[0].timeLastTxPacket, 40, "Last times take the latest");
+}
+
+class MpiFlowMonitorTestSuite : public TestSuite
+{
+    public:
+        MpiFlowMonitorTestSuite();
+};
+
+MpiFlowMonitorTestSuite::MpiFlowMonitorTestSuite()
+    : TestSuite("flowmon-mpi", UNIT)
+{
+    AddTestCase(new MpiFlowClassifierTableTest(), TestCase::QUICK);
+    AddTestCase(new MpiFlowClassifierFlowInfoTest(), TestCase::QUICK);
+    AddTestCase(new MpiFlowSketchTest(), TestCase::QUICK);
+    AddTestCase(new MpiFlowRecordMergeTest(), TestCase::QUICK);
+}
+
+static MpiFlowMonitorTestSuite mpiFlowMonitorTestSuite;
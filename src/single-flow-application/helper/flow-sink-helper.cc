@@ -0,0 +1,74 @@
+#include "flow-sink-helper.h"
+
+#include "ns3/abort.h"
+#include "ns3/string.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace ns3
+{
+    FlowSinkHelper::FlowSinkHelper(std::string protocol, Address address)
+    {
+        m_factory.SetTypeId("ns3::FlowSinkApplication");
+        m_factory.Set("Protocol", StringValue(protocol));
+        m_factory.Set("Local", AddressValue(address));
+    }
+
+    void
+    FlowSinkHelper::SetAttribute(std::string name, const AttributeValue& value)
+    {
+        m_factory.Set(name, value);
+    }
+
+    ApplicationContainer
+    FlowSinkHelper::Install(Ptr<Node> node) const
+    {
+        Ptr<Application> app = m_factory.Create<Application>();
+        node->AddApplication(app);
+        return ApplicationContainer(app);
+    }
+
+    ApplicationContainer
+    FlowSinkHelper::Install(NodeContainer c) const
+    {
+        ApplicationContainer apps;
+        for (auto i = c.Begin(); i != c.End(); ++i)
+        {
+            apps.Add(Install(*i));
+        }
+
+        return apps;
+    }
+
+    uint64_t
+    FlowSinkHelper::SerializeToFile(std::string fileName, uint32_t systemId, const ApplicationContainer& apps)
+    {
+        std::vector<FlowSinkRecord> records;
+        for (auto i = apps.Begin(); i != apps.End(); ++i)
+        {
+            Ptr<FlowSinkApplication> sink = DynamicCast<FlowSinkApplication>(*i);
+            if (sink)
+            {
+                sink->GetRecords(records);
+            }
+        }
+
+        std::ofstream os(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+        NS_ABORT_MSG_IF(!os.is_open(), "Could not open sink record file " << fileName);
+
+        FlowSinkRecordFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, FLOW_SINK_RECORD_MAGIC, sizeof(header.magic));
+        header.version = FLOW_SINK_RECORD_VERSION;
+        header.recordSize = sizeof(FlowSinkRecord);
+        header.systemId = systemId;
+        header.numRecords = records.size();
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        os.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(FlowSinkRecord));
+        os.close();
+
+        return records.size();
+    }
+} // namespace ns3
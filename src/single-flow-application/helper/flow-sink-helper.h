@@ -0,0 +1,40 @@
+#ifndef FLOW_SINK_HELPER_H
+#define FLOW_SINK_HELPER_H
+
+#include "ns3/address.h"
+#include "ns3/application-container.h"
+#include "ns3/attribute.h"
+#include "ns3/flow-sink-application.h"
+#include "ns3/node-container.h"
+#include "ns3/object-factory.h"
+
+#include <stdint.h>
+#include <string>
+
+namespace ns3
+{
+  class FlowSinkHelper
+  {
+    public:
+      FlowSinkHelper(std::string protocol, Address address);
+
+      void SetAttribute(std::string name, const AttributeValue& value);
+
+      ApplicationContainer Install(NodeContainer c) const;
+
+      ApplicationContainer Install(Ptr<Node> node) const;
+
+      /**
+       * Write the FlowSinkRecords of every FlowSinkApplication in `apps`
+       * into `fileName`, a FlowSinkRecordFileHeader followed by the records.
+       * Connections still open are written too, see FlowSinkRecord::closeReason.
+       * Returns the number of records written.
+       */
+      static uint64_t SerializeToFile(std::string fileName, uint32_t systemId, const ApplicationContainer& apps);
+
+    private:
+      ObjectFactory m_factory; //!< Object factory.
+  };
+} // namespace ns3
+
+#endif /* FLOW_SINK_HELPER_H */
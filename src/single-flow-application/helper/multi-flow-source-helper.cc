@@ -0,0 +1,31 @@
+#include "multi-flow-source-helper.h"
+
+#include "ns3/string.h"
+
+namespace ns3
+{
+    MultiFlowSourceHelper::MultiFlowSourceHelper(std::string protocol)
+    {
+        m_factory.SetTypeId("ns3::MultiFlowSourceApplication");
+        m_factory.Set("Protocol", StringValue(protocol));
+    }
+
+    void
+    MultiFlowSourceHelper::SetAttribute(std::string name, const AttributeValue& value)
+    {
+        m_factory.Set(name, value);
+    }
+
+    ApplicationContainer
+    MultiFlowSourceHelper::Install(Ptr<Node> node, const std::vector<Address>& destinations) const
+    {
+        Ptr<MultiFlowSourceApplication> app = m_factory.Create<MultiFlowSourceApplication>();
+        for (const auto& destination : destinations)
+        {
+            app->AddDestination(destination);
+        }
+        node->AddApplication(app);
+
+        return ApplicationContainer(app);
+    }
+} // namespace ns3
@@ -0,0 +1,30 @@
+#ifndef MULTI_FLOW_SOURCE_HELPER_H
+#define MULTI_FLOW_SOURCE_HELPER_H
+
+#include "ns3/address.h"
+#include "ns3/application-container.h"
+#include "ns3/attribute.h"
+#include "ns3/multi-flow-source-application.h"
+#include "ns3/object-factory.h"
+
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+  class MultiFlowSourceHelper
+  {
+    public:
+      MultiFlowSourceHelper(std::string protocol);
+
+      void SetAttribute(std::string name, const AttributeValue& value);
+
+      /// One application on `node` sending to all of `destinations`
+      ApplicationContainer Install(Ptr<Node> node, const std::vector<Address>& destinations) const;
+
+    private:
+      ObjectFactory m_factory; //!< Object factory.
+  };
+} // namespace ns3
+
+#endif /* MULTI_FLOW_SOURCE_HELPER_H */
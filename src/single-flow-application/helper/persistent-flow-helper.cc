@@ -0,0 +1,69 @@
+#include "persistent-flow-helper.h"
+
+#include "ns3/names.h"
+#include "ns3/string.h"
+
+namespace ns3
+{
+    PersistentFlowHelper::PersistentFlowHelper(std::string protocol)
+    {
+        m_factory.SetTypeId("ns3::PersistentFlowApplication");
+        m_factory.Set("Protocol", StringValue(protocol));
+    }
+
+    void
+    PersistentFlowHelper::SetAttribute(std::string name, const AttributeValue& value)
+    {
+        m_factory.Set(name, value);
+    }
+
+    Ptr<PersistentFlowApplication>
+    PersistentFlowHelper::SendMessage(Ptr<Node> node, const Address& remote, uint32_t id, uint64_t size)
+    {
+        Ptr<PersistentFlowApplication>& app = m_connections[std::make_pair(node->GetId(), remote)];
+        if (!app)
+        {
+            app = m_factory.Create<PersistentFlowApplication>();
+            app->SetAttribute("Remote", AddressValue(remote));
+            node->AddApplication(app);
+            // connects right away, the message below waits for it
+            app->SetStartTime(Seconds(0));
+        }
+
+        app->SendMessage(id, size);
+        return app;
+    }
+
+    MessageSinkHelper::MessageSinkHelper(std::string protocol, Address address)
+    {
+        m_factory.SetTypeId("ns3::MessageSinkApplication");
+        m_factory.Set("Protocol", StringValue(protocol));
+        m_factory.Set("Local", AddressValue(address));
+    }
+
+    void
+    MessageSinkHelper::SetAttribute(std::string name, const AttributeValue& value)
+    {
+        m_factory.Set(name, value);
+    }
+
+    ApplicationContainer
+    MessageSinkHelper::Install(Ptr<Node> node) const
+    {
+        Ptr<Application> app = m_factory.Create<Application>();
+        node->AddApplication(app);
+        return ApplicationContainer(app);
+    }
+
+    ApplicationContainer
+    MessageSinkHelper::Install(NodeContainer c) const
+    {
+        ApplicationContainer apps;
+        for (auto i = c.Begin(); i != c.End(); ++i)
+        {
+            apps.Add(Install(*i));
+        }
+
+        return apps;
+    }
+} // namespace ns3
@@ -0,0 +1,66 @@
+#ifndef PERSISTENT_FLOW_HELPER_H
+#define PERSISTENT_FLOW_HELPER_H
+
+#include "ns3/address.h"
+#include "ns3/application-container.h"
+#include "ns3/attribute.h"
+#include "ns3/node-container.h"
+#include "ns3/object-factory.h"
+#include "ns3/message-sink-application.h"
+#include "ns3/persistent-flow-application.h"
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+namespace ns3
+{
+  /**
+   * Keeps one PersistentFlowApplication per (source node, destination) and
+   * sends every flow between the two as a message over it, so the number of
+   * connections is bounded by the communicating pairs instead of the flows.
+   */
+  class PersistentFlowHelper
+  {
+    public:
+      PersistentFlowHelper(std::string protocol);
+
+      /// Applied to the connections opened from now on
+      void SetAttribute(std::string name, const AttributeValue& value);
+
+      /**
+       * Queue a message of `size` bytes on the connection from `node` to
+       * `remote`, opening it first if this is the pair's first message.
+       */
+      Ptr<PersistentFlowApplication> SendMessage(Ptr<Node> node, const Address& remote, uint32_t id, uint64_t size);
+
+      /// Connections opened so far, on all nodes
+      uint32_t GetNConnections() const {
+        return m_connections.size();
+      }
+
+    private:
+      ObjectFactory m_factory; //!< Object factory.
+      /// (nodeId, remote) --> the connection between them
+      std::map<std::pair<uint32_t, Address>, Ptr<PersistentFlowApplication>> m_connections;
+  };
+
+  /// Installs MessageSinkApplications, the receivers of PersistentFlowHelper
+  class MessageSinkHelper
+  {
+    public:
+      MessageSinkHelper(std::string protocol, Address address);
+
+      void SetAttribute(std::string name, const AttributeValue& value);
+
+      ApplicationContainer Install(NodeContainer c) const;
+
+      ApplicationContainer Install(Ptr<Node> node) const;
+
+    private:
+      ObjectFactory m_factory; //!< Object factory.
+  };
+} // namespace ns3
+
+#endif /* PERSISTENT_FLOW_HELPER_H */
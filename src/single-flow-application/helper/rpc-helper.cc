@@ -0,0 +1,64 @@
+#include "rpc-helper.h"
+
+#include "ns3/string.h"
+
+namespace ns3
+{
+    RpcHelper::RpcHelper(std::string protocol, Address address)
+    {
+        m_factory.SetTypeId("ns3::RpcApplication");
+        m_factory.Set("Protocol", StringValue(protocol));
+        m_factory.Set("Local", AddressValue(address));
+    }
+
+    void
+    RpcHelper::SetAttribute(std::string name, const AttributeValue& value)
+    {
+        m_factory.Set(name, value);
+    }
+
+    ApplicationContainer
+    RpcHelper::Install(Ptr<Node> node) const
+    {
+        return ApplicationContainer(InstallPriv(node));
+    }
+
+    ApplicationContainer
+    RpcHelper::Install(NodeContainer c) const
+    {
+        ApplicationContainer apps;
+        for (auto i = c.Begin(); i != c.End(); ++i)
+        {
+            apps.Add(InstallPriv(*i));
+        }
+
+        return apps;
+    }
+
+    ApplicationContainer
+    RpcHelper::Install(Ptr<Node> node, const std::vector<Address>& servers) const
+    {
+        Ptr<RpcApplication> app = InstallPriv(node);
+        for (const Address& server : servers)
+        {
+            app->AddServer(server);
+        }
+        return ApplicationContainer(app);
+    }
+
+    ApplicationContainer
+    RpcHelper::Install(Ptr<Node> node, RpcApplication::Workload workload) const
+    {
+        Ptr<RpcApplication> app = InstallPriv(node);
+        app->SetWorkload(workload);
+        return ApplicationContainer(app);
+    }
+
+    Ptr<RpcApplication>
+    RpcHelper::InstallPriv(Ptr<Node> node) const
+    {
+        Ptr<RpcApplication> app = m_factory.Create<RpcApplication>();
+        node->AddApplication(app);
+        return app;
+    }
+} // namespace ns3
@@ -0,0 +1,42 @@
+#ifndef RPC_HELPER_H
+#define RPC_HELPER_H
+
+#include "ns3/address.h"
+#include "ns3/application-container.h"
+#include "ns3/attribute.h"
+#include "ns3/node-container.h"
+#include "ns3/object-factory.h"
+#include "ns3/rpc-application.h"
+
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+  class RpcHelper
+  {
+    public:
+      /// Applications serving requests on `address`, invalid for clients only
+      RpcHelper(std::string protocol, Address address);
+
+      void SetAttribute(std::string name, const AttributeValue& value);
+
+      /// Servers only
+      ApplicationContainer Install(NodeContainer c) const;
+
+      ApplicationContainer Install(Ptr<Node> node) const;
+
+      /// A server running the fan-out client towards `servers`
+      ApplicationContainer Install(Ptr<Node> node, const std::vector<Address>& servers) const;
+
+      /// A server running `workload`
+      ApplicationContainer Install(Ptr<Node> node, RpcApplication::Workload workload) const;
+
+    private:
+      Ptr<RpcApplication> InstallPriv(Ptr<Node> node) const;
+
+      ObjectFactory m_factory; //!< Object factory.
+  };
+} // namespace ns3
+
+#endif /* RPC_HELPER_H */
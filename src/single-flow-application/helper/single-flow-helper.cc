@@ -28,6 +28,21 @@ namespace ns3
     SingleFlowHelper::SetAttribute(std::string name, const AttributeValue& value)
     {
         m_factory.Set(name, value);
+        for (auto& attribute : m_attributes)
+        {
+            if (attribute.first == name)
+            {
+                attribute.second = value.Copy();
+                return;
+            }
+        }
+        m_attributes.emplace_back(name, value.Copy());
+    }
+
+    void
+    SingleFlowHelper::SetSocketTraceSink(Callback<void, Ptr<Socket>> sink)
+    {
+        m_socketSink = sink;
     }
 
     ApplicationContainer
@@ -55,10 +70,77 @@ namespace ns3
         return apps;
     }
 
+    Ptr<SingleFlowApplication>
+    SingleFlowHelper::InstallFromPool(Ptr<Node> node)
+    {
+        Ptr<SingleFlowApplication> app = TakeFromPool(node);
+        if (!app)
+        {
+            return CreateForPool(node);
+        }
+
+        for (const auto& attribute : m_attributes)
+        {
+            app->SetAttribute(attribute.first, *attribute.second);
+        }
+        app->Restart();
+        return app;
+    }
+
+    Ptr<SingleFlowApplication>
+    SingleFlowHelper::InstallFromPool(Ptr<Node> node, const SingleFlowApplication::FlowConfig& config)
+    {
+        Ptr<SingleFlowApplication> app = TakeFromPool(node);
+        if (!app)
+        {
+            app = CreateForPool(node);
+            app->SetFlowConfig(config);
+            return app;
+        }
+
+        app->SetFlowConfig(config);
+        app->Restart();
+        return app;
+    }
+
+    Ptr<SingleFlowApplication>
+    SingleFlowHelper::TakeFromPool(Ptr<Node> node)
+    {
+        auto it = m_pool.find(node->GetId());
+        if (it == m_pool.end() || it->second.empty())
+        {
+            return nullptr;
+        }
+
+        Ptr<SingleFlowApplication> app = it->second.back();
+        it->second.pop_back();
+        return app;
+    }
+
+    Ptr<SingleFlowApplication>
+    SingleFlowHelper::CreateForPool(Ptr<Node> node)
+    {
+        Ptr<SingleFlowApplication> app = DynamicCast<SingleFlowApplication>(InstallPriv(node));
+        app->SetDoneCallback(MakeCallback(&SingleFlowHelper::Release, this));
+        app->SetStartTime(Seconds(0));
+        m_poolSize++;
+        return app;
+    }
+
+    void
+    SingleFlowHelper::Release(Ptr<SingleFlowApplication> app)
+    {
+        m_pool[app->GetNode()->GetId()].push_back(app);
+    }
+
     Ptr<Application>
     SingleFlowHelper::InstallPriv(Ptr<Node> node) const
     {
         Ptr<Application> app = m_factory.Create<Application>();
+        if (!m_socketSink.IsNull())
+        {
+            app->TraceConnectWithoutContext("Socket", m_socketSink);
+        }
         node->AddApplication(app);
 
         return app;
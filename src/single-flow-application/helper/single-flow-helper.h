@@ -11,6 +11,9 @@
 
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace ns3
 {
@@ -22,16 +25,52 @@ namespace ns3
 
       void SetAttribute(std::string name, const AttributeValue& value);
 
+      /// Connect `sink` to the Socket trace of every application created from now on
+      void SetSocketTraceSink(Callback<void, Ptr<Socket>> sink);
+
       ApplicationContainer Install(NodeContainer c) const;
 
       ApplicationContainer Install(Ptr<Node> node) const;
 
       ApplicationContainer Install(std::string nodeName) const;
 
+      /**
+       * Start a flow with the current attributes from an application of the
+       * node that finished its previous flow, or from a new one if all of
+       * them are busy. Applications can not be removed from a node, so this
+       * keeps their number at the peak of concurrent flows of the node
+       * instead of one per flow. Pooled applications are started right away.
+       */
+      Ptr<SingleFlowApplication> InstallFromPool(Ptr<Node> node);
+
+      /**
+       * Same as above, but the flow is described by `config` instead of the
+       * attributes set through this helper, which are not re-applied to
+       * recycled applications. This is the cheap path for dispatching many
+       * flows: nothing is looked up by name or parsed from a string.
+       */
+      Ptr<SingleFlowApplication> InstallFromPool(Ptr<Node> node, const SingleFlowApplication::FlowConfig& config);
+
+      /// Applications created by InstallFromPool so far, on all nodes
+      uint32_t GetPoolSize() const {
+        return m_poolSize;
+      }
+
     private:
       Ptr<Application> InstallPriv(Ptr<Node> node) const;
+      /// An idle application of the node, null if none
+      Ptr<SingleFlowApplication> TakeFromPool(Ptr<Node> node);
+      /// A new application for the pool, started by its node
+      Ptr<SingleFlowApplication> CreateForPool(Ptr<Node> node);
+      void Release(Ptr<SingleFlowApplication> app);
 
       ObjectFactory m_factory; //!< Object factory.
+      /// Attributes set since construction, re-applied to recycled applications
+      std::vector<std::pair<std::string, Ptr<AttributeValue>>> m_attributes;
+      Callback<void, Ptr<Socket>> m_socketSink;
+      /// nodeId --> applications of the node waiting for a flow
+      std::unordered_map<uint32_t, std::vector<Ptr<SingleFlowApplication>>> m_pool;
+      uint32_t m_poolSize = 0;
   };
 } // namespace ns3
 
@@ -0,0 +1,249 @@
+#include "flow-sink-application.h"
+
+#include "ns3/address.h"
+#include "ns3/boolean.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/socket-factory.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <cstring>
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("FlowSinkApplication");
+
+NS_OBJECT_ENSURE_REGISTERED(FlowSinkApplication);
+
+TypeId
+FlowSinkApplication::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::FlowSinkApplication")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<FlowSinkApplication>()
+            .AddAttribute("Local",
+                        "The Address on which to Bind the rx socket.",
+                        AddressValue(),
+                        MakeAddressAccessor(&FlowSinkApplication::m_local),
+                        MakeAddressChecker())
+            .AddAttribute("Protocol",
+                        "The type id of the connection-oriented protocol to use for the rx socket.",
+                        TypeIdValue(TcpSocketFactory::GetTypeId()),
+                        MakeTypeIdAccessor(&FlowSinkApplication::m_tid),
+                        MakeTypeIdChecker())
+            .AddAttribute("KeepRecords",
+                        "Keep the record of every closed connection for GetRecords.",
+                        BooleanValue(false),
+                        MakeBooleanAccessor(&FlowSinkApplication::m_keepRecords),
+                        MakeBooleanChecker())
+            .AddTraceSource("Rx",
+                            "A packet has been received",
+                            MakeTraceSourceAccessor(&FlowSinkApplication::m_rxTrace),
+                            "ns3::Packet::AddressTracedCallback")
+            .AddTraceSource("Flow",
+                            "A connection was closed and its socket released",
+                            MakeTraceSourceAccessor(&FlowSinkApplication::m_flowTrace),
+                            "ns3::FlowSinkApplication::FlowTracedCallback");
+    return tid;
+}
+
+FlowSinkApplication::FlowSinkApplication()
+    : m_socket(nullptr),
+    m_totalRx(0),
+    m_keepRecords(false)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+FlowSinkApplication::~FlowSinkApplication()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+FlowSinkApplication::GetRecords(std::vector<FlowSinkRecord>& records) const
+{
+    NS_LOG_FUNCTION(this);
+    records.insert(records.end(), m_records.begin(), m_records.end());
+    for (const auto& elem : m_connections)
+    {
+        records.push_back(elem.second.record);
+    }
+}
+
+void
+FlowSinkApplication::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+
+    m_socket = nullptr;
+    m_connections.clear();
+    m_records.clear();
+
+    // chain up
+    Application::DoDispose();
+}
+
+// Application Methods
+void
+FlowSinkApplication::StartApplication() // Called at time specified by Start
+{
+    NS_LOG_FUNCTION(this);
+
+    if (!m_socket)
+    {
+        m_socket = Socket::CreateSocket(GetNode(), m_tid);
+        if (m_socket->Bind(m_local) == -1)
+        {
+            NS_FATAL_ERROR("Failed to bind socket");
+        }
+        m_socket->Listen();
+        m_socket->ShutdownSend();
+    }
+
+    m_socket->SetRecvCallback(MakeCallback(&FlowSinkApplication::HandleRead, this));
+    m_socket->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address&>(),
+                                MakeCallback(&FlowSinkApplication::HandleAccept, this));
+}
+
+void
+FlowSinkApplication::StopApplication() // Called at time specified by Stop
+{
+    NS_LOG_FUNCTION(this);
+
+    // unfinished flows keep their record, marked as still open
+    for (auto& elem : m_connections)
+    {
+        Ptr<Socket> socket = elem.second.socket;
+        socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+        socket->SetCloseCallbacks(MakeNullCallback<void, Ptr<Socket>>(),
+                                  MakeNullCallback<void, Ptr<Socket>>());
+        socket->Close();
+        if (m_keepRecords)
+        {
+            m_records.push_back(elem.second.record);
+        }
+    }
+    m_connections.clear();
+
+    if (m_socket)
+    {
+        m_socket->Close();
+        m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+    }
+}
+
+void
+FlowSinkApplication::HandleRead(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    auto it = m_connections.find(PeekPointer(socket));
+    if (it == m_connections.end())
+    {
+        return;
+    }
+    FlowSinkRecord& record = it->second.record;
+
+    Ptr<Packet> packet;
+    Address from;
+    while ((packet = socket->RecvFrom(from)))
+    {
+        if (packet->GetSize() == 0)
+        { // EOF
+            break;
+        }
+
+        int64_t now = Simulator::Now().GetNanoSeconds();
+        if (!record.rxBytes)
+        {
+            record.timeFirstRx = now;
+        }
+        record.timeLastRx = now;
+        record.rxBytes += packet->GetSize();
+        m_totalRx += packet->GetSize();
+        m_rxTrace(packet, from);
+    }
+}
+
+void
+FlowSinkApplication::HandlePeerClose(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+    Release(socket, FLOW_SINK_PEER_CLOSE);
+}
+
+void
+FlowSinkApplication::HandlePeerError(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+    Release(socket, FLOW_SINK_ERROR_CLOSE);
+}
+
+void
+FlowSinkApplication::Release(Ptr<Socket> socket, uint8_t closeReason)
+{
+    auto it = m_connections.find(PeekPointer(socket));
+    if (it == m_connections.end())
+    {
+        return;
+    }
+
+    FlowSinkRecord& record = it->second.record;
+    record.closeReason = closeReason;
+    NS_LOG_INFO("At time " << Simulator::Now().As(Time::S) << " flow sink released a connection with "
+                           << record.rxBytes << " bytes, closed for reason " << +closeReason);
+
+    socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+    socket->SetCloseCallbacks(MakeNullCallback<void, Ptr<Socket>>(),
+                              MakeNullCallback<void, Ptr<Socket>>());
+    if (closeReason == FLOW_SINK_PEER_CLOSE)
+    {
+        // answer the FIN, TCP frees the socket once it is acknowledged
+        socket->Close();
+    }
+    if (m_keepRecords)
+    {
+        m_records.push_back(record);
+    }
+    m_flowTrace(record);
+    m_connections.erase(it);
+}
+
+void
+FlowSinkApplication::HandleAccept(Ptr<Socket> s, const Address& from)
+{
+    NS_LOG_FUNCTION(this << s << from);
+    s->SetRecvCallback(MakeCallback(&FlowSinkApplication::HandleRead, this));
+    s->SetCloseCallbacks(MakeCallback(&FlowSinkApplication::HandlePeerClose, this),
+                         MakeCallback(&FlowSinkApplication::HandlePeerError, this));
+
+    Connection& connection = m_connections[PeekPointer(s)];
+    connection.socket = s;
+    std::memset(&connection.record, 0, sizeof(connection.record));
+    connection.record.protocol = m_tid == TcpSocketFactory::GetTypeId() ? 6 : 0;
+
+    if (InetSocketAddress::IsMatchingType(from))
+    {
+        InetSocketAddress source = InetSocketAddress::ConvertFrom(from);
+        connection.record.sourceAddress = source.GetIpv4().Get();
+        connection.record.sourcePort = source.GetPort();
+    }
+
+    Address local;
+    s->GetSockName(local);
+    if (InetSocketAddress::IsMatchingType(local))
+    {
+        InetSocketAddress destination = InetSocketAddress::ConvertFrom(local);
+        connection.record.destinationAddress = destination.GetIpv4().Get();
+        connection.record.destinationPort = destination.GetPort();
+    }
+}
+
+} // namespace ns3
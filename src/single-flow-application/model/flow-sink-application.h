@@ -0,0 +1,146 @@
+#ifndef FLOW_SINK_APPLICATION_H
+#define FLOW_SINK_APPLICATION_H
+
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/ptr.h"
+#include "ns3/traced-callback.h"
+#include "ns3/socket.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+
+namespace ns3
+{
+
+/// First eight bytes of every sink record file
+#define FLOW_SINK_RECORD_MAGIC "SWRMSINK"
+
+/// Bumped whenever the layout of FlowSinkRecord or its file header changes
+#define FLOW_SINK_RECORD_VERSION 1
+
+/// Values of FlowSinkRecord::closeReason
+#define FLOW_SINK_OPEN 0            //!< Still open when the records were taken
+#define FLOW_SINK_PEER_CLOSE 1      //!< The sender closed the connection
+#define FLOW_SINK_ERROR_CLOSE 2     //!< The connection was reset or timed out
+
+/**
+ * What a FlowSinkApplication saw of one connection. Same conventions as
+ * MpiFlowRecord: host byte order, no padding, times in nanoseconds. The
+ * receiver side FCT of a flow is timeLastRx - timeFirstRx.
+ */
+struct FlowSinkRecord
+{
+    uint32_t sourceAddress;
+    uint32_t destinationAddress;
+    uint16_t sourcePort;
+    uint16_t destinationPort;
+    uint8_t protocol;
+    uint8_t closeReason;            //!< FLOW_SINK_OPEN, FLOW_SINK_PEER_CLOSE or FLOW_SINK_ERROR_CLOSE
+    uint8_t reserved[2];
+    uint64_t rxBytes;
+    int64_t timeFirstRx;            //!< First byte received, zero if none was
+    int64_t timeLastRx;             //!< Last byte received, zero if none was
+};
+
+static_assert(sizeof(FlowSinkRecord) == 40, "FlowSinkRecord must stay packed, readers depend on it");
+
+/// Header at the start of every sink record file
+struct FlowSinkRecordFileHeader
+{
+    char magic[8];                  //!< FLOW_SINK_RECORD_MAGIC, not null terminated
+    uint32_t version;               //!< FLOW_SINK_RECORD_VERSION
+    uint32_t recordSize;            //!< sizeof(FlowSinkRecord)
+    uint32_t systemId;              //!< Rank that wrote the file
+    uint32_t reserved;
+    uint64_t numRecords;
+};
+
+static_assert(sizeof(FlowSinkRecordFileHeader) == 32, "FlowSinkRecordFileHeader must stay packed");
+
+/**
+ * Packet sink for one flow per connection. Accepted sockets are kept only
+ * while their connection is open: once the sender closes it, its bytes and
+ * first and last byte times are reported as a FlowSinkRecord on the Flow
+ * trace and the socket is released, so the sink holds as many sockets as
+ * there are active flows instead of one per flow of the run like PacketSink.
+ *
+ * With KeepRecords the records are also kept for GetRecords, which gives
+ * receiver side FCTs without a flow monitor at the cost of one record per
+ * flow of the run. A released socket is closed in turn, TCP frees it once
+ * its FIN is acknowledged.
+ */
+class FlowSinkApplication : public Application
+{
+  public:
+    static TypeId GetTypeId();
+
+    FlowSinkApplication();
+
+    ~FlowSinkApplication() override;
+
+    /// Bytes received so far
+    uint64_t GetTotalRx() const {
+      return m_totalRx;
+    }
+
+    /// Connections accepted and not closed yet
+    uint32_t GetNConnections() const {
+      return m_connections.size();
+    }
+
+    /// Append the records of the closed connections kept with KeepRecords, then those of the open ones
+    void GetRecords(std::vector<FlowSinkRecord>& records) const;
+
+    /**
+     * TracedCallback signature for closed connections
+     *
+     * \param [in] record What the sink saw of the connection
+     */
+    typedef void (*FlowTracedCallback)(const FlowSinkRecord& record);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    // inherited from Application base class.
+    void StartApplication() override;
+    void StopApplication() override;
+
+    /// An accepted socket and what was received on it so far
+    struct Connection
+    {
+        Ptr<Socket> socket;
+        FlowSinkRecord record;
+    };
+
+    void HandleRead(Ptr<Socket> socket);
+    void HandleAccept(Ptr<Socket> socket, const Address& from);
+    void HandlePeerClose(Ptr<Socket> socket);
+    void HandlePeerError(Ptr<Socket> socket);
+    void Release(Ptr<Socket> socket, uint8_t closeReason);
+
+    Ptr<Socket> m_socket;                //!< Listening socket
+    Address m_local;                     //!< Local address to bind to
+    TypeId m_tid;                        //!< Protocol TypeId
+    uint64_t m_totalRx;                  //!< Total bytes received
+    bool m_keepRecords;                  //!< Keep the records of the closed connections
+
+    /// Accepted sockets that are still open
+    std::unordered_map<Socket*, Connection> m_connections;
+    /// Records of the closed connections
+    std::vector<FlowSinkRecord> m_records;
+
+    /// Traced Callback: received packets, source address.
+    TracedCallback<Ptr<const Packet>, const Address&> m_rxTrace;
+
+    /// Traced Callback: a connection was closed and released
+    TracedCallback<const FlowSinkRecord&> m_flowTrace;
+};
+
+} // namespace ns3
+
+#endif /* FLOW_SINK_APPLICATION_H */
@@ -0,0 +1,225 @@
+#include "message-sink-application.h"
+
+#include "ns3/address.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/inet6-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/socket-factory.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("MessageSinkApplication");
+
+NS_OBJECT_ENSURE_REGISTERED(MessageSinkApplication);
+
+TypeId
+MessageSinkApplication::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::MessageSinkApplication")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<MessageSinkApplication>()
+            .AddAttribute("Local",
+                        "The Address on which to Bind the rx socket.",
+                        AddressValue(),
+                        MakeAddressAccessor(&MessageSinkApplication::m_local),
+                        MakeAddressChecker())
+            .AddAttribute("Protocol",
+                        "The type id of the connection-oriented protocol to use for the rx socket.",
+                        TypeIdValue(TcpSocketFactory::GetTypeId()),
+                        MakeTypeIdAccessor(&MessageSinkApplication::m_tid),
+                        MakeTypeIdChecker())
+            .AddTraceSource("Rx",
+                            "A packet has been received",
+                            MakeTraceSourceAccessor(&MessageSinkApplication::m_rxTrace),
+                            "ns3::Packet::AddressTracedCallback")
+            .AddTraceSource("Message",
+                            "The last byte of a message has been received",
+                            MakeTraceSourceAccessor(&MessageSinkApplication::m_messageTrace),
+                            "ns3::MessageSinkApplication::MessageTracedCallback");
+    return tid;
+}
+
+MessageSinkApplication::MessageSinkApplication()
+    : m_socket(nullptr),
+    m_totalRx(0),
+    m_totalMessages(0)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+MessageSinkApplication::~MessageSinkApplication()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+MessageSinkApplication::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+
+    m_socket = nullptr;
+    m_connections.clear();
+
+    // chain up
+    Application::DoDispose();
+}
+
+// Application Methods
+void
+MessageSinkApplication::StartApplication() // Called at time specified by Start
+{
+    NS_LOG_FUNCTION(this);
+
+    if (!m_socket)
+    {
+        m_socket = Socket::CreateSocket(GetNode(), m_tid);
+        if (m_socket->Bind(m_local) == -1)
+        {
+            NS_FATAL_ERROR("Failed to bind socket");
+        }
+        m_socket->Listen();
+        m_socket->ShutdownSend();
+    }
+
+    m_socket->SetRecvCallback(MakeCallback(&MessageSinkApplication::HandleRead, this));
+    m_socket->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address&>(),
+                                MakeCallback(&MessageSinkApplication::HandleAccept, this));
+    m_socket->SetCloseCallbacks(MakeCallback(&MessageSinkApplication::HandlePeerClose, this),
+                                MakeCallback(&MessageSinkApplication::HandlePeerClose, this));
+}
+
+void
+MessageSinkApplication::StopApplication() // Called at time specified by Stop
+{
+    NS_LOG_FUNCTION(this);
+
+    for (auto& elem : m_connections)
+    {
+        elem.second.socket->Close();
+    }
+    m_connections.clear();
+
+    if (m_socket)
+    {
+        m_socket->Close();
+        m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+    }
+}
+
+void
+MessageSinkApplication::HandleRead(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    auto it = m_connections.find(PeekPointer(socket));
+    if (it == m_connections.end())
+    {
+        return;
+    }
+
+    Ptr<Packet> packet;
+    Address from;
+    while ((packet = socket->RecvFrom(from)))
+    {
+        if (packet->GetSize() == 0)
+        { // EOF
+            break;
+        }
+        m_totalRx += packet->GetSize();
+        m_rxTrace(packet, from);
+        Consume(it->second, packet);
+    }
+}
+
+void
+MessageSinkApplication::Consume(Connection& connection, Ptr<Packet> packet)
+{
+    // same size for every header, only its fields change
+    const uint32_t headerSize = connection.current.GetSerializedSize();
+    NS_ASSERT(headerSize <= sizeof(connection.header));
+
+    while (packet->GetSize() > 0)
+    {
+        if (connection.headerBytes < headerSize)
+        {
+            // a header may straddle two segments, collect its bytes until it is whole
+            uint32_t n = std::min(headerSize - connection.headerBytes, packet->GetSize());
+            packet->CopyData(connection.header + connection.headerBytes, n);
+            packet->RemoveAtStart(n);
+            connection.headerBytes += n;
+            if (connection.headerBytes < headerSize)
+            {
+                return;
+            }
+
+            Ptr<Packet> raw = Create<Packet>(connection.header, headerSize);
+            raw->RemoveHeader(connection.current);
+            NS_ABORT_MSG_IF(connection.current.GetSize() < headerSize,
+                            "Malformed message frame of " << connection.current.GetSize() << " bytes");
+            connection.remaining = connection.current.GetSize() - headerSize;
+        }
+
+        uint64_t n = std::min<uint64_t>(connection.remaining, packet->GetSize());
+        connection.remaining -= n;
+        if (connection.remaining > 0)
+        {
+            return;
+        }
+
+        NS_LOG_INFO("At time " << Simulator::Now().As(Time::S) << " message sink received message "
+                               << connection.current.GetSeq() << " of " << connection.current.GetSize()
+                               << " bytes, queued at " << connection.current.GetTs().As(Time::S));
+        m_totalMessages++;
+        m_messageTrace(connection.current, connection.from);
+        connection.headerBytes = 0;
+
+        if (n == packet->GetSize())
+        {
+            return;
+        }
+        packet->RemoveAtStart(n);
+    }
+}
+
+void
+MessageSinkApplication::HandlePeerClose(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    auto it = m_connections.find(PeekPointer(socket));
+    if (it == m_connections.end())
+    {
+        return;
+    }
+    if (it->second.headerBytes)
+    {
+        NS_LOG_WARN("Connection closed in the middle of message " << it->second.current.GetSeq());
+    }
+    m_connections.erase(it);
+}
+
+void
+MessageSinkApplication::HandleAccept(Ptr<Socket> s, const Address& from)
+{
+    NS_LOG_FUNCTION(this << s << from);
+    s->SetRecvCallback(MakeCallback(&MessageSinkApplication::HandleRead, this));
+    s->SetCloseCallbacks(MakeCallback(&MessageSinkApplication::HandlePeerClose, this),
+                         MakeCallback(&MessageSinkApplication::HandlePeerClose, this));
+
+    Connection& connection = m_connections[PeekPointer(s)];
+    connection.socket = s;
+    connection.from = from;
+    connection.headerBytes = 0;
+    connection.remaining = 0;
+}
+
+} // namespace ns3
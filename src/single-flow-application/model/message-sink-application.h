@@ -0,0 +1,104 @@
+#ifndef MESSAGE_SINK_APPLICATION_H
+#define MESSAGE_SINK_APPLICATION_H
+
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/ptr.h"
+#include "ns3/seq-ts-size-header.h"
+#include "ns3/traced-callback.h"
+#include "ns3/socket.h"
+
+#include <stdint.h>
+#include <unordered_map>
+
+
+namespace ns3
+{
+
+/**
+ * Receiving end of PersistentFlowApplication: accepts connections on Local
+ * and splits each byte stream back into the SeqTsSizeHeader framed messages
+ * it carries, firing the Message trace as the last byte of each one
+ * arrives.
+ *
+ * Unlike PacketSink with EnableSeqTsSizeHeader, payloads are counted and
+ * dropped instead of being reassembled, so a connection costs a header
+ * worth of state whatever the size of its messages. Connections are
+ * forgotten once the peer closes them.
+ */
+class MessageSinkApplication : public Application
+{
+  public:
+    static TypeId GetTypeId();
+
+    MessageSinkApplication();
+
+    ~MessageSinkApplication() override;
+
+    /// Bytes received so far, headers included
+    uint64_t GetTotalRx() const {
+      return m_totalRx;
+    }
+
+    /// Messages received in full so far
+    uint64_t GetTotalMessages() const {
+      return m_totalMessages;
+    }
+
+    /// Connections accepted and not closed yet
+    uint32_t GetNConnections() const {
+      return m_connections.size();
+    }
+
+    /**
+     * TracedCallback signature for completed messages
+     *
+     * \param [in] header The frame header, with the time the sender queued the message
+     * \param [in] from The address of the sender
+     */
+    typedef void (*MessageTracedCallback)(const SeqTsSizeHeader& header, const Address& from);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    // inherited from Application base class.
+    void StartApplication() override;
+    void StopApplication() override;
+
+    /// Where a connection is in its stream of frames
+    struct Connection
+    {
+        Ptr<Socket> socket;             //!< The accepted socket
+        Address from;                   //!< Address of the sender
+        uint8_t header[32];             //!< Header bytes of the current frame received so far
+        uint32_t headerBytes;           //!< Valid bytes in header
+        SeqTsSizeHeader current;        //!< Header of the current frame, once complete
+        uint64_t remaining;             //!< Payload bytes of the current frame still to come
+    };
+
+    void HandleRead(Ptr<Socket> socket);
+    void HandleAccept(Ptr<Socket> socket, const Address& from);
+    void HandlePeerClose(Ptr<Socket> socket);
+    void Consume(Connection& connection, Ptr<Packet> packet);
+
+    Ptr<Socket> m_socket;                //!< Listening socket
+    Address m_local;                     //!< Local address to bind to
+    TypeId m_tid;                        //!< Protocol TypeId
+    uint64_t m_totalRx;                  //!< Total bytes received
+    uint64_t m_totalMessages;            //!< Total messages received
+
+    /// Accepted sockets --> their framing state
+    std::unordered_map<Socket*, Connection> m_connections;
+
+    /// Traced Callback: received packets, source address.
+    TracedCallback<Ptr<const Packet>, const Address&> m_rxTrace;
+
+    /// Traced Callback: the last byte of a message arrived
+    TracedCallback<const SeqTsSizeHeader&, const Address&> m_messageTrace;
+};
+
+} // namespace ns3
+
+#endif /* MESSAGE_SINK_APPLICATION_H */
@@ -0,0 +1,221 @@
+#include "multi-flow-source-application.h"
+
+#include "ns3/abort.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/inet6-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/socket-factory.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/uinteger.h"
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("MultiFlowSourceApplication");
+
+NS_OBJECT_ENSURE_REGISTERED(MultiFlowSourceApplication);
+
+TypeId
+MultiFlowSourceApplication::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::MultiFlowSourceApplication")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<MultiFlowSourceApplication>()
+            .AddAttribute("DataRate",
+                        "The data rate towards each destination.",
+                        DataRateValue(DataRate("500kb/s")),
+                        MakeDataRateAccessor(&MultiFlowSourceApplication::m_cbrRate),
+                        MakeDataRateChecker())
+            .AddAttribute("PacketSize",
+                        "The size of packets sent to each destination",
+                        UintegerValue(512),
+                        MakeUintegerAccessor(&MultiFlowSourceApplication::m_pktSize),
+                        MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("Protocol",
+                        "The type of protocol to use. This should be "
+                        "a subclass of ns3::SocketFactory",
+                        TypeIdValue(TcpSocketFactory::GetTypeId()),
+                        MakeTypeIdAccessor(&MultiFlowSourceApplication::m_tid),
+                        MakeTypeIdChecker())
+            .AddTraceSource("Tx",
+                            "A new packet is created and is sent",
+                            MakeTraceSourceAccessor(&MultiFlowSourceApplication::m_txTrace),
+                            "ns3::Packet::TracedCallback");
+    return tid;
+}
+
+MultiFlowSourceApplication::MultiFlowSourceApplication()
+    : m_next(0),
+    m_intervalNum(0),
+    m_intervalDen(1),
+    m_intervalCarry(0),
+    m_totBytes(0)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+MultiFlowSourceApplication::~MultiFlowSourceApplication()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+MultiFlowSourceApplication::AddDestination(const Address& destination)
+{
+    NS_LOG_FUNCTION(this << destination);
+    NS_ABORT_MSG_IF(!m_sockets.empty(), "Destinations must be added before the application starts");
+    m_destinations.push_back(Destination{destination, nullptr, false});
+}
+
+void
+MultiFlowSourceApplication::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+
+    Simulator::Cancel(m_sendEvent);
+    m_destinations.clear();
+    m_sockets.clear();
+
+    // chain up
+    Application::DoDispose();
+}
+
+// Application Methods
+void
+MultiFlowSourceApplication::StartApplication() // Called at time specified by Start
+{
+    NS_LOG_FUNCTION(this);
+
+    if (m_destinations.empty())
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < m_destinations.size(); i++)
+    {
+        Destination& destination = m_destinations[i];
+        if (destination.socket)
+        {
+            continue;
+        }
+
+        destination.socket = Socket::CreateSocket(GetNode(), m_tid);
+        int ret = -1;
+        if (Inet6SocketAddress::IsMatchingType(destination.peer))
+        {
+            ret = destination.socket->Bind6();
+        }
+        else if (InetSocketAddress::IsMatchingType(destination.peer))
+        {
+            ret = destination.socket->Bind();
+        }
+
+        if (ret == -1)
+        {
+            NS_FATAL_ERROR("Failed to bind socket");
+        }
+
+        m_sockets[PeekPointer(destination.socket)] = i;
+        destination.socket->SetConnectCallback(
+            MakeCallback(&MultiFlowSourceApplication::ConnectionSucceeded, this),
+            MakeCallback(&MultiFlowSourceApplication::ConnectionFailed, this));
+        destination.socket->Connect(destination.peer);
+        destination.socket->SetAllowBroadcast(false);
+        destination.socket->ShutdownRecv();
+    }
+
+    // the ticks of all destinations share one timer, in time steps of the
+    // current resolution: pktSize * 8 / (rate * n) seconds
+    m_intervalNum = static_cast<uint64_t>(m_pktSize) * 8 * Seconds(1).GetTimeStep();
+    m_intervalDen = m_cbrRate.GetBitRate() * m_destinations.size();
+    m_intervalCarry = 0;
+    NS_ABORT_MSG_IF(m_intervalDen == 0, "MultiFlowSourceApplication needs a DataRate above 0");
+    NS_ABORT_MSG_IF(m_intervalNum < m_intervalDen,
+                    "MultiFlowSourceApplication interval of " << m_pktSize << " bytes at "
+                    << m_cbrRate << " to " << m_destinations.size()
+                    << " destinations is below the time resolution");
+    NS_LOG_LOGIC("interval = " << m_intervalNum / m_intervalDen << " time steps");
+
+    Simulator::Cancel(m_sendEvent);
+    m_sendEvent = Simulator::Schedule(NextInterval(), &MultiFlowSourceApplication::SendPacket, this);
+}
+
+void
+MultiFlowSourceApplication::StopApplication() // Called at time specified by Stop
+{
+    NS_LOG_FUNCTION(this);
+
+    Simulator::Cancel(m_sendEvent);
+    for (auto& destination : m_destinations)
+    {
+        if (destination.socket)
+        {
+            destination.socket->Close();
+            destination.socket = nullptr;
+        }
+        destination.connected = false;
+    }
+    m_sockets.clear();
+}
+
+void
+MultiFlowSourceApplication::SendPacket()
+{
+    NS_LOG_FUNCTION(this);
+
+    Destination& destination = m_destinations[m_next];
+    if (++m_next == m_destinations.size())
+    {
+        m_next = 0;
+    }
+
+    if (destination.connected && destination.socket->GetTxAvailable() >= m_pktSize)
+    {
+        Ptr<Packet> packet = Create<Packet>(m_pktSize);
+        if (destination.socket->Send(packet) > 0)
+        {
+            m_txTrace(packet);
+            m_totBytes += m_pktSize;
+        }
+    }
+    else
+    {
+        NS_LOG_DEBUG("Skipping a tick of a destination that can not take a packet");
+    }
+
+    m_sendEvent = Simulator::Schedule(NextInterval(), &MultiFlowSourceApplication::SendPacket, this);
+}
+
+Time
+MultiFlowSourceApplication::NextInterval()
+{
+    uint64_t steps = m_intervalNum + m_intervalCarry;
+    m_intervalCarry = steps % m_intervalDen;
+    return TimeStep(steps / m_intervalDen);
+}
+
+void
+MultiFlowSourceApplication::ConnectionSucceeded(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    auto it = m_sockets.find(PeekPointer(socket));
+    if (it != m_sockets.end())
+    {
+        m_destinations[it->second].connected = true;
+    }
+}
+
+void
+MultiFlowSourceApplication::ConnectionFailed(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+    NS_FATAL_ERROR("Can't connect");
+}
+
+} // namespace ns3
@@ -0,0 +1,97 @@
+#ifndef MULTI_FLOW_SOURCE_APPLICATION_H
+#define MULTI_FLOW_SOURCE_APPLICATION_H
+
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/data-rate.h"
+#include "ns3/event-id.h"
+#include "ns3/ptr.h"
+#include "ns3/traced-callback.h"
+#include "ns3/socket.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+
+namespace ns3
+{
+
+/**
+ * Constant bit rate source towards many destinations at once, e.g. every
+ * other host of an all-to-all pattern. It replaces one OnOffApplication per
+ * destination with a single application per host.
+ *
+ * One connection is opened per destination, but a single timer drives them
+ * all: each tick sends one packet to the next destination in round robin,
+ * at DataRate times the number of destinations, so every destination is
+ * offered DataRate. The interval between ticks is kept exact by carrying
+ * the remainder that does not fit the time resolution from tick to tick.
+ * Like OnOffApplication, a tick whose connection is not up yet or has a
+ * full send buffer is lost rather than caught up later.
+ */
+class MultiFlowSourceApplication : public Application
+{
+  public:
+    static TypeId GetTypeId();
+
+    MultiFlowSourceApplication();
+
+    ~MultiFlowSourceApplication() override;
+
+    /// Add a destination, before the application starts
+    void AddDestination(const Address& destination);
+
+    uint32_t GetNDestinations() const {
+      return m_destinations.size();
+    }
+
+    /// Total bytes sent so far, to all destinations
+    uint64_t GetTotalBytes() const {
+      return m_totBytes;
+    }
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    // inherited from Application base class.
+    void StartApplication() override;
+    void StopApplication() override;
+
+    void SendPacket();
+    /// Time to the next tick, carrying the remainder of the exact interval
+    Time NextInterval();
+    void ConnectionSucceeded(Ptr<Socket> socket);
+    void ConnectionFailed(Ptr<Socket> socket);
+
+    /// A destination and its connection
+    struct Destination
+    {
+        Address peer;
+        Ptr<Socket> socket;
+        bool connected;
+    };
+
+    std::vector<Destination> m_destinations;
+    /// Sockets --> index in m_destinations, for the connect callbacks
+    std::unordered_map<Socket*, uint32_t> m_sockets;
+    uint32_t m_next;                     //!< Destination of the next tick
+    DataRate m_cbrRate;                  //!< Rate towards each destination
+    uint32_t m_pktSize;                  //!< Size of packets
+    TypeId m_tid;                        //!< Type of the socket used
+    /// Time between two ticks is m_intervalNum / m_intervalDen time steps, set on start
+    uint64_t m_intervalNum;
+    uint64_t m_intervalDen;
+    uint64_t m_intervalCarry;            //!< Remainder of the steps scheduled so far
+    uint64_t m_totBytes;                 //!< Total bytes sent so far
+    EventId m_sendEvent;                 //!< Event id of pending "send packet" event
+
+    /// Traced Callback: transmitted packets.
+    TracedCallback<Ptr<const Packet>> m_txTrace;
+};
+
+} // namespace ns3
+
+#endif /* MULTI_FLOW_SOURCE_APPLICATION_H */
@@ -0,0 +1,284 @@
+#include "persistent-flow-application.h"
+
+#include "ns3/address.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/inet6-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/socket-factory.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("PersistentFlowApplication");
+
+NS_OBJECT_ENSURE_REGISTERED(PersistentFlowApplication);
+
+TypeId
+PersistentFlowApplication::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::PersistentFlowApplication")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<PersistentFlowApplication>()
+            .AddAttribute("PacketSize",
+                        "The largest write into the socket. The write that starts a message "
+                        "holds at least its whole header.",
+                        UintegerValue(6000),
+                        MakeUintegerAccessor(&PersistentFlowApplication::m_pktSize),
+                        MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("Remote",
+                        "The address of the destination",
+                        AddressValue(),
+                        MakeAddressAccessor(&PersistentFlowApplication::m_peer),
+                        MakeAddressChecker())
+            .AddAttribute("Local",
+                        "The Address on which to bind the socket. If not set, it is generated "
+                        "automatically.",
+                        AddressValue(),
+                        MakeAddressAccessor(&PersistentFlowApplication::m_local),
+                        MakeAddressChecker())
+            .AddAttribute("Protocol",
+                        "The type of connection-oriented protocol to use. This should be "
+                        "a subclass of ns3::SocketFactory",
+                        TypeIdValue(TcpSocketFactory::GetTypeId()),
+                        MakeTypeIdAccessor(&PersistentFlowApplication::m_tid),
+                        MakeTypeIdChecker())
+            .AddTraceSource("Tx",
+                            "A new packet is created and is sent",
+                            MakeTraceSourceAccessor(&PersistentFlowApplication::m_txTrace),
+                            "ns3::Packet::TracedCallback")
+            .AddTraceSource("Message",
+                            "The last byte of a message was handed to the socket",
+                            MakeTraceSourceAccessor(&PersistentFlowApplication::m_messageTrace),
+                            "ns3::PersistentFlowApplication::MessageTracedCallback");
+    return tid;
+}
+
+PersistentFlowApplication::PersistentFlowApplication()
+    : m_socket(nullptr),
+    m_connected(false),
+    m_offset(0),
+    m_totBytes(0)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+PersistentFlowApplication::~PersistentFlowApplication()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+PersistentFlowApplication::SendMessage(uint32_t id, uint64_t size)
+{
+    NS_LOG_FUNCTION(this << id << size);
+
+    // stamped now, so the receiver's FCT includes the wait behind earlier messages
+    SeqTsSizeHeader header;
+    header.SetSeq(id);
+    header.SetSize(size + header.GetSerializedSize());
+    m_pending.push_back(header);
+
+    if (m_pending.size() == 1)
+    {
+        SendPending();
+    }
+}
+
+Ptr<Socket>
+PersistentFlowApplication::GetSocket() const
+{
+    NS_LOG_FUNCTION(this);
+    return m_socket;
+}
+
+void
+PersistentFlowApplication::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+
+    m_socket = nullptr;
+    m_pending.clear();
+
+    // chain up
+    Application::DoDispose();
+}
+
+// Application Methods
+void
+PersistentFlowApplication::StartApplication() // Called at time specified by Start
+{
+    NS_LOG_FUNCTION(this);
+
+    if (m_socket)
+    {
+        return;
+    }
+
+    m_socket = Socket::CreateSocket(GetNode(), m_tid);
+    NS_ABORT_MSG_IF(m_socket->GetSocketType() != Socket::NS3_SOCK_STREAM &&
+                        m_socket->GetSocketType() != Socket::NS3_SOCK_SEQPACKET,
+                    "Using PersistentFlowApplication with an incompatible socket type. "
+                    "It requires SOCK_STREAM or SOCK_SEQPACKET.");
+
+    int ret = -1;
+    if (!m_local.IsInvalid())
+    {
+        NS_ABORT_MSG_IF((Inet6SocketAddress::IsMatchingType(m_peer) &&
+                        InetSocketAddress::IsMatchingType(m_local)) ||
+                            (InetSocketAddress::IsMatchingType(m_peer) &&
+                            Inet6SocketAddress::IsMatchingType(m_local)),
+                        "Incompatible peer and local address IP version");
+        ret = m_socket->Bind(m_local);
+    }
+    else if (Inet6SocketAddress::IsMatchingType(m_peer))
+    {
+        ret = m_socket->Bind6();
+    }
+    else if (InetSocketAddress::IsMatchingType(m_peer))
+    {
+        ret = m_socket->Bind();
+    }
+
+    if (ret == -1)
+    {
+        NS_FATAL_ERROR("Failed to bind socket");
+    }
+
+    m_socket->SetConnectCallback(MakeCallback(&PersistentFlowApplication::ConnectionSucceeded, this),
+                                MakeCallback(&PersistentFlowApplication::ConnectionFailed, this));
+    m_socket->SetSendCallback(MakeCallback(&PersistentFlowApplication::DataSent, this));
+    m_socket->SetCloseCallbacks(MakeCallback(&PersistentFlowApplication::ConnectionClosed, this),
+                               MakeCallback(&PersistentFlowApplication::ConnectionClosed, this));
+    m_socket->Connect(m_peer);
+    m_socket->ShutdownRecv();
+}
+
+void
+PersistentFlowApplication::StopApplication() // Called at time specified by Stop
+{
+    NS_LOG_FUNCTION(this);
+
+    if (!m_pending.empty())
+    {
+        NS_LOG_WARN("PersistentFlowApplication stopped with " << m_pending.size() << " messages pending");
+    }
+    m_pending.clear();
+    m_offset = 0;
+
+    if (m_socket)
+    {
+        // whatever is buffered is still sent before the FIN
+        m_socket->SetSendCallback(MakeNullCallback<void, Ptr<Socket>, uint32_t>());
+        m_socket->SetCloseCallbacks(MakeNullCallback<void, Ptr<Socket>>(),
+                                   MakeNullCallback<void, Ptr<Socket>>());
+        m_socket->Close();
+        m_socket = nullptr;
+    }
+    m_connected = false;
+}
+
+void
+PersistentFlowApplication::SendPending()
+{
+    NS_LOG_FUNCTION(this);
+
+    while (m_connected && !m_pending.empty())
+    {
+        const SeqTsSizeHeader& header = m_pending.front();
+        uint32_t headerSize = header.GetSerializedSize();
+        uint64_t left = header.GetSize() - m_offset;
+
+        uint32_t size = std::min<uint64_t>(m_pktSize, left);
+        if (m_offset == 0)
+        {
+            // the header is never split over two writes, the frame is at least as large
+            size = std::min<uint64_t>(std::max(size, headerSize), left);
+        }
+        if (m_socket->GetTxAvailable() < size)
+        {
+            // DataSent picks up from here once TCP frees some of the buffer
+            return;
+        }
+
+        Ptr<Packet> packet;
+        if (m_offset == 0)
+        {
+            packet = Create<Packet>(size - headerSize);
+            packet->AddHeader(header);
+        }
+        else
+        {
+            packet = Create<Packet>(size);
+        }
+
+        int actual = m_socket->Send(packet);
+        if (actual <= 0)
+        {
+            NS_LOG_DEBUG("Unable to send " << size << " bytes, waiting for buffer space");
+            return;
+        }
+        m_txTrace(packet);
+        m_offset += actual;
+        m_totBytes += actual;
+
+        if (m_offset == header.GetSize())
+        {
+            NS_LOG_INFO("At time " << Simulator::Now().As(Time::S) << " persistent flow application handed message "
+                                   << header.GetSeq() << " of " << header.GetSize() << " bytes to the socket");
+            m_messageTrace(header);
+            m_pending.pop_front();
+            m_offset = 0;
+        }
+    }
+}
+
+void
+PersistentFlowApplication::DataSent(Ptr<Socket> socket, uint32_t available)
+{
+    NS_LOG_FUNCTION(this << socket << available);
+    SendPending();
+}
+
+void
+PersistentFlowApplication::ConnectionSucceeded(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    m_connected = true;
+    SendPending();
+}
+
+void
+PersistentFlowApplication::ConnectionFailed(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+    NS_FATAL_ERROR("Can't connect");
+}
+
+void
+PersistentFlowApplication::ConnectionClosed(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    // the peer went away, e.g. its sink stopped, messages that were not sent are lost
+    if (!m_pending.empty())
+    {
+        NS_LOG_WARN("Connection of PersistentFlowApplication closed with " << m_pending.size()
+                                                                        << " messages pending");
+    }
+    m_pending.clear();
+    m_offset = 0;
+    m_connected = false;
+    m_socket = nullptr;
+}
+
+} // namespace ns3
@@ -0,0 +1,94 @@
+#ifndef PERSISTENT_FLOW_APPLICATION_H
+#define PERSISTENT_FLOW_APPLICATION_H
+
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/ptr.h"
+#include "ns3/seq-ts-size-header.h"
+#include "ns3/traced-callback.h"
+#include "ns3/socket.h"
+
+#include <deque>
+#include <stdint.h>
+
+
+namespace ns3
+{
+
+/**
+ * Sends flows as messages over one long-lived connection to Remote, like an
+ * RPC client keeps a channel open to each of its servers.
+ *
+ * Every message is framed by a SeqTsSizeHeader holding its id, the time it
+ * was queued and its size including the header, so the receiver can tell
+ * where each message ends, see MessageSinkApplication. Messages queue up in
+ * order and are written back to back as fast as the send buffer frees up,
+ * without any timer. The connection is opened when the application starts
+ * and stays open until it stops.
+ */
+class PersistentFlowApplication : public Application
+{
+  public:
+    static TypeId GetTypeId();
+
+    PersistentFlowApplication();
+
+    ~PersistentFlowApplication() override;
+
+    /**
+     * Queue a message of `size` payload bytes, sent after all the messages
+     * queued before it. Can be called before the connection is up.
+     */
+    void SendMessage(uint32_t id, uint64_t size);
+
+    /// Messages queued or partially written
+    uint32_t GetNPendingMessages() const {
+      return m_pending.size();
+    }
+
+    Ptr<Socket> GetSocket() const;
+
+    /**
+     * TracedCallback signature for messages handed to the socket
+     *
+     * \param [in] header The frame header, with the time the message was queued
+     */
+    typedef void (*MessageTracedCallback)(const SeqTsSizeHeader& header);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    // inherited from Application base class.
+    void StartApplication() override;
+    void StopApplication() override;
+
+    void SendPending();
+    void DataSent(Ptr<Socket> socket, uint32_t available);
+    void ConnectionSucceeded(Ptr<Socket> socket);
+    void ConnectionFailed(Ptr<Socket> socket);
+    void ConnectionClosed(Ptr<Socket> socket);
+
+    Ptr<Socket> m_socket;                //!< The connection, null before start and after stop
+    Address m_peer;                      //!< Peer address
+    Address m_local;                     //!< Local address to bind to
+    TypeId m_tid;                        //!< Type of the socket used
+    uint32_t m_pktSize;                  //!< Largest write into the socket
+    bool m_connected;                    //!< True if connected
+
+    /// Frames waiting for the socket, the front one is partially written
+    std::deque<SeqTsSizeHeader> m_pending;
+    uint64_t m_offset;                   //!< Bytes of the front frame already written
+    uint64_t m_totBytes;                 //!< Total bytes sent so far, headers included
+
+    /// Traced Callback: transmitted packets.
+    TracedCallback<Ptr<const Packet>> m_txTrace;
+
+    /// Traced Callback: the last byte of a message was handed to the socket
+    TracedCallback<const SeqTsSizeHeader&> m_messageTrace;
+};
+
+} // namespace ns3
+
+#endif /* PERSISTENT_FLOW_APPLICATION_H */
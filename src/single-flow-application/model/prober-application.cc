@@ -0,0 +1,193 @@
+#include "prober-application.h"
+
+#include "ns3/abort.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/simulator.h"
+#include "ns3/socket-factory.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/uinteger.h"
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("ProberApplication");
+
+NS_OBJECT_ENSURE_REGISTERED(ProberApplication);
+
+/// Set in the sequence number of replies, the rest is the position of the destination
+static const uint32_t PROBE_REPLY = 0x80000000;
+
+TypeId
+ProberApplication::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::ProberApplication")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<ProberApplication>()
+            .AddAttribute("Port",
+                        "Port of the probers, on all hosts",
+                        UintegerValue(9),
+                        MakeUintegerAccessor(&ProberApplication::m_port),
+                        MakeUintegerChecker<uint16_t>())
+            .AddAttribute("PacketSize",
+                        "Size of probes and replies, the SeqTsHeader included",
+                        UintegerValue(64),
+                        MakeUintegerAccessor(&ProberApplication::m_pktSize),
+                        MakeUintegerChecker<uint32_t>(12))
+            .AddAttribute("Interval",
+                        "Time between two probes",
+                        TimeValue(MicroSeconds(10)),
+                        MakeTimeAccessor(&ProberApplication::m_interval),
+                        MakeTimeChecker())
+            .AddTraceSource("Rtt",
+                            "A destination replied to its probe",
+                            MakeTraceSourceAccessor(&ProberApplication::m_rttTrace),
+                            "ns3::ProberApplication::RttTracedCallback");
+    return tid;
+}
+
+ProberApplication::ProberApplication()
+    : m_socket(nullptr),
+    m_next(0),
+    m_replies(0)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+ProberApplication::~ProberApplication()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+ProberApplication::AddDestination(const Address& destination, uint32_t id)
+{
+    NS_LOG_FUNCTION(this << destination << id);
+    NS_ABORT_MSG_IF(m_destinations.size() >= PROBE_REPLY, "Too many destinations for one prober");
+    m_destinations.push_back(Destination{destination, id, Time(0), false});
+}
+
+void
+ProberApplication::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+
+    Simulator::Cancel(m_sendEvent);
+    m_socket = nullptr;
+    m_destinations.clear();
+
+    // chain up
+    Application::DoDispose();
+}
+
+// Application Methods
+void
+ProberApplication::StartApplication() // Called at time specified by Start
+{
+    NS_LOG_FUNCTION(this);
+
+    if (!m_socket)
+    {
+        m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+        if (m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), m_port)) == -1)
+        {
+            NS_FATAL_ERROR("Failed to bind socket");
+        }
+        m_socket->SetAllowBroadcast(false);
+    }
+    m_socket->SetRecvCallback(MakeCallback(&ProberApplication::HandleRead, this));
+
+    Simulator::Cancel(m_sendEvent);
+    if (m_next < m_destinations.size())
+    {
+        m_sendEvent = Simulator::ScheduleNow(&ProberApplication::SendProbe, this);
+    }
+}
+
+void
+ProberApplication::StopApplication() // Called at time specified by Stop
+{
+    NS_LOG_FUNCTION(this);
+
+    Simulator::Cancel(m_sendEvent);
+    if (m_socket)
+    {
+        m_socket->Close();
+        m_socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+    }
+}
+
+void
+ProberApplication::SendProbe()
+{
+    NS_LOG_FUNCTION(this);
+
+    Destination& destination = m_destinations[m_next];
+    SeqTsHeader header;
+    header.SetSeq(m_next);
+    Ptr<Packet> packet = Create<Packet>(m_pktSize - header.GetSerializedSize());
+    packet->AddHeader(header);
+
+    destination.sent = Simulator::Now();
+    if (m_socket->SendTo(packet, 0, destination.peer) < 0)
+    {
+        NS_LOG_WARN("Could not send the probe of destination " << destination.id);
+    }
+
+    if (++m_next < m_destinations.size())
+    {
+        m_sendEvent = Simulator::Schedule(m_interval, &ProberApplication::SendProbe, this);
+    }
+}
+
+void
+ProberApplication::HandleRead(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    Ptr<Packet> packet;
+    Address from;
+    while ((packet = socket->RecvFrom(from)))
+    {
+        SeqTsHeader header;
+        if (packet->GetSize() < header.GetSerializedSize())
+        {
+            continue;
+        }
+        packet->PeekHeader(header);
+        uint32_t seq = header.GetSeq();
+
+        if (!(seq & PROBE_REPLY))
+        {
+            // a probe of another host, send it back with the reply bit
+            SeqTsHeader reply;
+            reply.SetSeq(seq | PROBE_REPLY);
+            packet->RemoveHeader(header);
+            packet->AddHeader(reply);
+            socket->SendTo(packet, 0, from);
+            continue;
+        }
+
+        uint32_t index = seq & ~PROBE_REPLY;
+        if (index >= m_next || m_destinations[index].replied)
+        {
+            continue;
+        }
+        Destination& destination = m_destinations[index];
+        destination.replied = true;
+        m_replies++;
+
+        Time rtt = Simulator::Now() - destination.sent;
+        NS_LOG_INFO("At time " << Simulator::Now().As(Time::S) << " prober got the reply of destination "
+                               << destination.id << " after " << rtt.As(Time::US));
+        m_rttTrace(destination.id, rtt);
+    }
+}
+
+} // namespace ns3
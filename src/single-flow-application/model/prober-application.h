@@ -0,0 +1,99 @@
+#ifndef PROBER_APPLICATION_H
+#define PROBER_APPLICATION_H
+
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/traced-callback.h"
+#include "ns3/socket.h"
+
+#include <stdint.h>
+#include <vector>
+
+
+namespace ns3
+{
+
+/**
+ * Reachability prober: sends one UDP probe to each of its destinations and
+ * measures the RTT of the replies, replacing a UdpEchoClient and a
+ * UdpEchoServer per pair of hosts.
+ *
+ * Every host runs one prober on the same Port. A single socket sends the
+ * probes, one every Interval in the order the destinations were added, and
+ * answers the probes of the other hosts. Probes carry a SeqTsHeader whose
+ * sequence number is the position of the destination, with the top bit set
+ * in replies, so matching a reply is an index lookup.
+ *
+ * Adding the destinations of host i as i + 1, i + 2, ... keeps every host
+ * probing a different destination at any time instead of all of them
+ * hitting the same host at once.
+ */
+class ProberApplication : public Application
+{
+  public:
+    static TypeId GetTypeId();
+
+    ProberApplication();
+
+    ~ProberApplication() override;
+
+    /// Probe `destination`, `id` identifies it in the Rtt trace
+    void AddDestination(const Address& destination, uint32_t id);
+
+    uint32_t GetNDestinations() const {
+      return m_destinations.size();
+    }
+
+    /// Destinations that replied so far
+    uint32_t GetNReplies() const {
+      return m_replies;
+    }
+
+    /**
+     * TracedCallback signature for replies
+     *
+     * \param [in] id The id given to the destination
+     * \param [in] rtt Time from sending the probe to receiving its reply
+     */
+    typedef void (*RttTracedCallback)(uint32_t id, Time rtt);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    // inherited from Application base class.
+    void StartApplication() override;
+    void StopApplication() override;
+
+    void SendProbe();
+    void HandleRead(Ptr<Socket> socket);
+
+    /// A destination and the state of its probe
+    struct Destination
+    {
+        Address peer;
+        uint32_t id;
+        Time sent;                      //!< When the probe was sent, zero before
+        bool replied;
+    };
+
+    Ptr<Socket> m_socket;                //!< Sends probes and replies
+    uint16_t m_port;                     //!< Port of all the probers
+    uint32_t m_pktSize;                  //!< Size of probes, headers included
+    Time m_interval;                     //!< Time between two probes
+    std::vector<Destination> m_destinations;
+    uint32_t m_next;                     //!< Next destination to probe
+    uint32_t m_replies;                  //!< Destinations that replied
+    EventId m_sendEvent;                 //!< Event id of pending "send probe" event
+
+    /// Traced Callback: a destination replied
+    TracedCallback<uint32_t, Time> m_rttTrace;
+};
+
+} // namespace ns3
+
+#endif /* PROBER_APPLICATION_H */
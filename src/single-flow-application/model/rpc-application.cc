@@ -0,0 +1,730 @@
+#include "rpc-application.h"
+
+#include "ns3/abort.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/inet6-socket-address.h"
+#include "ns3/log.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/pointer.h"
+#include "ns3/simulator.h"
+#include "ns3/socket-factory.h"
+#include "ns3/string.h"
+#include "ns3/tcp-socket-factory.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("RpcApplication");
+
+NS_OBJECT_ENSURE_REGISTERED(RpcApplication);
+
+TypeId
+RpcApplication::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::RpcApplication")
+            .SetParent<Application>()
+            .SetGroupName("Applications")
+            .AddConstructor<RpcApplication>()
+            .AddAttribute("Local",
+                        "The address requests are served on, none if invalid",
+                        AddressValue(),
+                        MakeAddressAccessor(&RpcApplication::m_local),
+                        MakeAddressChecker())
+            .AddAttribute("Protocol",
+                        "The type of protocol to use. This should be "
+                        "a subclass of ns3::SocketFactory",
+                        TypeIdValue(TcpSocketFactory::GetTypeId()),
+                        MakeTypeIdAccessor(&RpcApplication::m_tid),
+                        MakeTypeIdChecker())
+            .AddAttribute("PacketSize",
+                        "Largest write into a socket, a message header is never split",
+                        UintegerValue(6000),
+                        MakeUintegerAccessor(&RpcApplication::m_pktSize),
+                        MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("FanOut",
+                        "Servers each request of the fan-out client goes to",
+                        UintegerValue(1),
+                        MakeUintegerAccessor(&RpcApplication::m_fanOut),
+                        MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("RequestSize",
+                        "Payload bytes of each call of the fan-out client",
+                        UintegerValue(1000),
+                        MakeUintegerAccessor(&RpcApplication::m_requestSize),
+                        MakeUintegerChecker<uint64_t>())
+            .AddAttribute("ResponseSize",
+                        "Payload bytes of each reply to the fan-out client",
+                        UintegerValue(10000),
+                        MakeUintegerAccessor(&RpcApplication::m_responseSize),
+                        MakeUintegerChecker<uint64_t>())
+            .AddAttribute("ThinkTime",
+                        "A RandomVariableStream giving the seconds between the last reply "
+                        "of a request and the next request of the fan-out client",
+                        StringValue("ns3::ConstantRandomVariable[Constant=0.0001]"),
+                        MakePointerAccessor(&RpcApplication::m_thinkTime),
+                        MakePointerChecker<RandomVariableStream>())
+            .AddAttribute("MaxRequests",
+                        "Requests of the fan-out client, zero for no limit",
+                        UintegerValue(0),
+                        MakeUintegerAccessor(&RpcApplication::m_maxRequests),
+                        MakeUintegerChecker<uint32_t>())
+            .AddTraceSource("Rpc",
+                            "The fan-out client received all the replies of a request",
+                            MakeTraceSourceAccessor(&RpcApplication::m_rpcTrace),
+                            "ns3::RpcApplication::RpcTracedCallback");
+    return tid;
+}
+
+RpcApplication::RpcApplication()
+    : m_socket(nullptr),
+    m_requests(0),
+    m_calls(0)
+{
+    NS_LOG_FUNCTION(this);
+    m_pick = CreateObject<UniformRandomVariable>();
+}
+
+RpcApplication::~RpcApplication()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+RpcApplication::SetWorkload(Workload workload)
+{
+    NS_LOG_FUNCTION(this);
+    m_workload = workload;
+}
+
+void
+RpcApplication::AddServer(const Address& server)
+{
+    NS_LOG_FUNCTION(this << server);
+    m_servers.push_back(server);
+}
+
+int64_t
+RpcApplication::AssignStreams(int64_t stream)
+{
+    NS_LOG_FUNCTION(this << stream);
+    m_thinkTime->SetStream(stream);
+    m_pick->SetStream(stream + 1);
+    return 2;
+}
+
+void
+RpcApplication::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+
+    // the frames go back to the arena while it is still there
+    m_tasks.Clear();
+    for (auto& elem : m_sleeping)
+    {
+        Simulator::Cancel(elem.second);
+    }
+    m_sleeping.clear();
+    m_connections.clear();
+    m_peers.clear();
+    m_socket = nullptr;
+    m_workload = nullptr;
+    m_arena = nullptr;
+
+    // chain up
+    Application::DoDispose();
+}
+
+// Application Methods
+void
+RpcApplication::StartApplication() // Called at time specified by Start
+{
+    NS_LOG_FUNCTION(this);
+
+    if (!m_arena)
+    {
+        m_arena = GetNode()->GetObject<RpcArena>();
+        if (!m_arena)
+        {
+            m_arena = CreateObject<RpcArena>();
+            GetNode()->AggregateObject(m_arena);
+        }
+    }
+
+    if (!m_local.IsInvalid() && !m_socket)
+    {
+        m_socket = Socket::CreateSocket(GetNode(), m_tid);
+        if (m_socket->Bind(m_local) == -1)
+        {
+            NS_FATAL_ERROR("Failed to bind socket");
+        }
+        m_socket->Listen();
+        m_socket->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address&>(),
+                                    MakeCallback(&RpcApplication::HandleAccept, this));
+    }
+
+    RpcArena::Scope scope(*m_arena);
+    if (m_workload)
+    {
+        m_tasks.Spawn(m_workload(*this));
+    }
+    else if (!m_servers.empty())
+    {
+        m_tasks.Spawn(FanOut());
+    }
+}
+
+void
+RpcApplication::StopApplication() // Called at time specified by Stop
+{
+    NS_LOG_FUNCTION(this);
+
+    // tasks hold on to the connections, they go first
+    m_tasks.Clear();
+    for (auto& elem : m_sleeping)
+    {
+        Simulator::Cancel(elem.second);
+    }
+    m_sleeping.clear();
+
+    for (auto& elem : m_connections)
+    {
+        Ptr<Socket> socket = elem.second->socket;
+        socket->SetRecvCallback(MakeNullCallback<void, Ptr<Socket>>());
+        socket->SetSendCallback(MakeNullCallback<void, Ptr<Socket>, uint32_t>());
+        socket->SetCloseCallbacks(MakeNullCallback<void, Ptr<Socket>>(),
+                                  MakeNullCallback<void, Ptr<Socket>>());
+        if (!elem.second->closed)
+        {
+            socket->Close();
+        }
+    }
+    m_connections.clear();
+    m_peers.clear();
+
+    if (m_socket)
+    {
+        m_socket->Close();
+        m_socket->SetAcceptCallback(MakeNullCallback<bool, Ptr<Socket>, const Address&>(),
+                                    MakeNullCallback<void, Ptr<Socket>, const Address&>());
+        m_socket = nullptr;
+    }
+}
+
+void
+RpcApplication::Resume(std::coroutine_handle<> handle)
+{
+    RpcArena::Scope scope(*m_arena);
+    handle.resume();
+}
+
+void
+RpcApplication::Wake(std::coroutine_handle<> handle)
+{
+    m_sleeping.erase(handle.address());
+    Resume(handle);
+}
+
+RpcApplication::ConnectAwaiter
+RpcApplication::Connect(const Address& peer)
+{
+    NS_LOG_FUNCTION(this << peer);
+
+    auto it = m_peers.find(peer);
+    if (it != m_peers.end())
+    {
+        return ConnectAwaiter{this, it->second};
+    }
+
+    Ptr<Socket> socket = Socket::CreateSocket(GetNode(), m_tid);
+    int ret = -1;
+    if (Inet6SocketAddress::IsMatchingType(peer))
+    {
+        ret = socket->Bind6();
+    }
+    else if (InetSocketAddress::IsMatchingType(peer))
+    {
+        ret = socket->Bind();
+    }
+
+    if (ret == -1)
+    {
+        NS_FATAL_ERROR("Failed to bind socket");
+    }
+
+    RpcConnection* connection = AddConnection(socket, peer);
+    socket->SetConnectCallback(MakeCallback(&RpcApplication::ConnectionSucceeded, this),
+                               MakeCallback(&RpcApplication::ConnectionFailed, this));
+    socket->Connect(peer);
+    m_peers[peer] = connection;
+    return ConnectAwaiter{this, connection};
+}
+
+RpcApplication::SendAwaiter
+RpcApplication::Send(RpcConnection* connection, uint64_t size, uint64_t replySize, uint32_t id)
+{
+    NS_LOG_FUNCTION(this << connection << size << replySize << id);
+
+    if (connection->closed)
+    {
+        NS_LOG_WARN("Dropping message " << id << " of a closed connection to " << connection->peer);
+    }
+
+    RpcHeader header;
+    header.SetId(id);
+    header.SetSize(size);
+    header.SetReplySize(replySize);
+    return SendAwaiter{this, connection, header};
+}
+
+bool
+RpcApplication::SendAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    uint64_t ticket = ++connection->queued;
+    connection->pending.push_back(RpcConnection::Outgoing{header, ticket, nullptr});
+    app->SendPending(connection);
+    if (connection->closed || connection->sent >= ticket)
+    {
+        return false;
+    }
+
+    // other tasks may have queued messages behind it meanwhile
+    connection->pending[ticket - connection->sent - 1].waiter = handle;
+    return true;
+}
+
+RpcApplication::RecvAwaiter
+RpcApplication::Recv(RpcConnection* connection)
+{
+    return RecvAwaiter{connection};
+}
+
+void
+RpcApplication::RecvAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    NS_ABORT_MSG_IF(connection->receiver, "Only one task can wait for the messages of a connection");
+    connection->receiver = handle;
+}
+
+RpcMessage
+RpcApplication::RecvAwaiter::await_resume()
+{
+    if (connection->inbox.empty())
+    {
+        return RpcMessage{false, RpcHeader()};
+    }
+    RpcMessage message{true, connection->inbox.front()};
+    connection->inbox.pop_front();
+    return message;
+}
+
+RpcApplication::SleepAwaiter
+RpcApplication::Sleep(Time delay)
+{
+    return SleepAwaiter{this, delay};
+}
+
+void
+RpcApplication::SleepAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    app->m_sleeping[handle.address()] = Simulator::Schedule(delay, &RpcApplication::Wake, app, handle);
+}
+
+RpcApplication::WhenAllAwaiter
+RpcApplication::WhenAll(std::vector<RpcTask> tasks)
+{
+    return WhenAllAwaiter{this, std::move(tasks), 0, nullptr};
+}
+
+bool
+RpcApplication::WhenAllAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    // one more until all are started, so none of them can resume us early
+    waiter = handle;
+    pending = tasks.size() + 1;
+    for (RpcTask& task : tasks)
+    {
+        app->m_tasks.Spawn(app->JoinOne(std::move(task), this));
+    }
+    tasks.clear();
+    return --pending > 0;
+}
+
+RpcTask
+RpcApplication::JoinOne(RpcTask task, WhenAllAwaiter* join)
+{
+    co_await task;
+    if (--join->pending == 0)
+    {
+        Resume(join->waiter);
+    }
+}
+
+RpcTask
+RpcApplication::Call(RpcConnection* connection, uint64_t size, uint64_t replySize)
+{
+    uint32_t id = m_calls++;
+    co_await Send(connection, size, replySize, id);
+    if (replySize == 0)
+    {
+        co_return;
+    }
+
+    RpcMessage reply = co_await Recv(connection);
+    if (!reply.ok)
+    {
+        NS_LOG_WARN("Connection to " << connection->peer << " closed before the reply of call " << id);
+    }
+}
+
+void
+RpcApplication::Close(RpcConnection* connection)
+{
+    NS_LOG_FUNCTION(this << connection);
+
+    if (connection->closed)
+    {
+        return;
+    }
+    connection->socket->Close();
+    HandleClose(connection->socket);
+}
+
+RpcTask
+RpcApplication::FanOut()
+{
+    NS_ABORT_MSG_IF(m_fanOut > m_servers.size(),
+                    "Fan-out of " << m_fanOut << " with only " << m_servers.size() << " servers");
+
+    // connected the first time they are picked, so a client with many
+    // servers and a small fan-out only opens the connections it uses
+    std::vector<RpcConnection*> servers(m_servers.size(), nullptr);
+
+    std::vector<RpcTask> calls;
+    while (m_maxRequests == 0 || m_requests < m_maxRequests)
+    {
+        // consecutive servers from a random one, a connection has one call at a time
+        Time start = Simulator::Now();
+        uint32_t first = m_pick->GetInteger(0, servers.size() - 1);
+        calls.reserve(m_fanOut);
+        for (uint32_t i = 0; i < m_fanOut; i++)
+        {
+            uint32_t server = (first + i) % servers.size();
+            if (!servers[server] || servers[server]->closed)
+            {
+                servers[server] = co_await Connect(m_servers[server]);
+            }
+            calls.push_back(Call(servers[server], m_requestSize, m_responseSize));
+        }
+        co_await WhenAll(std::move(calls));
+        calls.clear();
+
+        Time latency = Simulator::Now() - start;
+        NS_LOG_INFO("At time " << Simulator::Now().As(Time::S) << " rpc client completed request "
+                               << m_requests << " after " << latency.As(Time::US));
+        m_rpcTrace(m_requests, latency);
+        m_requests++;
+
+        co_await Sleep(Seconds(m_thinkTime->GetValue()));
+    }
+}
+
+RpcTask
+RpcApplication::Serve(RpcConnection* connection)
+{
+    for (;;)
+    {
+        RpcMessage request = co_await Recv(connection);
+        if (!request.ok)
+        {
+            co_return;
+        }
+        if (request.header.GetReplySize() > 0)
+        {
+            co_await Send(connection, request.header.GetReplySize(), 0, request.header.GetId());
+        }
+    }
+}
+
+RpcConnection*
+RpcApplication::AddConnection(Ptr<Socket> socket, const Address& peer)
+{
+    NS_ABORT_MSG_IF(socket->GetSocketType() != Socket::NS3_SOCK_STREAM &&
+                        socket->GetSocketType() != Socket::NS3_SOCK_SEQPACKET,
+                    "Using RpcApplication with an incompatible socket type. "
+                    "It requires SOCK_STREAM or SOCK_SEQPACKET.");
+
+    std::unique_ptr<RpcConnection>& connection = m_connections[PeekPointer(socket)];
+    connection = std::make_unique<RpcConnection>();
+    connection->socket = socket;
+    connection->peer = peer;
+    connection->connected = false;
+    connection->closed = false;
+    connection->offset = 0;
+    connection->queued = 0;
+    connection->sent = 0;
+    connection->headerBytes = 0;
+    connection->remaining = 0;
+
+    socket->SetRecvCallback(MakeCallback(&RpcApplication::HandleRead, this));
+    socket->SetSendCallback(MakeCallback(&RpcApplication::DataSent, this));
+    socket->SetCloseCallbacks(MakeCallback(&RpcApplication::HandlePeerClose, this),
+                              MakeCallback(&RpcApplication::HandleClose, this));
+    return connection.get();
+}
+
+void
+RpcApplication::SendPending(RpcConnection* connection)
+{
+    NS_LOG_FUNCTION(this << connection);
+
+    // resumed once the loop is done, they may queue more
+    std::vector<std::coroutine_handle<>> done;
+    while (connection->connected && !connection->closed && !connection->pending.empty())
+    {
+        const RpcHeader& header = connection->pending.front().header;
+        uint32_t headerSize = header.GetSerializedSize();
+        uint64_t left = headerSize + header.GetSize() - connection->offset;
+
+        uint32_t size = std::min<uint64_t>(m_pktSize, left);
+        if (connection->offset == 0)
+        {
+            // the header is never split over two writes, the frame is at least as large
+            size = std::min<uint64_t>(std::max(size, headerSize), left);
+        }
+        if (connection->socket->GetTxAvailable() < size)
+        {
+            // DataSent picks up from here once TCP frees some of the buffer
+            break;
+        }
+
+        Ptr<Packet> packet;
+        if (connection->offset == 0)
+        {
+            packet = Create<Packet>(size - headerSize);
+            packet->AddHeader(header);
+        }
+        else
+        {
+            packet = Create<Packet>(size);
+        }
+
+        int actual = connection->socket->Send(packet);
+        if (actual <= 0)
+        {
+            NS_LOG_DEBUG("Unable to send " << size << " bytes, waiting for buffer space");
+            break;
+        }
+        connection->offset += actual;
+
+        if (connection->offset == headerSize + header.GetSize())
+        {
+            if (connection->pending.front().waiter)
+            {
+                done.push_back(connection->pending.front().waiter);
+            }
+            connection->pending.pop_front();
+            connection->offset = 0;
+            connection->sent++;
+        }
+    }
+
+    for (std::coroutine_handle<> handle : done)
+    {
+        Resume(handle);
+    }
+}
+
+void
+RpcApplication::Consume(RpcConnection* connection, Ptr<Packet> packet)
+{
+    // same size for every header, only its fields change
+    const uint32_t headerSize = connection->current.GetSerializedSize();
+    NS_ASSERT(headerSize <= sizeof(connection->header));
+
+    while (packet->GetSize() > 0 && !connection->closed)
+    {
+        if (connection->headerBytes < headerSize)
+        {
+            // a header may straddle two segments, collect its bytes until it is whole
+            uint32_t n = std::min(headerSize - connection->headerBytes, packet->GetSize());
+            packet->CopyData(connection->header + connection->headerBytes, n);
+            packet->RemoveAtStart(n);
+            connection->headerBytes += n;
+            if (connection->headerBytes < headerSize)
+            {
+                return;
+            }
+
+            Ptr<Packet> raw = Create<Packet>(connection->header, headerSize);
+            raw->RemoveHeader(connection->current);
+            connection->remaining = connection->current.GetSize();
+        }
+
+        uint64_t n = std::min<uint64_t>(connection->remaining, packet->GetSize());
+        connection->remaining -= n;
+        if (connection->remaining > 0)
+        {
+            return;
+        }
+        packet->RemoveAtStart(n);
+        connection->headerBytes = 0;
+
+        NS_LOG_INFO("At time " << Simulator::Now().As(Time::S) << " rpc application received message "
+                               << connection->current.GetId() << " of " << connection->current.GetSize()
+                               << " bytes from " << connection->peer);
+        connection->inbox.push_back(connection->current);
+        if (connection->receiver)
+        {
+            Resume(std::exchange(connection->receiver, nullptr));
+        }
+    }
+}
+
+void
+RpcApplication::HandleRead(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    auto it = m_connections.find(PeekPointer(socket));
+    if (it == m_connections.end())
+    {
+        return;
+    }
+
+    RpcConnection* connection = it->second.get();
+    Ptr<Packet> packet;
+    while (!connection->closed && (packet = socket->Recv()))
+    {
+        if (packet->GetSize() == 0)
+        { // EOF
+            break;
+        }
+        Consume(connection, packet);
+    }
+}
+
+void
+RpcApplication::HandleAccept(Ptr<Socket> socket, const Address& from)
+{
+    NS_LOG_FUNCTION(this << socket << from);
+
+    RpcConnection* connection = AddConnection(socket, from);
+    connection->connected = true;
+
+    RpcArena::Scope scope(*m_arena);
+    m_tasks.Spawn(Serve(connection));
+}
+
+void
+RpcApplication::HandlePeerClose(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    // the peer sent its FIN, close our side too or the socket stays in CLOSE_WAIT
+    auto it = m_connections.find(PeekPointer(socket));
+    if (it != m_connections.end() && !it->second->closed)
+    {
+        socket->Close();
+    }
+    HandleClose(socket);
+}
+
+void
+RpcApplication::HandleClose(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    auto it = m_connections.find(PeekPointer(socket));
+    if (it == m_connections.end() || it->second->closed)
+    {
+        return;
+    }
+
+    RpcConnection* connection = it->second.get();
+    connection->closed = true;
+    if (connection->headerBytes)
+    {
+        NS_LOG_WARN("Connection to " << connection->peer << " closed in the middle of message "
+                                     << connection->current.GetId());
+    }
+    if (!connection->pending.empty())
+    {
+        NS_LOG_WARN("Connection to " << connection->peer << " closed with "
+                                     << connection->pending.size() << " messages pending");
+    }
+
+    // a later Connect opens a new one
+    auto peer = m_peers.find(connection->peer);
+    if (peer != m_peers.end() && peer->second == connection)
+    {
+        m_peers.erase(peer);
+    }
+
+    std::vector<std::coroutine_handle<>> waiters;
+    for (const RpcConnection::Outgoing& message : connection->pending)
+    {
+        if (message.waiter)
+        {
+            waiters.push_back(message.waiter);
+        }
+    }
+    connection->pending.clear();
+    if (connection->receiver)
+    {
+        waiters.push_back(std::exchange(connection->receiver, nullptr));
+    }
+
+    for (std::coroutine_handle<> handle : waiters)
+    {
+        Resume(handle);
+    }
+}
+
+void
+RpcApplication::DataSent(Ptr<Socket> socket, uint32_t available)
+{
+    NS_LOG_FUNCTION(this << socket << available);
+
+    auto it = m_connections.find(PeekPointer(socket));
+    if (it != m_connections.end())
+    {
+        SendPending(it->second.get());
+    }
+}
+
+void
+RpcApplication::ConnectionSucceeded(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+
+    auto it = m_connections.find(PeekPointer(socket));
+    if (it == m_connections.end())
+    {
+        return;
+    }
+
+    RpcConnection* connection = it->second.get();
+    connection->connected = true;
+    SendPending(connection);
+
+    std::vector<std::coroutine_handle<>> waiters;
+    waiters.swap(connection->connectWaiters);
+    for (std::coroutine_handle<> handle : waiters)
+    {
+        Resume(handle);
+    }
+}
+
+void
+RpcApplication::ConnectionFailed(Ptr<Socket> socket)
+{
+    NS_LOG_FUNCTION(this << socket);
+    NS_FATAL_ERROR("Can't connect");
+}
+
+} // namespace ns3
@@ -0,0 +1,298 @@
+#ifndef RPC_APPLICATION_H
+#define RPC_APPLICATION_H
+
+
+#include "rpc-coroutine.h"
+#include "rpc-header.h"
+
+#include "ns3/address.h"
+#include "ns3/application.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/ptr.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/traced-callback.h"
+#include "ns3/socket.h"
+
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+
+namespace ns3
+{
+
+/**
+ * A stream connection of an RpcApplication, to one peer. Connections are
+ * owned by the application and stay valid until it stops, closed or not,
+ * so tasks can hold on to them.
+ */
+struct RpcConnection
+{
+    /// A message waiting for room in the socket buffer
+    struct Outgoing
+    {
+        RpcHeader header;
+        uint64_t ticket;                 //!< Position of the message on the connection
+        std::coroutine_handle<> waiter;  //!< Task sending it, if it is waiting
+    };
+
+    Ptr<Socket> socket;
+    Address peer;
+    bool connected;
+    bool closed;
+
+    std::deque<Outgoing> pending;        //!< Messages not fully written yet, in order
+    uint64_t offset;                     //!< Bytes of the first pending message written
+    uint64_t queued;                     //!< Messages queued so far
+    uint64_t sent;                       //!< Messages fully written so far
+
+    uint8_t header[32];                  //!< Bytes of the header being received
+    uint32_t headerBytes;                //!< Bytes of header received, all of it once the payload starts
+    RpcHeader current;                   //!< Header of the message being received
+    uint64_t remaining;                  //!< Payload bytes of the current message still expected
+    std::deque<RpcHeader> inbox;         //!< Received messages nobody asked for yet
+
+    std::coroutine_handle<> receiver;    //!< Task waiting in Recv
+    std::vector<std::coroutine_handle<>> connectWaiters;
+};
+
+/// What Recv returns: a message, or nothing once the connection is closed
+struct RpcMessage
+{
+    bool ok;
+    RpcHeader header;
+};
+
+/**
+ * Closed-loop request/response traffic written as coroutines. Each host runs
+ * one RpcApplication, which answers the requests it receives on Local and
+ * runs a workload: a coroutine that connects, sends, receives and sleeps
+ * through co_await on the application,
+ *
+ *     RpcTask Workload(RpcApplication& app)
+ *     {
+ *         RpcConnection* server = co_await app.Connect(address);
+ *         for (;;)
+ *         {
+ *             co_await app.Send(server, 1000, 10000);
+ *             RpcMessage reply = co_await app.Recv(server);
+ *             co_await app.Sleep(MicroSeconds(10));
+ *         }
+ *     }
+ *
+ * instead of a chain of callbacks and one application per message. The
+ * default workload is a fan-out client: each request goes to FanOut of the
+ * servers added with AddServer, and the next one is sent ThinkTime after
+ * the last reply. Servers answer every request with the reply size it asks
+ * for, on the same connection and in order.
+ *
+ * Coroutine frames come from the RpcArena aggregated to the node, and
+ * connections to a peer are opened once and kept, so the memory of a run
+ * follows the number of peers and of calls in flight, not of messages.
+ */
+class RpcApplication : public Application
+{
+  public:
+    static TypeId GetTypeId();
+
+    RpcApplication();
+
+    ~RpcApplication() override;
+
+    /// A workload, started with the application
+    typedef std::function<RpcTask(RpcApplication&)> Workload;
+
+    /// Run `workload` instead of the fan-out client, before the application starts
+    void SetWorkload(Workload workload);
+
+    /// Add a server of the fan-out client
+    void AddServer(const Address& server);
+
+    /**
+     * Assign a fixed random variable stream number to the random variables
+     * used by this model.
+     *
+     * \param stream first stream index to use
+     * \return the number of stream indices assigned by this model
+     */
+    int64_t AssignStreams(int64_t stream);
+
+    /// Requests the fan-out client completed so far
+    uint32_t GetNRequests() const {
+      return m_requests;
+    }
+
+    RpcArena& GetArena() {
+      return *m_arena;
+    }
+
+    /**
+     * TracedCallback signature for completed fan-out requests
+     *
+     * \param [in] id Request number of the client
+     * \param [in] latency From sending the first call to receiving the last reply
+     */
+    typedef void (*RpcTracedCallback)(uint32_t id, Time latency);
+
+    // Awaitables, see the class comment
+
+    /// co_await: a connection to `peer`, opened on the first call and reused after
+    struct ConnectAwaiter
+    {
+        RpcApplication* app;
+        RpcConnection* connection;
+
+        bool await_ready() const noexcept {
+          return connection->connected;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+          connection->connectWaiters.push_back(handle);
+        }
+
+        RpcConnection* await_resume() const noexcept {
+          return connection;
+        }
+    };
+
+    ConnectAwaiter Connect(const Address& peer);
+
+    /// co_await: returns once the message is written into the socket buffer
+    struct SendAwaiter
+    {
+        RpcApplication* app;
+        RpcConnection* connection;
+        RpcHeader header;
+
+        bool await_ready() const noexcept {
+          return connection->closed;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const noexcept {}
+    };
+
+    /// Send `size` payload bytes asking for a reply of `replySize` bytes
+    SendAwaiter Send(RpcConnection* connection, uint64_t size, uint64_t replySize, uint32_t id = 0);
+
+    /// co_await: the next message of the connection
+    struct RecvAwaiter
+    {
+        RpcConnection* connection;
+
+        bool await_ready() const noexcept {
+          return !connection->inbox.empty() || connection->closed;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        RpcMessage await_resume();
+    };
+
+    RecvAwaiter Recv(RpcConnection* connection);
+
+    /// co_await: resumes `delay` later
+    struct SleepAwaiter
+    {
+        RpcApplication* app;
+        Time delay;
+
+        bool await_ready() const noexcept {
+          return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const noexcept {}
+    };
+
+    SleepAwaiter Sleep(Time delay);
+
+    /// co_await: runs the tasks concurrently and returns once all of them did
+    struct WhenAllAwaiter
+    {
+        RpcApplication* app;
+        std::vector<RpcTask> tasks;
+        uint32_t pending;
+        std::coroutine_handle<> waiter;
+
+        bool await_ready() const noexcept {
+          return tasks.empty();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle);
+
+        void await_resume() const noexcept {}
+    };
+
+    WhenAllAwaiter WhenAll(std::vector<RpcTask> tasks);
+
+    /// Send a request and wait for its reply
+    RpcTask Call(RpcConnection* connection, uint64_t size, uint64_t replySize);
+
+    /// Close the connection, its tasks get the replies already received and then nothing
+    void Close(RpcConnection* connection);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    // inherited from Application base class.
+    void StartApplication() override;
+    void StopApplication() override;
+
+    /// Resume a task of this application, with its arena as the current one
+    void Resume(std::coroutine_handle<> handle);
+    void Wake(std::coroutine_handle<> handle);
+
+    RpcTask FanOut();
+    RpcTask Serve(RpcConnection* connection);
+    RpcTask JoinOne(RpcTask task, WhenAllAwaiter* join);
+
+    RpcConnection* AddConnection(Ptr<Socket> socket, const Address& peer);
+    void SendPending(RpcConnection* connection);
+    void Consume(RpcConnection* connection, Ptr<Packet> packet);
+    void HandleRead(Ptr<Socket> socket);
+    void HandleAccept(Ptr<Socket> socket, const Address& from);
+    void HandlePeerClose(Ptr<Socket> socket);
+    void HandleClose(Ptr<Socket> socket);
+    void DataSent(Ptr<Socket> socket, uint32_t available);
+    void ConnectionSucceeded(Ptr<Socket> socket);
+    void ConnectionFailed(Ptr<Socket> socket);
+
+    Ptr<Socket> m_socket;                //!< Listening socket
+    Address m_local;                     //!< Local address to serve on
+    TypeId m_tid;                        //!< Protocol TypeId
+    uint32_t m_pktSize;                  //!< Largest write into a socket
+    uint32_t m_fanOut;                   //!< Servers of each request
+    uint64_t m_requestSize;              //!< Payload of each call
+    uint64_t m_responseSize;             //!< Payload of each reply
+    Ptr<RandomVariableStream> m_thinkTime; //!< Seconds between a reply and the next request
+    uint32_t m_maxRequests;              //!< Requests of the fan-out client, zero for no limit
+    Ptr<UniformRandomVariable> m_pick;   //!< First server of each request
+
+    Ptr<RpcArena> m_arena;               //!< Frames of the tasks, shared with the node
+    RpcTaskSet m_tasks;                  //!< Workload, servers and concurrent calls
+    Workload m_workload;
+    std::vector<Address> m_servers;
+    uint32_t m_requests;                 //!< Fan-out requests completed
+    uint32_t m_calls;                    //!< Ids of the calls
+
+    std::unordered_map<Socket*, std::unique_ptr<RpcConnection>> m_connections;
+    std::map<Address, RpcConnection*> m_peers; //!< Connections opened by Connect
+    std::unordered_map<void*, EventId> m_sleeping; //!< Frames of sleeping tasks --> their wake up
+
+    /// Traced Callback: completed fan-out requests
+    TracedCallback<uint32_t, Time> m_rpcTrace;
+};
+
+} // namespace ns3
+
+#endif /* RPC_APPLICATION_H */
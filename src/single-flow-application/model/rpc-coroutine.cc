@@ -0,0 +1,155 @@
+#include "rpc-coroutine.h"
+
+#include "ns3/abort.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+
+#include <new>
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("RpcCoroutine");
+
+NS_OBJECT_ENSURE_REGISTERED(RpcArena);
+
+RpcArena* RpcArena::s_current = nullptr;
+
+TypeId
+RpcArena::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::RpcArena")
+                            .SetParent<Object>()
+                            .SetGroupName("Applications")
+                            .AddConstructor<RpcArena>();
+    return tid;
+}
+
+RpcArena::RpcArena()
+    : m_cursor(nullptr),
+    m_left(0),
+    m_inUse(0),
+    m_reserved(0)
+{
+    NS_LOG_FUNCTION(this);
+    for (std::size_t i = 0; i < NUM_CLASSES; i++)
+    {
+        m_free[i] = nullptr;
+    }
+}
+
+RpcArena::~RpcArena()
+{
+    NS_LOG_FUNCTION(this);
+    if (m_inUse)
+    {
+        NS_LOG_WARN("RpcArena destroyed with " << m_inUse << " bytes of frames still allocated");
+    }
+    for (char* block : m_blocks)
+    {
+        ::operator delete(block);
+    }
+}
+
+void*
+RpcArena::AllocateFrame(std::size_t size)
+{
+    char* block = static_cast<char*>(Allocate(size + PREFIX));
+    *reinterpret_cast<RpcArena**>(block) = this;
+    return block + PREFIX;
+}
+
+void*
+RpcArena::AllocateCurrentFrame(std::size_t size)
+{
+    NS_ABORT_MSG_IF(!s_current, "RPC coroutines must be called from code run by an RpcApplication");
+    return s_current->AllocateFrame(size);
+}
+
+void
+RpcArena::FreeFrame(void* frame, std::size_t size)
+{
+    char* block = static_cast<char*>(frame) - PREFIX;
+    RpcArena* arena = *reinterpret_cast<RpcArena**>(block);
+    arena->Free(block, size + PREFIX);
+}
+
+void*
+RpcArena::Allocate(std::size_t size)
+{
+    std::size_t index = (size + GRANULE - 1) / GRANULE - 1;
+    m_inUse += size;
+    if (index >= NUM_CLASSES)
+    {
+        // too large to be worth keeping, should be rare for coroutine frames
+        return ::operator new(size);
+    }
+
+    if (m_free[index])
+    {
+        FreeBlock* block = m_free[index];
+        m_free[index] = block->next;
+        return block;
+    }
+
+    std::size_t rounded = (index + 1) * GRANULE;
+    if (m_left < rounded)
+    {
+        // what is left of the last block is not worth tracking
+        m_cursor = static_cast<char*>(::operator new(BLOCK_SIZE));
+        m_left = BLOCK_SIZE;
+        m_blocks.push_back(m_cursor);
+        m_reserved += BLOCK_SIZE;
+    }
+    void* block = m_cursor;
+    m_cursor += rounded;
+    m_left -= rounded;
+    return block;
+}
+
+void
+RpcArena::Free(void* block, std::size_t size)
+{
+    std::size_t index = (size + GRANULE - 1) / GRANULE - 1;
+    NS_ASSERT(m_inUse >= size);
+    m_inUse -= size;
+    if (index >= NUM_CLASSES)
+    {
+        ::operator delete(block);
+        return;
+    }
+
+    FreeBlock* free = static_cast<FreeBlock*>(block);
+    free->next = m_free[index];
+    m_free[index] = free;
+}
+
+void
+RpcTaskSet::Spawn(RpcTask task)
+{
+    NS_ABORT_MSG_IF(!task.m_handle, "Spawning an empty task");
+    std::coroutine_handle<RpcTask::promise_type> handle = std::exchange(task.m_handle, {});
+    handle.promise().set = this;
+    m_tasks.insert(handle.address());
+    handle.resume();
+}
+
+void
+RpcTaskSet::Clear()
+{
+    // destroying a frame may destroy the tasks it awaits, never ones of the set
+    std::unordered_set<void*> tasks;
+    tasks.swap(m_tasks);
+    for (void* address : tasks)
+    {
+        std::coroutine_handle<>::from_address(address).destroy();
+    }
+}
+
+void
+RpcTaskSet::Release(std::coroutine_handle<> handle)
+{
+    m_tasks.erase(handle.address());
+    handle.destroy();
+}
+
+} // namespace ns3
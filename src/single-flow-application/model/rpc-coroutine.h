@@ -0,0 +1,267 @@
+#ifndef RPC_COROUTINE_H
+#define RPC_COROUTINE_H
+
+
+#include "ns3/object.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <stdint.h>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+
+namespace ns3
+{
+
+/**
+ * Allocator of coroutine frames, aggregated to a node and shared by the
+ * RpcApplications on it. Frames are rounded up to size classes whose freed
+ * blocks are kept on free lists, carved from blocks that stay with the
+ * node, so a closed loop that keeps calling the same coroutines reuses the
+ * same memory instead of hitting the heap for every message.
+ */
+class RpcArena : public Object
+{
+  public:
+    static TypeId GetTypeId();
+
+    RpcArena();
+
+    ~RpcArena() override;
+
+    /// Memory for a frame of `size` bytes, freed by FreeFrame
+    void* AllocateFrame(std::size_t size);
+
+    /// Memory for a frame of `size` bytes from the current arena, aborts if there is none
+    static void* AllocateCurrentFrame(std::size_t size);
+
+    /// Give back a frame of AllocateFrame, to the arena it came from
+    static void FreeFrame(void* frame, std::size_t size);
+
+    /**
+     * Makes an arena the current one for as long as it lives. The
+     * simulation runs one event at a time, so the code that starts or
+     * resumes coroutines of an application holds a scope of its arena and
+     * the frames of whatever those call are taken from it.
+     */
+    class Scope
+    {
+      public:
+        explicit Scope(RpcArena& arena)
+            : m_previous(s_current) {
+          s_current = &arena;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+          s_current = m_previous;
+        }
+
+      private:
+        RpcArena* m_previous;
+    };
+
+    /// Bytes of the frames currently allocated
+    uint64_t GetBytesInUse() const {
+      return m_inUse;
+    }
+
+    /// Bytes taken from the heap for frames, never given back before the arena goes
+    uint64_t GetBytesReserved() const {
+      return m_reserved;
+    }
+
+  private:
+    /// A free block of some size class, linked through its first bytes
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    static const std::size_t GRANULE = 64;
+    static const std::size_t NUM_CLASSES = 64;          //!< Frames up to GRANULE * NUM_CLASSES bytes
+    static const std::size_t BLOCK_SIZE = 64 * 1024;
+    /// Room for the arena of a frame, in front of it and keeping its alignment
+    static const std::size_t PREFIX = alignof(std::max_align_t);
+
+    void* Allocate(std::size_t size);
+    void Free(void* block, std::size_t size);
+
+    static RpcArena* s_current;           //!< Arena of the innermost Scope
+
+    FreeBlock* m_free[NUM_CLASSES];
+    std::vector<char*> m_blocks;
+    char* m_cursor;                      //!< Start of the unused part of the last block
+    std::size_t m_left;                  //!< Bytes left in the last block
+    uint64_t m_inUse;
+    uint64_t m_reserved;
+};
+
+class RpcTaskSet;
+
+/**
+ * Coroutine of an RPC workload. A task starts suspended and runs either
+ * when it is awaited by another task, which resumes once it returns, or
+ * when it is handed to an RpcTaskSet, which destroys it once it returns.
+ *
+ * Frames come from the current RpcArena, the one of the application that
+ * runs or starts the calling code. Calling a task outside of that aborts
+ * rather than going to the heap.
+ */
+class RpcTask
+{
+  public:
+    struct promise_type;
+
+    /// Resumes the awaiting task, or lets the task set release a detached one
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept {
+          return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+
+        void await_resume() const noexcept {}
+    };
+
+    struct promise_type
+    {
+        std::coroutine_handle<> continuation; //!< Task awaiting this one
+        RpcTaskSet* set = nullptr;            //!< Owner of a detached task
+
+        RpcTask get_return_object() noexcept {
+          return RpcTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+          return {};
+        }
+
+        FinalAwaiter final_suspend() noexcept {
+          return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+          std::terminate();
+        }
+
+        static void* operator new(std::size_t size) {
+          return RpcArena::AllocateCurrentFrame(size);
+        }
+
+        static void operator delete(void* frame, std::size_t size) {
+          RpcArena::FreeFrame(frame, size);
+        }
+    };
+
+    RpcTask() = default;
+
+    RpcTask(RpcTask&& other) noexcept
+        : m_handle(std::exchange(other.m_handle, {})) {}
+
+    RpcTask& operator=(RpcTask&& other) noexcept {
+      if (this != &other)
+      {
+          if (m_handle)
+          {
+              m_handle.destroy();
+          }
+          m_handle = std::exchange(other.m_handle, {});
+      }
+      return *this;
+    }
+
+    RpcTask(const RpcTask&) = delete;
+    RpcTask& operator=(const RpcTask&) = delete;
+
+    ~RpcTask() {
+      if (m_handle)
+      {
+          m_handle.destroy();
+      }
+    }
+
+    // Awaiting a task runs it until it returns
+    bool await_ready() const noexcept {
+      return !m_handle || m_handle.done();
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept {
+      m_handle.promise().continuation = caller;
+      return m_handle;
+    }
+
+    void await_resume() const noexcept {}
+
+  private:
+    friend class RpcTaskSet;
+
+    explicit RpcTask(std::coroutine_handle<promise_type> handle)
+        : m_handle(handle) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+/**
+ * Detached tasks of an application: each runs on its own until it returns
+ * and is then destroyed. Whatever is left when the application stops is
+ * destroyed by Clear, without being resumed again.
+ */
+class RpcTaskSet
+{
+  public:
+    RpcTaskSet() = default;
+
+    RpcTaskSet(const RpcTaskSet&) = delete;
+    RpcTaskSet& operator=(const RpcTaskSet&) = delete;
+
+    ~RpcTaskSet() {
+      Clear();
+    }
+
+    /// Start `task` and keep it until it returns
+    void Spawn(RpcTask task);
+
+    /// Destroy the tasks that did not return yet
+    void Clear();
+
+    uint32_t GetN() const {
+      return m_tasks.size();
+    }
+
+  private:
+    friend struct RpcTask::FinalAwaiter;
+
+    void Release(std::coroutine_handle<> handle);
+
+    /// Addresses of the frames of the running tasks
+    std::unordered_set<void*> m_tasks;
+};
+
+inline std::coroutine_handle<>
+RpcTask::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+{
+    promise_type& promise = handle.promise();
+    if (promise.continuation)
+    {
+        return promise.continuation;
+    }
+    if (promise.set)
+    {
+        // suspended for good, the frame can go
+        promise.set->Release(handle);
+    }
+    return std::noop_coroutine();
+}
+
+} // namespace ns3
+
+#endif /* RPC_COROUTINE_H */
@@ -0,0 +1,119 @@
+#include "rpc-header.h"
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("RpcHeader");
+
+NS_OBJECT_ENSURE_REGISTERED(RpcHeader);
+
+TypeId
+RpcHeader::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::RpcHeader")
+                            .SetParent<Header>()
+                            .SetGroupName("Applications")
+                            .AddConstructor<RpcHeader>();
+    return tid;
+}
+
+RpcHeader::RpcHeader()
+    : m_id(0),
+    m_size(0),
+    m_replySize(0),
+    m_ts(Simulator::Now().GetTimeStep())
+{
+    NS_LOG_FUNCTION(this);
+}
+
+void
+RpcHeader::SetId(uint32_t id)
+{
+    m_id = id;
+}
+
+uint32_t
+RpcHeader::GetId() const
+{
+    return m_id;
+}
+
+void
+RpcHeader::SetSize(uint64_t size)
+{
+    m_size = size;
+}
+
+uint64_t
+RpcHeader::GetSize() const
+{
+    return m_size;
+}
+
+void
+RpcHeader::SetReplySize(uint64_t replySize)
+{
+    m_replySize = replySize;
+}
+
+uint64_t
+RpcHeader::GetReplySize() const
+{
+    return m_replySize;
+}
+
+void
+RpcHeader::SetTs(Time ts)
+{
+    m_ts = ts.GetTimeStep();
+}
+
+Time
+RpcHeader::GetTs() const
+{
+    return TimeStep(m_ts);
+}
+
+TypeId
+RpcHeader::GetInstanceTypeId() const
+{
+    return GetTypeId();
+}
+
+void
+RpcHeader::Print(std::ostream& os) const
+{
+    os << "(id=" << m_id << " size=" << m_size << " reply=" << m_replySize << " time=" << TimeStep(m_ts).As(Time::S)
+       << ")";
+}
+
+uint32_t
+RpcHeader::GetSerializedSize() const
+{
+    return 4 + 8 + 8 + 8;
+}
+
+void
+RpcHeader::Serialize(Buffer::Iterator start) const
+{
+    Buffer::Iterator i = start;
+    i.WriteHtonU32(m_id);
+    i.WriteHtonU64(m_size);
+    i.WriteHtonU64(m_replySize);
+    i.WriteHtonU64(m_ts);
+}
+
+uint32_t
+RpcHeader::Deserialize(Buffer::Iterator start)
+{
+    Buffer::Iterator i = start;
+    m_id = i.ReadNtohU32();
+    m_size = i.ReadNtohU64();
+    m_replySize = i.ReadNtohU64();
+    m_ts = i.ReadNtohU64();
+    return GetSerializedSize();
+}
+
+} // namespace ns3
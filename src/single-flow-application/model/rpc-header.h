@@ -0,0 +1,55 @@
+#ifndef RPC_HEADER_H
+#define RPC_HEADER_H
+
+
+#include "ns3/header.h"
+#include "ns3/nstime.h"
+
+#include <stdint.h>
+
+
+namespace ns3
+{
+
+/**
+ * Frame of one RPC message on a stream socket: the id of the call, the
+ * bytes of payload that follow the header, the bytes the receiver should
+ * answer with (zero for replies) and when the message was sent.
+ */
+class RpcHeader : public Header
+{
+  public:
+    static TypeId GetTypeId();
+
+    RpcHeader();
+
+    void SetId(uint32_t id);
+    uint32_t GetId() const;
+
+    /// Payload bytes following the header
+    void SetSize(uint64_t size);
+    uint64_t GetSize() const;
+
+    /// Payload bytes of the reply, zero if none is expected
+    void SetReplySize(uint64_t replySize);
+    uint64_t GetReplySize() const;
+
+    void SetTs(Time ts);
+    Time GetTs() const;
+
+    TypeId GetInstanceTypeId() const override;
+    void Print(std::ostream& os) const override;
+    uint32_t GetSerializedSize() const override;
+    void Serialize(Buffer::Iterator start) const override;
+    uint32_t Deserialize(Buffer::Iterator start) override;
+
+  private:
+    uint32_t m_id;
+    uint64_t m_size;
+    uint64_t m_replySize;
+    uint64_t m_ts;                       //!< In time steps
+};
+
+} // namespace ns3
+
+#endif /* RPC_HEADER_H */
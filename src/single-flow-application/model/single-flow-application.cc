@@ -21,6 +21,8 @@
 #include "ns3/uinteger.h"
 #include "ns3/object-vector.h"
 
+#include <algorithm>
+
 namespace ns3
 {
 NS_LOG_COMPONENT_DEFINE("SingleFlowApplication");
@@ -62,6 +64,13 @@ SingleFlowApplication::GetTypeId()
                         UintegerValue(1024),
                         MakeUintegerAccessor(&SingleFlowApplication::m_flowSize),
                         MakeUintegerChecker<uint64_t>())
+            .AddAttribute("Bulk",
+                        "Write the flow into the socket as fast as its send buffer frees up, "
+                        "like BulkSendApplication, instead of pacing it at DataRate. "
+                        "No timer event is scheduled, PacketSize is the size of each write.",
+                        BooleanValue(false),
+                        MakeBooleanAccessor(&SingleFlowApplication::m_bulk),
+                        MakeBooleanChecker())
             .AddAttribute("Protocol",
                         "The type of protocol to use. This should be "
                         "a subclass of ns3::SocketFactory",
@@ -76,7 +85,12 @@ SingleFlowApplication::GetTypeId()
             .AddTraceSource("TxWithAddresses",
                             "A new packet is created and is sent",
                             MakeTraceSourceAccessor(&SingleFlowApplication::m_txTraceWithAddresses),
-                            "ns3::Packet::TwoAddressTracedCallback");
+                            "ns3::Packet::TwoAddressTracedCallback")
+            .AddTraceSource("Socket",
+                            "The socket was created and connect was called. The socket "
+                            "outlives the application, which drops it once all data is sent",
+                            MakeTraceSourceAccessor(&SingleFlowApplication::m_socketTrace),
+                            "ns3::SingleFlowApplication::SocketTracedCallback");
     return tid;
 }
 
@@ -85,6 +99,7 @@ SingleFlowApplication::SingleFlowApplication()
     m_connected(false),
     m_residualBits(0),
     m_lastStartTime(Seconds(0)),
+    m_bulk(false),
     m_totBytes(0),
     m_unsentPacket(nullptr)
 {
@@ -115,6 +130,62 @@ SingleFlowApplication::SetAppId(uint32_t appid) {
     m_appId = appid;
 }
 
+void
+SingleFlowApplication::SetFlowConfig(const FlowConfig& config)
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(config.packetSize == 0, "PacketSize must be positive");
+    m_peer = config.remote;
+    m_local = config.local;
+    m_cbrRate = config.rate;
+    m_pktSize = config.packetSize;
+    m_flowSize = config.flowSize;
+    m_bulk = config.bulk;
+}
+
+void
+SingleFlowApplication::SetDoneCallback(DoneCallback done)
+{
+    NS_LOG_FUNCTION(this);
+    m_done = done;
+}
+
+void
+SingleFlowApplication::Restart()
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(m_socket, "SingleFlowApplication restarted before its flow was done");
+    Simulator::ScheduleWithContext(GetNode()->GetId(),
+                                   Seconds(0),
+                                   &SingleFlowApplication::StartApplication,
+                                   this);
+}
+
+void
+SingleFlowApplication::DetachSocket()
+{
+    NS_LOG_FUNCTION(this);
+
+    m_socket->SetConnectCallback(MakeNullCallback<void, Ptr<Socket>>(),
+                                 MakeNullCallback<void, Ptr<Socket>>());
+    m_socket->SetSendCallback(MakeNullCallback<void, Ptr<Socket>, uint32_t>());
+    m_connected = false;
+}
+
+void
+SingleFlowApplication::ResetFlow()
+{
+    NS_LOG_FUNCTION(this);
+
+    // the socket keeps sending what it buffered and is freed by TCP once closed
+    DetachSocket();
+    m_socket = nullptr;
+    m_residualBits = 0;
+    m_totBytes = 0;
+    m_seq = 0;
+    m_isDone = false;
+}
+
 Ptr<Socket>
 SingleFlowApplication::GetSocket() const
 {
@@ -130,6 +201,7 @@ SingleFlowApplication::DoDispose()
     CancelEvents();
     m_socket = nullptr;
     m_unsentPacket = nullptr;
+    m_done.Nullify();
     
     // chain up
     Application::DoDispose();
@@ -181,8 +253,13 @@ SingleFlowApplication::StartApplication() // Called at time specified by Start
 
         m_socket->SetConnectCallback(MakeCallback(&SingleFlowApplication::ConnectionSucceeded, this),
                                     MakeCallback(&SingleFlowApplication::ConnectionFailed, this));
+        if (m_bulk)
+        {
+            m_socket->SetSendCallback(MakeCallback(&SingleFlowApplication::DataSent, this));
+        }
 
         m_socket->Connect(m_peer);
+        m_socketTrace(m_socket);
 
         // We will not allow broadcast for these flows
         m_socket->SetAllowBroadcast(false);
@@ -199,7 +276,14 @@ SingleFlowApplication::StartApplication() // Called at time specified by Start
     // so we have to start them again.
     if (m_connected)
     {
-        ScheduleStartEvent();
+        if (m_bulk)
+        {
+            SendBulk();
+        }
+        else
+        {
+            ScheduleStartEvent();
+        }
     }
 }
 
@@ -212,14 +296,20 @@ SingleFlowApplication::StopApplication() // Called at time specified by Stop
     if (m_socket)
     {
         m_socket->Close();
+        // TCP keeps draining the buffer after Close, its DataSent upcalls must not restart the flow
+        DetachSocket();
     }
     else
     {
         NS_LOG_WARN("SingleFlowApplication found null socket to close in StopApplication");
     }
 
-    // Out single FlowApp self-disposes when it is finished
-    if (!m_reportDone) {
+    // Out single FlowApp self-disposes when it is finished, unless it is recycled
+    if (!m_done.IsNull() && m_socket) {
+        ResetFlow();
+        m_done(this);
+    }
+    else if (!m_reportDone) {
         DoDispose();
     }
     else {
@@ -352,13 +442,64 @@ SingleFlowApplication::SendPacket()
     ScheduleNextTx();
 }
 
+void
+SingleFlowApplication::SendBulk()
+{
+    NS_LOG_FUNCTION(this);
+
+    while (m_flowSize == 0 || m_totBytes < m_flowSize)
+    {
+        uint32_t size = m_pktSize;
+        if (m_flowSize)
+        {
+            size = std::min<uint64_t>(size, m_flowSize - m_totBytes);
+        }
+        if (m_socket->GetTxAvailable() < size)
+        {
+            // DataSent picks up from here once TCP frees some of the buffer
+            return;
+        }
+
+        Ptr<Packet> packet = Create<Packet>(size);
+        int actual = m_socket->Send(packet);
+        if (actual <= 0)
+        {
+            NS_LOG_DEBUG("Unable to send " << size << " bytes, waiting for buffer space");
+            return;
+        }
+        m_txTrace(packet);
+        m_totBytes += actual;
+    }
+
+    NS_LOG_INFO("At time " << Simulator::Now().As(Time::S) << " single flow application handed all "
+                           << m_totBytes << " bytes to the socket");
+    StopApplication();
+}
+
+void
+SingleFlowApplication::DataSent(Ptr<Socket> socket, uint32_t available)
+{
+    NS_LOG_FUNCTION(this << socket << available);
+    if (m_connected)
+    {
+        SendBulk();
+    }
+}
+
 void
 SingleFlowApplication::ConnectionSucceeded(Ptr<Socket> socket)
 {
     NS_LOG_FUNCTION(this << socket);
 
-    ScheduleStartEvent();
     m_connected = true;
+    if (m_bulk)
+    {
+        SendBulk();
+    }
+    else
+    {
+        ScheduleStartEvent();
+    }
 }
 
 void
@@ -30,6 +30,24 @@ class SingleFlowApplication : public Application
     void SetNode(Ptr<Node> node);
     void SetAppId(uint32_t appid);
 
+    /// Parameters of one flow, the attributes that change from a flow to the next
+    struct FlowConfig
+    {
+        Address remote;                  //!< Remote attribute
+        Address local;                   //!< Local attribute
+        DataRate rate;                   //!< DataRate attribute
+        uint32_t packetSize;             //!< PacketSize attribute
+        uint64_t flowSize;               //!< FlowSize attribute
+        bool bulk;                       //!< Bulk attribute
+    };
+
+    /**
+     * Set the parameters of the next flow directly, the same as setting the
+     * attributes one by one but without looking them up by name and
+     * converting them through AttributeValues.
+     */
+    void SetFlowConfig(const FlowConfig& config);
+
     bool m_reportDone = false;
     bool IsDone() {
       return m_isDone;
@@ -37,6 +55,29 @@ class SingleFlowApplication : public Application
 
     Ptr<Socket> GetSocket() const;
 
+    /// Called with the application once its flow was handed to the socket
+    typedef Callback<void, Ptr<SingleFlowApplication>> DoneCallback;
+
+    /**
+     * Recycle the application instead of disposing it when the flow is done:
+     * the socket is left to finish the transfer on its own, the application
+     * forgets it and is passed to `done`, ready for Restart.
+     */
+    void SetDoneCallback(DoneCallback done);
+
+    /**
+     * Send a new flow with the current attributes from a recycled
+     * application. New applications are started by their node instead.
+     */
+    void Restart();
+
+    /**
+     * TracedCallback signature for the socket of the flow
+     *
+     * \param [in] socket The socket, bound and connecting
+     */
+    typedef void (*SocketTracedCallback)(Ptr<Socket> socket);
+
   protected:
     void DoDispose() override;
 
@@ -47,11 +88,16 @@ class SingleFlowApplication : public Application
 
     // helpers
     void CancelEvents();
+    /// Stop the socket from calling back into the application, it may outlive the flow
+    void DetachSocket();
+    void ResetFlow();
 
     // Event handlers
     void StartSending();
     void StopSending();
     void SendPacket();
+    void SendBulk();
+    void DataSent(Ptr<Socket> socket, uint32_t available);
 
     Ptr<Socket> m_socket;                //!< Associated socket
     Ptr<Node> m_node;                    //!< Associated Node of this application
@@ -65,6 +111,7 @@ class SingleFlowApplication : public Application
     uint32_t m_residualBits;             //!< Number of generated, but not sent, bits
     Time m_lastStartTime;                //!< Time last packet sent
     uint64_t m_flowSize;                 //!< Limit total number of bytes sent
+    bool m_bulk;                         //!< Fill the socket buffer instead of pacing at m_cbrRate
     uint64_t m_totBytes;                 //!< Total bytes sent so far
     EventId m_startStopEvent;            //!< Event id for next start or stop event
     EventId m_sendEvent;                 //!< Event id of pending "send packet" event
@@ -78,7 +125,11 @@ class SingleFlowApplication : public Application
     /// Callbacks for tracing the packet Tx events, includes source and destination addresses
     TracedCallback<Ptr<const Packet>, const Address&, const Address&> m_txTraceWithAddresses;
 
+    /// Traced Callback: the socket was created and connect was called, to hook its own traces
+    TracedCallback<Ptr<Socket>> m_socketTrace;
+
     bool m_isDone = false;
+    DoneCallback m_done;                 //!< Recycles the application, null if it disposes itself
 
   private:
     void ScheduleNextTx();
@@ -0,0 +1,29 @@
+#include "flow-test-hosts.h"
+
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/simple-net-device-helper.h"
+#include "ns3/string.h"
+
+namespace ns3
+{
+
+Ipv4InterfaceContainer
+SetupTestHosts(NodeContainer& nodes)
+{
+    nodes.Create(2);
+
+    SimpleNetDeviceHelper link;
+    link.SetDeviceAttribute("DataRate", StringValue("1Gbps"));
+    link.SetChannelAttribute("Delay", StringValue("10us"));
+    NetDeviceContainer devices = link.Install(nodes);
+
+    InternetStackHelper internet;
+    internet.Install(nodes);
+
+    Ipv4AddressHelper address;
+    address.SetBase("10.0.0.0", "255.255.255.0");
+    return address.Assign(devices);
+}
+
+} // namespace ns3
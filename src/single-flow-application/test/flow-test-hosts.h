@@ -0,0 +1,19 @@
+#ifndef FLOW_TEST_HOSTS_H
+#define FLOW_TEST_HOSTS_H
+
+#include "ns3/ipv4-interface-container.h"
+#include "ns3/node-container.h"
+
+namespace ns3
+{
+
+/**
+ * Two hosts with an Internet stack on one 1 Gbps link, created into
+ * `nodes`, for the tests of this module. Returns their addresses, the
+ * first node is 10.0.0.1.
+ */
+Ipv4InterfaceContainer SetupTestHosts(NodeContainer& nodes);
+
+} // namespace ns3
+
+#endif /* FLOW_TEST_HOSTS_H */
@@ -0,0 +1,169 @@
+#include "ns3/ptr.h"
+#include "ns3/node.h"
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/tcp-socket.h"
+#include "ns3/rpc-helper.h"
+
+#include "flow-test-hosts.h"
+
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("RpcApplicationTest");
+
+static const uint16_t RPC_TEST_PORT = 5000;
+
+/**
+ * The fan-out client completes MaxRequests requests against a server, each
+ * reported once through the Rpc trace.
+ */
+class RpcFanOutTest : public TestCase {
+    public:
+        RpcFanOutTest();
+
+        void DoRun() override;
+
+    private:
+        void RequestDone(uint32_t id, Time latency);
+
+        uint32_t m_done;
+        uint32_t m_nextId;
+};
+
+RpcFanOutTest :: RpcFanOutTest()
+    : TestCase("RPC fan-out client completes its requests"),
+    m_done(0),
+    m_nextId(0)
+{
+}
+
+void
+RpcFanOutTest :: RequestDone(uint32_t id, Time latency)
+{
+    NS_TEST_ASSERT_MSG_EQ(id, m_nextId, "Requests of a closed-loop client complete in order");
+    NS_TEST_ASSERT_MSG_GT(latency, Time(0), "A request takes at least a round trip");
+    m_nextId++;
+    m_done++;
+}
+
+void
+RpcFanOutTest :: DoRun()
+{
+    NodeContainer nodes;
+    Ipv4InterfaceContainer interfaces = SetupTestHosts(nodes);
+    Address serverAddress = InetSocketAddress(interfaces.GetAddress(0), RPC_TEST_PORT);
+
+    RpcHelper server("ns3::TcpSocketFactory", serverAddress);
+    ApplicationContainer apps = server.Install(nodes.Get(0));
+
+    RpcHelper client("ns3::TcpSocketFactory", Address());
+    client.SetAttribute("MaxRequests", UintegerValue(5));
+    client.SetAttribute("RequestSize", UintegerValue(100));
+    client.SetAttribute("ResponseSize", UintegerValue(20000));
+    ApplicationContainer clientApps = client.Install(nodes.Get(1), {serverAddress});
+    clientApps.Get(0)->TraceConnectWithoutContext("Rpc", MakeCallback(&RpcFanOutTest::RequestDone, this));
+    apps.Add(clientApps);
+
+    apps.Start(Seconds(0.1));
+    apps.Stop(Seconds(1));
+    Simulator::Stop(Seconds(1));
+    Simulator::Run();
+
+    NS_TEST_ASSERT_MSG_EQ(m_done, 5, "The client should complete MaxRequests requests");
+    NS_TEST_ASSERT_MSG_EQ(DynamicCast<RpcApplication>(clientApps.Get(0))->GetNRequests(),
+                          5,
+                          "GetNRequests should match the trace");
+
+    Simulator::Destroy();
+}
+
+/**
+ * A workload makes one call and closes its connection. The server has to
+ * close its accepted socket on the FIN, which takes the client's socket to
+ * TIME_WAIT rather than leaving it in FIN_WAIT_2.
+ */
+class RpcPeerCloseTest : public TestCase {
+    public:
+        RpcPeerCloseTest();
+
+        void DoRun() override;
+
+    private:
+        RpcTask Workload(RpcApplication& app, Address server);
+        void StateChanged(TcpSocket::TcpStates_t oldState, TcpSocket::TcpStates_t newState);
+
+        bool m_replied;
+        TcpSocket::TcpStates_t m_clientState;
+};
+
+RpcPeerCloseTest :: RpcPeerCloseTest()
+    : TestCase("RPC server closes connections closed by the peer"),
+    m_replied(false),
+    m_clientState(TcpSocket::CLOSED)
+{
+}
+
+void
+RpcPeerCloseTest :: StateChanged(TcpSocket::TcpStates_t oldState, TcpSocket::TcpStates_t newState)
+{
+    m_clientState = newState;
+}
+
+RpcTask
+RpcPeerCloseTest :: Workload(RpcApplication& app, Address server)
+{
+    RpcConnection* connection = co_await app.Connect(server);
+    connection->socket->TraceConnectWithoutContext("State",
+                                                   MakeCallback(&RpcPeerCloseTest::StateChanged, this));
+
+    co_await app.Send(connection, 100, 1000);
+    RpcMessage reply = co_await app.Recv(connection);
+    m_replied = reply.ok;
+    app.Close(connection);
+}
+
+void
+RpcPeerCloseTest :: DoRun()
+{
+    NodeContainer nodes;
+    Ipv4InterfaceContainer interfaces = SetupTestHosts(nodes);
+    Address serverAddress = InetSocketAddress(interfaces.GetAddress(0), RPC_TEST_PORT);
+
+    RpcHelper server("ns3::TcpSocketFactory", serverAddress);
+    ApplicationContainer apps = server.Install(nodes.Get(0));
+
+    RpcHelper client("ns3::TcpSocketFactory", Address());
+    apps.Add(client.Install(nodes.Get(1), [this, serverAddress](RpcApplication& app) {
+        return Workload(app, serverAddress);
+    }));
+
+    apps.Start(Seconds(0.1));
+    apps.Stop(Seconds(1));
+    Simulator::Stop(Seconds(1));
+    Simulator::Run();
+
+    NS_TEST_ASSERT_MSG_EQ(m_replied, true, "The call should get its reply");
+    NS_TEST_ASSERT_MSG_EQ(m_clientState,
+                          TcpSocket::TIME_WAIT,
+                          "The server should answer the client's FIN with its own");
+
+    Simulator::Destroy();
+}
+
+class RpcApplicationTestSuite : public TestSuite
+{
+    public:
+        RpcApplicationTestSuite();
+};
+
+RpcApplicationTestSuite::RpcApplicationTestSuite()
+    : TestSuite("rpc-application", UNIT)
+{
+    AddTestCase(new RpcFanOutTest(), TestCase::QUICK);
+    AddTestCase(new RpcPeerCloseTest(), TestCase::QUICK);
+}
+
+static RpcApplicationTestSuite rpcApplicationTestSuite;
@@ -0,0 +1,179 @@
+#include "ns3/ptr.h"
+#include "ns3/node.h"
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/address.h"
+#include "ns3/boolean.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/packet-sink.h"
+#include "ns3/packet-sink-helper.h"
+#include "ns3/single-flow-helper.h"
+#include "ns3/uinteger.h"
+
+#include "flow-test-hosts.h"
+
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("SingleFlowHelperTest");
+
+static const uint16_t SINK_PORT = 9;
+static const uint64_t FLOW_SIZE = 20000;
+
+/**
+ * Flows dispatched through InstallFromPool reuse the applications of the
+ * flows that are done: sequential flows need one application, concurrent
+ * ones as many as there are at the same time. Every flow is still sent in
+ * full.
+ */
+class SingleFlowPoolTest : public TestCase {
+    public:
+        SingleFlowPoolTest();
+
+        void DoRun() override;
+
+    private:
+        void Dispatch(Ptr<Node> node, uint32_t flows);
+        void CheckPoolSize(uint32_t expected);
+
+        SingleFlowHelper m_helper;
+        SingleFlowApplication::FlowConfig m_config;
+};
+
+SingleFlowPoolTest :: SingleFlowPoolTest()
+    : TestCase("Flow pool reuses the applications of finished flows"),
+    m_helper("ns3::TcpSocketFactory")
+{
+}
+
+void
+SingleFlowPoolTest :: Dispatch(Ptr<Node> node, uint32_t flows)
+{
+    for (uint32_t i = 0; i < flows; i++)
+    {
+        m_helper.InstallFromPool(node, m_config);
+    }
+}
+
+void
+SingleFlowPoolTest :: CheckPoolSize(uint32_t expected)
+{
+    NS_TEST_ASSERT_MSG_EQ(m_helper.GetPoolSize(), expected, "Unexpected number of pooled applications");
+}
+
+void
+SingleFlowPoolTest :: DoRun()
+{
+    NodeContainer nodes;
+    Ipv4InterfaceContainer interfaces = SetupTestHosts(nodes);
+
+    PacketSinkHelper sink("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), SINK_PORT));
+    ApplicationContainer sinkApps = sink.Install(nodes.Get(0));
+    sinkApps.Start(Seconds(0));
+
+    m_config.remote = InetSocketAddress(interfaces.GetAddress(0), SINK_PORT);
+    m_config.local = Address();
+    m_config.rate = DataRate("1Gbps");
+    m_config.packetSize = 1000;
+    m_config.flowSize = FLOW_SIZE;
+    m_config.bulk = true;
+
+    // three flows one after the other, each done long before the next
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        Simulator::Schedule(Seconds(0.1 * (i + 1)), &SingleFlowPoolTest::Dispatch, this, nodes.Get(1), 1);
+    }
+    Simulator::Schedule(Seconds(0.5), &SingleFlowPoolTest::CheckPoolSize, this, 1);
+
+    // then three at once, one from the pool and two new ones
+    Simulator::Schedule(Seconds(0.6), &SingleFlowPoolTest::Dispatch, this, nodes.Get(1), 3);
+    Simulator::Schedule(Seconds(0.9), &SingleFlowPoolTest::CheckPoolSize, this, 3);
+
+    Simulator::Stop(Seconds(1));
+    Simulator::Run();
+
+    NS_TEST_ASSERT_MSG_EQ(DynamicCast<PacketSink>(sinkApps.Get(0))->GetTotalRx(),
+                          6 * FLOW_SIZE,
+                          "Every flow should be received in full");
+    NS_TEST_ASSERT_MSG_EQ(nodes.Get(1)->GetNApplications(), 3, "Applications should only be added for the pool");
+
+    Simulator::Destroy();
+}
+
+/**
+ * Bulk flows of applications that are not pooled dispose of themselves
+ * once done. TCP keeps draining their buffer after that, which must not
+ * call back into the application: a sized flow is sent exactly once, and
+ * an unbounded one stopped by its stop time does not resume.
+ */
+class SingleFlowBulkTest : public TestCase {
+    public:
+        SingleFlowBulkTest();
+
+        void DoRun() override;
+};
+
+SingleFlowBulkTest :: SingleFlowBulkTest()
+    : TestCase("Bulk flows of applications that are not pooled")
+{
+}
+
+void
+SingleFlowBulkTest :: DoRun()
+{
+    NodeContainer nodes;
+    Ipv4InterfaceContainer interfaces = SetupTestHosts(nodes);
+
+    // one sink per flow
+    PacketSinkHelper sink("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), SINK_PORT));
+    ApplicationContainer sinkApps = sink.Install(nodes.Get(0));
+    sink.SetAttribute("Local", AddressValue(InetSocketAddress(Ipv4Address::GetAny(), SINK_PORT + 1)));
+    sinkApps.Add(sink.Install(nodes.Get(0)));
+    sinkApps.Start(Seconds(0));
+
+    SingleFlowHelper flow("ns3::TcpSocketFactory");
+    flow.SetAttribute("Bulk", BooleanValue(true));
+    flow.SetAttribute("PacketSize", UintegerValue(1000));
+
+    // far more than the send buffer, it drains long after the flow was handed over
+    flow.SetAttribute("Remote", AddressValue(InetSocketAddress(interfaces.GetAddress(0), SINK_PORT)));
+    flow.SetAttribute("FlowSize", UintegerValue(50 * FLOW_SIZE));
+    ApplicationContainer sized = flow.Install(nodes.Get(1));
+    sized.Start(Seconds(0.1));
+
+    flow.SetAttribute("Remote", AddressValue(InetSocketAddress(interfaces.GetAddress(0), SINK_PORT + 1)));
+    flow.SetAttribute("FlowSize", UintegerValue(0));
+    ApplicationContainer unbounded = flow.Install(nodes.Get(1));
+    unbounded.Start(Seconds(0.1));
+    unbounded.Stop(Seconds(0.2));
+
+    Simulator::Stop(Seconds(1));
+    Simulator::Run();
+
+    NS_TEST_ASSERT_MSG_EQ(DynamicCast<PacketSink>(sinkApps.Get(0))->GetTotalRx(),
+                          50 * FLOW_SIZE,
+                          "The sized flow should be received exactly once");
+    NS_TEST_ASSERT_MSG_GT(DynamicCast<PacketSink>(sinkApps.Get(1))->GetTotalRx(),
+                          0,
+                          "The unbounded flow should send until it is stopped");
+    NS_TEST_ASSERT_MSG_EQ(DynamicCast<SingleFlowApplication>(unbounded.Get(0))->GetSocket(),
+                          nullptr,
+                          "The stopped application should have let go of its socket");
+
+    Simulator::Destroy();
+}
+
+class SingleFlowHelperTestSuite : public TestSuite
+{
+    public:
+        SingleFlowHelperTestSuite();
+};
+
+SingleFlowHelperTestSuite::SingleFlowHelperTestSuite()
+    : TestSuite("single-flow-helper", UNIT)
+{
+    AddTestCase(new SingleFlowPoolTest(), TestCase::QUICK);
+    AddTestCase(new SingleFlowBulkTest(), TestCase::QUICK);
+}
+
+static SingleFlowHelperTestSuite singleFlowHelperTestSuite;